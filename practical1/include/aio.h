@@ -0,0 +1,52 @@
+#ifndef _AIO_H
+#define _AIO_H
+
+#include <sys/uio.h>
+
+#include "page.h"
+
+#define AIO_MAX_RUN      64    // pages one request moves at most
+#define AIO_QUEUE_DEPTH  128   // requests in flight at once at most; more wait to be submitted
+#define AIO_NUM_WORKERS  8     // threads of the worker pool
+
+enum AIOOp
+{
+	AIO_READ,
+	AIO_WRITE
+};
+
+/*
+ * A read or write of a run of consecutive pages, see DB::SubmitReadPages. It must stay where it is until DB::WaitIO
+ * has returned for it.
+ */
+struct AIORequest
+{
+	AIOOp op;
+	PageID firstPid;
+	int numOfPages;
+	struct iovec iov[AIO_MAX_RUN];
+	Status status;
+	int done;              // status is final
+	AIORequest *next;      // in the worker pool's queue
+};
+
+/**
+ * Moves runs of pages between memory and the database file in the background. Requests complete in any order. Both
+ * engines are safe to use from any number of threads at once.
+ */
+class AIOEngine
+{
+	public :
+
+		// "io_uring", "threads" for the worker pool, or NULL for io_uring if the kernel has it and the worker pool
+		// otherwise. NULL if the engine asked for cannot be had.
+		static AIOEngine *Create( int fd, const char *name );
+
+		virtual ~AIOEngine() {}   // only once nothing is in flight
+
+		virtual void Submit( AIORequest *request ) = 0;   // blocks while AIO_QUEUE_DEPTH requests are in flight
+		virtual void Wait( AIORequest *request ) = 0;
+		virtual const char *GetName() = 0;
+};
+
+#endif
@@ -10,6 +10,16 @@
 #define PERMENANT 1
 
 class HeapPage;
+class BufferRing;
+
+#define BULK_LOAD_RING_SIZE 8
+
+// Data pages are allocated this many at a time, consecutive on disk,
+// so that a scan of the file reads them in runs. A new extent is pinned
+// whole, so it takes at most 1 / HEAP_EXTENT_SHARE of the buffer pool
+// and half of the bulk load ring.
+#define HEAP_EXTENT_SIZE 8
+#define HEAP_EXTENT_SHARE 8
 
 class HeapFile 
 {
@@ -23,8 +33,16 @@ private :
 	PageID dirPid;
 	PageID lastDirPid;
 
+	BufferRing *ring; // data pages go through this while bulk loading
+
+	PageID nextSparePid; // first page of the last extent not in use yet
+	int numOfSpares;     // pages of it from nextSparePid on, as the
+	                     // first directory page records them
+
 	PageID NextPage (PageID pid);
 	Status NewPage(PageID &pid, PageID &dirPid);
+	Status NewExtent();
+	Status RecordSpares();
 
 	PageID GetFirstDirPage() { return dirPid; }
 
@@ -41,6 +59,12 @@ public:
     Status GetRecord(const RecordID& rid, char* recPtr, int& recLen); 
     class Scan* OpenScan(Status& status);
 
+    // Between these, the data pages InsertRecord fills are kept in a
+    // private ring of BULK_LOAD_RING_SIZE frames instead of the whole
+    // buffer pool. Use them around loads of many records.
+    void BeginBulkLoad();
+    void EndBulkLoad();
+
     Status DeleteFile();
 };
 
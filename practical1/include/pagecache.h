@@ -0,0 +1,55 @@
+#ifndef _PAGECACHE_H
+#define _PAGECACHE_H
+
+#include <stddef.h>
+
+#include "page.h"
+#include "pagetable.h"
+#include "replacer.h"
+
+/**
+ * A second tier behind the buffer pool: pages evicted from the pool are kept here compressed, so missing them again
+ * costs a decompression instead of a disk read. A page is only stored while it is the same as its disk copy, and it
+ * leaves the cache when it goes back into the pool or its disk copy changes, so the cache never holds a page the pool
+ * has. When full, the pages stored longest ago are dropped.
+ *
+ * Pages are compressed with a byte-oriented run-length code: mostly empty pages shrink to a few dozen bytes, and
+ * pages that do not compress are stored as they are. Not thread-safe; the buffer manager gives each shard its own,
+ * used under the shard latch.
+ */
+class PageCache
+{
+	private :
+
+		size_t capacity;     // bytes of compressed pages it may hold
+		size_t size;         // ... and holds
+		int maxPages;
+		PageID *pids;        // per slot: the page stored there, INVALID_PAGE if none
+		char **data;         // per slot: its compressed contents
+		int *lengths;        // per slot: their length, MINIBASE_PAGESIZE if stored as they are
+		LinkedLists *lists;  // list 0: stored pages, oldest first; list 1: unused slots
+		PageTable *index;    // page id to slot
+
+		long numOfLookups;
+		long numOfHits;
+
+		void RemoveSlot(int slot);
+
+	public :
+
+		PageCache( size_t capacity );
+		~PageCache();
+
+		void Put(PageID pid, const Page *page);  // keep a copy of pid, whose disk copy is the same
+		Bool Take(PageID pid, Page *page);       // fill page with pid's contents and drop them, FALSE if not here
+		void Remove(PageID pid);                 // forget pid, whose disk copy has changed or gone
+
+		void GetStat(long& lookupNo, long& hitNo, int& pageNo, size_t& byteNo);
+		void ResetStat();
+
+		// The codec. Compress returns the compressed length, 0 if that would not be shorter than a page.
+		static int Compress(const char *page, char *out);
+		static void Decompress(const char *in, int length, char *page);
+};
+
+#endif
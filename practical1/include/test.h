@@ -31,6 +31,9 @@ protected:
     virtual int Test4();
     virtual int Test5();
     virtual int Test6();
+    virtual int Test7();
+    virtual int Test8();
+    virtual int Test9();
 
       // ...and this method, which is printed as the kind of test being done,
       // for example "Disk Space Management".
@@ -0,0 +1,301 @@
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+
+#include "../include/aio.h"
+
+// The status a request ends with, given how many bytes moved.
+static Status Result( AIORequest *request, long bytes )
+{
+	return (bytes == (long)request->numOfPages * MINIBASE_PAGESIZE) ? OK : FAIL;
+}
+
+
+//--------------------------------------------------------------------
+// WorkerPool
+//
+// The fallback: AIO_NUM_WORKERS threads take requests off a queue in
+// turn and do each with one preadv or pwritev.
+//--------------------------------------------------------------------
+
+class WorkerPool : public AIOEngine
+{
+	private :
+
+		int fd;
+		pthread_t workers[AIO_NUM_WORKERS];
+		pthread_mutex_t lock;        // protects the rest
+		pthread_cond_t queued;       // a request was queued, or stop set
+		pthread_cond_t finished;     // a request is done
+		AIORequest *head, *tail;     // queue of requests not started yet
+		bool stop;
+
+		static void *Work( void *arg );
+
+	public :
+
+		WorkerPool( int fd );
+		~WorkerPool();
+
+		void Submit( AIORequest *request );
+		void Wait( AIORequest *request );
+		const char *GetName() { return "threads"; }
+};
+
+WorkerPool::WorkerPool( int fd )
+{
+	this->fd = fd;
+	pthread_mutex_init(&lock, NULL);
+	pthread_cond_init(&queued, NULL);
+	pthread_cond_init(&finished, NULL);
+	head = tail = NULL;
+	stop = false;
+	for (int i = 0; i < AIO_NUM_WORKERS; i++) pthread_create(&workers[i], NULL, Work, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	pthread_mutex_lock(&lock);
+	stop = true;
+	pthread_cond_broadcast(&queued);
+	pthread_mutex_unlock(&lock);
+	for (int i = 0; i < AIO_NUM_WORKERS; i++) pthread_join(workers[i], NULL);
+	pthread_cond_destroy(&finished);
+	pthread_cond_destroy(&queued);
+	pthread_mutex_destroy(&lock);
+}
+
+void *WorkerPool::Work( void *arg )
+{
+	WorkerPool *pool = (WorkerPool *)arg;
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (pool->head == NULL && !pool->stop) pthread_cond_wait(&pool->queued, &pool->lock);
+		if (pool->head == NULL) break;
+		AIORequest *request = pool->head;
+		pool->head = request->next;
+		if (pool->head == NULL) pool->tail = NULL;
+		pthread_mutex_unlock(&pool->lock);
+
+		off_t offset = (off_t)request->firstPid * MINIBASE_PAGESIZE;
+		long bytes = (request->op == AIO_READ)
+			? preadv(pool->fd, request->iov, request->numOfPages, offset)
+			: pwritev(pool->fd, request->iov, request->numOfPages, offset);
+
+		pthread_mutex_lock(&pool->lock);
+		request->status = Result(request, bytes);
+		request->done = true;
+		pthread_cond_broadcast(&pool->finished);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+void WorkerPool::Submit( AIORequest *request )
+{
+	pthread_mutex_lock(&lock);
+	request->done = false;
+	request->next = NULL;
+	if (tail != NULL) tail->next = request;
+	else head = request;
+	tail = request;
+	pthread_cond_signal(&queued);
+	pthread_mutex_unlock(&lock);
+}
+
+void WorkerPool::Wait( AIORequest *request )
+{
+	pthread_mutex_lock(&lock);
+	while (!request->done) pthread_cond_wait(&finished, &lock);
+	pthread_mutex_unlock(&lock);
+}
+
+
+#ifdef __NR_io_uring_setup
+
+//--------------------------------------------------------------------
+// Uring
+//
+// One io_uring, driven with the raw system calls. Submitters share
+// the submission queue under the lock. Completions are reaped by one
+// waiter at a time, which sleeps in the kernel until there are any
+// and then marks every request that has completed, whoever waits
+// for it.
+//--------------------------------------------------------------------
+
+class Uring : public AIOEngine
+{
+	private :
+
+		int fd;                      // of the database
+		int ringFd;
+		void *sqRing, *cqRing;
+		size_t sqRingSize, cqRingSize;
+		struct io_uring_sqe *sqes;
+		size_t sqesSize;
+		unsigned *sqTail, *sqMask, *sqArray;
+		unsigned *cqHead, *cqTail, *cqMask;
+		struct io_uring_cqe *cqes;
+
+		pthread_mutex_t lock;        // protects the rest and the submission queue
+		pthread_cond_t reaped;       // the reaper has marked what completed
+		int numInFlight;
+		bool reaping;                // a thread is waiting in the kernel for completions
+
+		void WaitForCompletions();
+
+	public :
+
+		Uring( int fd, Status& status );
+		~Uring();
+
+		void Submit( AIORequest *request );
+		void Wait( AIORequest *request );
+		const char *GetName() { return "io_uring"; }
+};
+
+Uring::Uring( int fd, Status& status )
+{
+	this->fd = fd;
+	sqRing = cqRing = MAP_FAILED;
+	sqes = (struct io_uring_sqe *)MAP_FAILED;
+	pthread_mutex_init(&lock, NULL);
+	pthread_cond_init(&reaped, NULL);
+	numInFlight = 0;
+	reaping = false;
+	status = FAIL;
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof params);
+	ringFd = syscall(__NR_io_uring_setup, AIO_QUEUE_DEPTH, &params);
+	if (ringFd < 0) return;
+
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cqRingSize > sqRingSize) sqRingSize = cqRingSize;
+		cqRingSize = sqRingSize;
+	}
+	sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED) return;
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		cqRing = sqRing;
+	} else {
+		cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+		if (cqRing == MAP_FAILED) return;
+	}
+	sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	sqes = (struct io_uring_sqe *)mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		ringFd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) return;
+
+	sqTail = (unsigned *)((char *)sqRing + params.sq_off.tail);
+	sqMask = (unsigned *)((char *)sqRing + params.sq_off.ring_mask);
+	sqArray = (unsigned *)((char *)sqRing + params.sq_off.array);
+	cqHead = (unsigned *)((char *)cqRing + params.cq_off.head);
+	cqTail = (unsigned *)((char *)cqRing + params.cq_off.tail);
+	cqMask = (unsigned *)((char *)cqRing + params.cq_off.ring_mask);
+	cqes = (struct io_uring_cqe *)((char *)cqRing + params.cq_off.cqes);
+	status = OK;
+}
+
+Uring::~Uring()
+{
+	if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+	if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+	if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+	if (ringFd >= 0) close(ringFd);
+	pthread_cond_destroy(&reaped);
+	pthread_mutex_destroy(&lock);
+}
+
+// Called with the lock held, and returns with it held, once some
+// request has completed since the call.
+void Uring::WaitForCompletions()
+{
+	if (reaping) {
+		pthread_cond_wait(&reaped, &lock);
+		return;
+	}
+	reaping = true;
+	pthread_mutex_unlock(&lock);
+	while (syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno == EINTR);
+	pthread_mutex_lock(&lock);
+
+	unsigned head = *cqHead;
+	unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = &cqes[head & *cqMask];
+		AIORequest *request = (AIORequest *)(unsigned long)cqe->user_data;
+		request->status = Result(request, cqe->res);
+		request->done = true;
+		numInFlight--;
+	}
+	__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+	reaping = false;
+	pthread_cond_broadcast(&reaped);
+}
+
+void Uring::Submit( AIORequest *request )
+{
+	pthread_mutex_lock(&lock);
+	while (numInFlight == AIO_QUEUE_DEPTH) WaitForCompletions();
+	request->done = false;
+
+	unsigned tail = *sqTail;
+	unsigned index = tail & *sqMask;
+	struct io_uring_sqe *sqe = &sqes[index];
+	memset(sqe, 0, sizeof *sqe);
+	sqe->opcode = (request->op == AIO_READ) ? IORING_OP_READV : IORING_OP_WRITEV;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)request->iov;
+	sqe->len = request->numOfPages;
+	sqe->off = (unsigned long)request->firstPid * MINIBASE_PAGESIZE;
+	sqe->user_data = (unsigned long)request;
+	sqArray[index] = index;
+	__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+	numInFlight++;
+
+	int submitted;
+	while ((submitted = syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, NULL, 0)) < 0 && errno == EINTR);
+	if (submitted != 1) {
+		// The kernel did not take the entry, so it is taken back and
+		// the request fails at once.
+		__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+		numInFlight--;
+		request->status = FAIL;
+		request->done = true;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void Uring::Wait( AIORequest *request )
+{
+	pthread_mutex_lock(&lock);
+	while (!request->done) WaitForCompletions();
+	pthread_mutex_unlock(&lock);
+}
+
+#endif
+
+
+AIOEngine *AIOEngine::Create( int fd, const char *name )
+{
+#ifdef __NR_io_uring_setup
+	if (name == NULL || strcmp(name, "io_uring") == 0) {
+		Status status;
+		Uring *uring = new Uring(fd, status);
+		if (status == OK) return uring;
+		delete uring;
+	}
+#endif
+	if (name == NULL || strcmp(name, "threads") == 0) return new WorkerPool(fd);
+	return NULL;
+}
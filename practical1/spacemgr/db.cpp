@@ -6,20 +6,90 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <stdint.h>
 // #include <io.h>
 #include <iomanip>
 
 #include "../include/db.h"
 #include "../include/bufmgr.h"
+#include "../include/latency.h"
 
 #define _open open
 #define _lseek lseek
 #define _close close
-#define _read read
 #define _write write
 
+#ifdef IOV_MAX
+#define MAX_IOVECS IOV_MAX
+#else
+#define MAX_IOVECS 1024
+#endif
+
 static const int bits_per_page = MAX_SPACE * 8;
 
+// The engine behind SubmitReadPages and SubmitWritePages. It belongs to
+// the database whose file is aioFd, made on that database's first
+// submit, until that database is closed; the requests of any other
+// database open at the same time are done as they are submitted (see
+// SetAsyncIO in db.h). DB cannot hold it, as the size of a DB is fixed
+// by code built against it elsewhere.
+static pthread_mutex_t aioLock = PTHREAD_MUTEX_INITIALIZER;
+static AIOEngine *aio = NULL;   // NULL for "sync"
+static int aioFd = -1;
+
+static void ReleaseAsyncIO( int fd );
+
+// The free extents of the database whose file is treeFd, kept in
+// memory so that allocating and freeing take O(log n) steps instead of
+// a walk over the space map. usedWords is a copy of the space map, 64
+// pages a word. extentTree is a complete binary tree over those words,
+// in heap order from the root at 1, whose nodes each cover a range of
+// pages and tell the free extent at its start, the one at its end and
+// the longest in it. It is built from the space map the first time
+// the database allocates or frees after it is opened. Like the space
+// map itself, it is only changed by callers that take turns (the
+// buffer manager allocates and frees under one lock).
+struct ExtentNode {
+    unsigned prefix;    // free pages at the start of the range
+    unsigned suffix;    // free pages at its end
+    unsigned longest;   // longest run of free pages in it
+};
+
+static int treeFd = -1;
+static unsigned treeLeaves;         // words covered, a power of two
+static uint64_t* usedWords = NULL;
+static ExtentNode* extentTree = NULL;
+static PageID nextFit = 0;          // where an allocation with no hint starts looking
+
+static void ReleaseExtentTree( int fd );
+
+// The file directory of the database whose file is dirFd, hashed on
+// file name and on start page, so that looking a file up does not walk
+// the header pages. It is read from the header pages the first time
+// the directory is used after the database is opened, and AddFileEntry
+// and DeleteFileEntry keep it in step. Files are opened from many
+// threads at once, so dirLock guards it.
+struct DirEntry {
+    char fname[MAX_NAME];
+    PageID pagenum;          // first page of the file
+    PageID header_page;      // the header page whose entry this is
+    DirEntry* next_by_name;
+    DirEntry* next_by_page;
+};
+
+static pthread_rwlock_t dirLock = PTHREAD_RWLOCK_INITIALIZER;
+static int dirFd = -1;
+static DirEntry** byName = NULL;
+static DirEntry** byPage = NULL;
+static unsigned numBuckets = 0;
+static unsigned numEntries = 0;
+static PageID firstFreeHeader = 0;  // no header page before it in the chain has a free slot
+
+static void ReleaseDirectory( int fd );
+
 static const char* dbErrMsgs[] = {
     "Database is full",         // DB_FULL
     "Duplicate file entry",     // DUPLICATE_ENTRY
@@ -29,6 +99,7 @@ static const char* dbErrMsgs[] = {
     "File not found" ,          // FILE_NOT_FOUND
     "File name too long",       // FILE_NAME_TOO_LONG
     "Negative run size",        // NEG_RUN_SIZE
+    "Background I/O engine in use by another database", // AIO_ENGINE_IN_USE
 };
 
 static error_string_table dbTable( DBMGR, dbErrMsgs );
@@ -168,6 +239,9 @@ DB::~DB()
 #ifdef DEBUG
     cout<< "Closing database " << name << endl;
 #endif
+    ReleaseAsyncIO( fd );
+    ReleaseExtentTree( fd );
+    ReleaseDirectory( fd );
     _close( fd );
     fd = -1;
     free( name );
@@ -184,6 +258,9 @@ Status DB::Destroy()
     cout << "Destroying the database" << endl;
 #endif
 
+    ReleaseAsyncIO( fd );
+    ReleaseExtentTree( fd );
+    ReleaseDirectory( fd );
     _close( fd );
     fd = -1;
     unlink( name );
@@ -213,69 +290,243 @@ int DB::GetPageSize() const
 }
 
 // ********************************************************
-// This function allocates a run of pages.
+// The bits of the space map 64 at a time: bit k of word w of a map
+// page is the bit of page w*64 + k on that page, as for the bytes.
+// Bits past the end of the database read as allocated.
 
-Status DB::AllocatePage(PageID& start_page_num, int run_size_int)
+static inline uint64_t map_word( const char* pg, unsigned w, unsigned num_bits )
 {
-#ifdef DEBUG
-    cout << "Allocating a run of "<< run_size << " pages." << endl;
+    uint64_t word;
+    memcpy( &word, pg + w*sizeof(word), sizeof(word) );
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64( word );
 #endif
+    if (num_bits - w*64 < 64)
+        word |= ~(uint64_t)0 << (num_bits - w*64);
+    return word;
+}
 
-    if ( run_size_int < 0 ) {
-        cerr << "Allocating a negative run of pages.\n";
-        return MINIBASE_FIRST_ERROR ( DBMGR, NEG_RUN_SIZE );
+// ********************************************************
+// Functions on the free-extent tree. A leaf is one word of the space
+// map; runs of free bits within it are found with count-trailing-zeros
+// rather than bit by bit.
+
+static void summarize_word( uint64_t used, ExtentNode& node )
+{
+    if (used == 0) {
+        node.prefix = node.suffix = node.longest = 64;
+        return;
+    }
+    node.prefix = __builtin_ctzll( used );
+    node.suffix = __builtin_clzll( used );
+    node.longest = 0;
+    for (unsigned pos = 0; pos < 64; ) {
+        uint64_t rest = used >> pos;
+        unsigned zeros = (rest == 0) ? 64 - pos : __builtin_ctzll( rest );
+        if (zeros > node.longest)
+            node.longest = zeros;
+        pos += zeros;
+        if (pos < 64)
+            pos += __builtin_ctzll( ~(used >> pos) );
     }
+}
 
-    unsigned run_size = run_size_int;
-    unsigned num_map_pages = (num_pages + bits_per_page - 1) / bits_per_page;
-    unsigned current_run_start = 0, current_run_length = 0;
+static void combine_nodes( unsigned n, unsigned half )
+{
+    const ExtentNode& left = extentTree[2*n];
+    const ExtentNode& right = extentTree[2*n+1];
+    ExtentNode& node = extentTree[n];
+    node.prefix = (left.prefix == half) ? half + right.prefix : left.prefix;
+    node.suffix = (right.suffix == half) ? half + left.suffix : right.suffix;
+    node.longest = left.suffix + right.prefix;
+    if (left.longest > node.longest)
+        node.longest = left.longest;
+    if (right.longest > node.longest)
+        node.longest = right.longest;
+}
 
+// Bring the leaves of words first_word..last_word, and all above them,
+// up to date with usedWords.
+static void update_extent_tree( unsigned first_word, unsigned last_word )
+{
+    unsigned lo = treeLeaves + first_word, hi = treeLeaves + last_word;
+    for (unsigned n = lo; n <= hi; n++)
+        summarize_word( usedWords[n - treeLeaves], extentTree[n] );
+    for (unsigned half = 64; lo > 1; half *= 2) {
+        lo /= 2;
+        hi /= 2;
+        for (unsigned n = lo; n <= hi; n++)
+            combine_nodes( n, half );
+    }
+}
 
-    // This loop goes over each page in the space map.
-    Status status;
-    for( unsigned i=0; i < num_map_pages; ++i ) {
+// Mark pages start..start+run_size-1 allocated (bit 1) or free.
+static void mark_extent( PageID start, unsigned run_size, int bit )
+{
+    if (run_size == 0)
+        return;
+    unsigned first_word = start / 64, last_word = (start + run_size - 1) / 64;
+    for (unsigned w = first_word; w <= last_word; w++) {
+        unsigned lo = (w == first_word) ? start % 64 : 0;
+        unsigned hi = (w == last_word) ? (start + run_size - 1) % 64 : 63;
+        uint64_t mask = (~(uint64_t)0 >> (63 - hi)) & (~(uint64_t)0 << lo);
+        if (bit)
+            usedWords[w] |= mask;
+        else
+            usedWords[w] &= ~mask;
+    }
+    update_extent_tree( first_word, last_word );
+}
 
+// The first page p at or after near with pages p..p+run_size-1 all
+// free, searching the subtree of node n, which covers size pages from
+// start; -1 if there is none. Only the path to near and one subtree
+// that is sure to hold such a run are descended, so this takes
+// O(log n) steps.
+static PageID find_extent( unsigned n, PageID start, unsigned size,
+                           unsigned run_size, PageID near )
+{
+    if (start + (PageID)size <= near || extentTree[n].longest < run_size)
+        return -1;
+
+    if (size == 64) {
+        uint64_t used = usedWords[n - treeLeaves];
+        for (unsigned pos = (near > start) ? near - start : 0; pos < 64; ) {
+            uint64_t rest = used >> pos;
+            unsigned zeros = (rest == 0) ? 64 - pos : __builtin_ctzll( rest );
+            if (zeros >= run_size)
+                return start + pos;
+            pos += zeros;
+            if (pos < 64)
+                pos += __builtin_ctzll( ~(used >> pos) );
+        }
+        return -1;
+    }
+
+    unsigned half = size / 2;
+    PageID mid = start + half;
+    PageID found = find_extent( 2*n, start, half, run_size, near );
+    if (found >= 0)
+        return found;
+
+      // A run across the middle: the free end of the left half and the
+      // free start of the right half.
+    if (near < mid) {
+        PageID run_start = mid - extentTree[2*n].suffix;
+        if (run_start < near)
+            run_start = near;
+        if ((unsigned)(mid - run_start) + extentTree[2*n+1].prefix >= run_size)
+            return run_start;
+    }
+    return find_extent( 2*n+1, mid, half, run_size, near );
+}
+
+// ********************************************************
+// This function makes the free-extent tree of the database, reading
+// the whole space map, unless it has it already.
+
+Status DB::build_extent_tree()
+{
+    if (treeFd == fd)
+        return OK;
+
+    unsigned num_words = (num_pages + 63) / 64;
+    for (treeLeaves = 1; treeLeaves < num_words; treeLeaves *= 2)
+        ;
+    uint64_t* words = (uint64_t*)malloc( treeLeaves * sizeof(uint64_t) );
+    for (unsigned w = num_words; w < treeLeaves; w++)
+        words[w] = ~(uint64_t)0;
+
+    unsigned num_map_pages = (num_pages + bits_per_page - 1) / bits_per_page;
+    for( unsigned i=0; i < num_map_pages; ++i ) {
         PageID pgid = 1 + i;    // The space map starts at page #1.
-          // Pin the space-map page.
         char* pg;
-        status = MINIBASE_BM->PinPage( pgid, (Page*&)pg );
-        if ( status != OK )
+        Status status = MINIBASE_BM->PinPage( pgid, (Page*&)pg );
+        if ( status != OK ) {
+            free( words );
             return MINIBASE_CHAIN_ERROR( DBMGR, status );
+        }
 
-
-          // How many bits should we examine on this page?
         unsigned num_bits_this_page = num_pages - i*bits_per_page;
         if ( num_bits_this_page > bits_per_page )
             num_bits_this_page = bits_per_page;
+        for ( unsigned w=0; w*64 < num_bits_this_page; ++w )
+            words[i*(bits_per_page/64) + w] = map_word( pg, w, num_bits_this_page );
 
-
-          // Walk the page looking for a sequence of 0 bits of the appropriate
-          // length.  The outer loop steps through the page's bytes, the inner
-          // one steps through each byte's bits.
-        for ( ; num_bits_this_page > 0 && current_run_length < run_size; ++pg )
-            for ( unsigned mask=1;
-				(mask < 256) && (num_bits_this_page > 0) && (current_run_length < run_size);
-				mask <<= 1, --num_bits_this_page )
-			{
-				if ( *pg & mask )
-				{
-					current_run_start += current_run_length + 1;
-					current_run_length = 0;
-				}
-				else
-					++current_run_length;
-			}
-
-          // Unpin the space-map page.
         status = MINIBASE_BM->UnpinPage( pgid );
-        if ( status != OK )
+        if ( status != OK ) {
+            free( words );
             return MINIBASE_CHAIN_ERROR( DBMGR, status );
+        }
+    }
+
+    ReleaseExtentTree( treeFd );
+    usedWords = words;
+    extentTree = (ExtentNode*)malloc( 2 * treeLeaves * sizeof(ExtentNode) );
+    update_extent_tree( 0, treeLeaves - 1 );
+    nextFit = 0;
+    treeFd = fd;
+    return OK;
+}
+
+static void ReleaseExtentTree( int fd )
+{
+    if (treeFd == fd) {
+        free( usedWords );
+        free( extentTree );
+        usedWords = NULL;
+        extentTree = NULL;
+        treeFd = -1;
+    }
+}
+
+// ********************************************************
+// This function allocates a run of pages, next-fit: the first free
+// run long enough from where the last allocation ended, wrapping
+// around to the start of the database if there is none after it.
+// Successive allocations so land one after the other, and freed pages
+// behind them are reused once the end has been reached.
+
+Status DB::AllocatePage(PageID& start_page_num, int run_size_int)
+{
+    Status status = AllocatePage( start_page_num, run_size_int, nextFit );
+    if ( status == OK )
+        nextFit = start_page_num + run_size_int;
+    return status;
+}
+
+// ********************************************************
+// This function allocates a run of pages as close after the page near
+// as there is room, so that the pages of one file can be kept
+// together, or if there is none after it, the first there is. It finds
+// the run in the free-extent tree in O(log n) steps.
+
+Status DB::AllocatePage(PageID& start_page_num, int run_size_int, PageID near)
+{
+#ifdef DEBUG
+    cout << "Allocating a run of "<< run_size_int << " pages near " << near << endl;
+#endif
+
+    if ( run_size_int < 0 ) {
+        cerr << "Allocating a negative run of pages.\n";
+        return MINIBASE_FIRST_ERROR ( DBMGR, NEG_RUN_SIZE );
     }
 
+    Status status = build_extent_tree();
+    if ( status != OK )
+        return status;
+
+    unsigned run_size = run_size_int;
+    unsigned tree_size = treeLeaves * 64;
+    if ( near < 0 || near >= (int) num_pages )
+        near = 0;
+    PageID found = find_extent( 1, 0, tree_size, run_size, near );
+    if ( found < 0 && near > 0 )
+        found = find_extent( 1, 0, tree_size, run_size, 0 );
 
-    if ( current_run_length >= run_size ) {
+    if ( found >= 0 ) {
 
-        start_page_num = current_run_start;
+        start_page_num = found;
 #ifdef DEBUG
         cout<<"Page allocated in get_free_pages:: "<< start_page_num << endl;
 #endif
@@ -304,6 +555,170 @@ Status DB::DeallocatePage(PageID start_page_num, int run_size)
     return set_bits( start_page_num, run_size, 0 );
 }
 
+// ***************************************************************
+// Functions on the in-memory directory. Callers hold dirLock: for
+// writing to change it, for reading to look things up.
+
+static unsigned hash_name( const char* fname )
+{
+    unsigned h = 2166136261u;       // FNV-1a
+    for ( ; *fname; ++fname )
+        h = (h ^ (unsigned char)*fname) * 16777619u;
+    return h % numBuckets;
+}
+
+static unsigned hash_page( PageID pid )
+{
+    return ((unsigned)pid * 2654435761u) % numBuckets;
+}
+
+static DirEntry* find_by_name( const char* fname )
+{
+    DirEntry* e = byName[hash_name( fname )];
+    while ( e != NULL && strcmp( e->fname, fname ) != 0 )
+        e = e->next_by_name;
+    return e;
+}
+
+static DirEntry* find_by_page( PageID pid )
+{
+    DirEntry* e = byPage[hash_page( pid )];
+    while ( e != NULL && e->pagenum != pid )
+        e = e->next_by_page;
+    return e;
+}
+
+static void link_entry( DirEntry* e )
+{
+    unsigned b = hash_name( e->fname );
+    e->next_by_name = byName[b];
+    byName[b] = e;
+    b = hash_page( e->pagenum );
+    e->next_by_page = byPage[b];
+    byPage[b] = e;
+}
+
+static void make_buckets( unsigned n )
+{
+    DirEntry** old = byName;
+    unsigned old_buckets = numBuckets;
+    numBuckets = n;
+    byName = (DirEntry**)calloc( n, sizeof(DirEntry*) );
+    free( byPage );
+    byPage = (DirEntry**)calloc( n, sizeof(DirEntry*) );
+    for ( unsigned b = 0; b < old_buckets; ++b )
+        for ( DirEntry* e = old[b], *next; e != NULL; e = next ) {
+            next = e->next_by_name;
+            link_entry( e );
+        }
+    free( old );
+}
+
+static void insert_entry( const char* fname, PageID pagenum, PageID header_page )
+{
+    if ( numEntries >= numBuckets )
+        make_buckets( 2 * numBuckets );
+    DirEntry* e = (DirEntry*)malloc( sizeof(DirEntry) );
+    strcpy( e->fname, fname );
+    e->pagenum = pagenum;
+    e->header_page = header_page;
+    link_entry( e );
+    ++numEntries;
+}
+
+static void remove_entry( DirEntry* e )
+{
+    DirEntry** p = &byName[hash_name( e->fname )];
+    while ( *p != e )
+        p = &(*p)->next_by_name;
+    *p = e->next_by_name;
+    p = &byPage[hash_page( e->pagenum )];
+    while ( *p != e )
+        p = &(*p)->next_by_page;
+    *p = e->next_by_page;
+    free( e );
+    --numEntries;
+}
+
+static void free_directory()
+{
+    for ( unsigned b = 0; b < numBuckets; ++b )
+        for ( DirEntry* e = byName[b], *next; e != NULL; e = next ) {
+            next = e->next_by_name;
+            free( e );
+        }
+    free( byName );
+    free( byPage );
+    byName = byPage = NULL;
+    numBuckets = numEntries = 0;
+    dirFd = -1;
+}
+
+static void ReleaseDirectory( int fd )
+{
+    pthread_rwlock_wrlock( &dirLock );
+    if ( dirFd == fd )
+        free_directory();
+    pthread_rwlock_unlock( &dirLock );
+}
+
+// ***************************************************************
+// This function reads the directory from the header pages into memory.
+// The caller holds dirLock for writing.
+
+Status DB::load_directory()
+{
+    if ( dirFd != -1 )
+        free_directory();
+    make_buckets( 64 );
+    firstFreeHeader = 0;
+
+    Page copy;
+    char* pg = (char*)&copy;
+    PageID hpid, nexthpid = 0;
+    do {
+        hpid = nexthpid;
+        Status status = MINIBASE_BM->CopyPage( hpid, &copy );
+        if ( status != OK ) {
+            free_directory();
+            return MINIBASE_CHAIN_ERROR( DBMGR, status );
+        }
+
+        directory_page* dp = (hpid == 0)? &((first_page*)pg)->dir : (directory_page*)pg;
+        nexthpid = dp->next_page;
+        for ( unsigned entry = 0; entry < dp->num_entries; ++entry )
+            if ( dp->entries[entry].pagenum != INVALID_PAGE )
+                insert_entry( dp->entries[entry].fname, dp->entries[entry].pagenum, hpid );
+
+    } while ( nexthpid != INVALID_PAGE );
+
+    dirFd = fd;
+    return OK;
+}
+
+// ***************************************************************
+// This function takes dirLock, for writing if write is set, and
+// returns holding it with the directory of this database in memory.
+
+Status DB::lock_directory( int write )
+{
+    for (;;) {
+        if ( write )
+            pthread_rwlock_wrlock( &dirLock );
+        else
+            pthread_rwlock_rdlock( &dirLock );
+        if ( dirFd == fd )
+            return OK;
+
+        pthread_rwlock_unlock( &dirLock );
+        pthread_rwlock_wrlock( &dirLock );
+        Status status = (dirFd == fd) ? OK : load_directory();
+        pthread_rwlock_unlock( &dirLock );
+        if ( status != OK )
+            return status;
+    }
+}
+
 // ***********************************************************
 // This function adds a record containing the file name and the first page
 // of the file to the directory maintained in the header pages of the
@@ -322,10 +737,23 @@ Status DB::AddFileEntry(const char* fname, PageID start_page_num)
     if ((start_page_num < 0) || (start_page_num >= (int) num_pages) )
         return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
 
+    Status status = lock_directory( TRUE );
+    if ( status != OK )
+        return status;
+    status = add_file_entry( fname, start_page_num );
+    pthread_rwlock_unlock( &dirLock );
+    return status;
+}
 
+// ***************************************************************
+// This function does the work of AddFileEntry, holding dirLock. The
+// header pages are searched for a free slot from the first that may
+// have one.
+
+Status DB::add_file_entry(const char* fname, PageID start_page_num)
+{
       // Does the file already exist?
-    PageID tmp;
-    if ( GetFileEntry(fname,tmp) == OK )
+    if ( find_by_name( fname ) != NULL )
         return MINIBASE_FIRST_ERROR( DBMGR, DUPLICATE_ENTRY );
 
     char    *pg = 0;
@@ -333,7 +761,7 @@ Status DB::AddFileEntry(const char* fname, PageID start_page_num)
     directory_page* dp = 0;
     bool found = false;
     unsigned free_slot = 0;
-    PageID hpid, nexthpid = 0;
+    PageID hpid, nexthpid = firstFreeHeader;
 
     do {
         hpid = nexthpid;
@@ -399,6 +827,8 @@ Status DB::AddFileEntry(const char* fname, PageID start_page_num)
 
     dp->entries[free_slot].pagenum = start_page_num;
     strcpy( dp->entries[free_slot].fname, fname );
+    insert_entry( fname, start_page_num, hpid );
+    firstFreeHeader = hpid;
 
     status = MINIBASE_BM->UnpinPage( hpid , TRUE );
     if ( status != OK )
@@ -410,7 +840,7 @@ Status DB::AddFileEntry(const char* fname, PageID start_page_num)
 // ***************************************************************
 // This function deletes the file entry corresponding to the specified
 // file from the directory maintained in the header pages of the
-// database.
+// database. The in-memory directory knows which header page holds it.
 
 Status DB::DeleteFileEntry(const char* fname)
 {
@@ -418,48 +848,38 @@ Status DB::DeleteFileEntry(const char* fname)
     cout << "Deleting the file entry for " << fname << endl;
 #endif
 
-    char* pg = 0;
-    Status status;
-    directory_page* dp = 0;
-    bool found = false;
-    unsigned slot = 0;
-    PageID hpid, nexthpid = 0;
-
-    do {
-        hpid = nexthpid;
-          // Pin the header page.
-        status = MINIBASE_BM->PinPage( hpid, (Page*&)pg );
-        if ( status != OK )
-            return MINIBASE_CHAIN_ERROR( DBMGR, status );
-
-          // This complication is because the first page has a different
-          // structure from that of subsequent pages.
-        dp = (hpid == 0)? &((first_page*)pg)->dir : (directory_page*)pg;
-        nexthpid = dp->next_page;
-
-        unsigned entry = 0;
-        while ((entry < dp->num_entries)
-               && ((dp->entries[entry].pagenum == INVALID_PAGE)
-                  || (strcmp(fname,dp->entries[entry].fname) != 0)) )
-            ++entry;
-
-        if ( entry < dp->num_entries ) {
-            slot = entry;
-            found = true;
-          } else {
-            status = MINIBASE_BM->UnpinPage( hpid );
-            if ( status != OK )
-                return MINIBASE_CHAIN_ERROR( DBMGR, status );
-          }
-    } while ( nexthpid != INVALID_PAGE && !found );
-
+    Status status = lock_directory( TRUE );
+    if ( status != OK )
+        return status;
 
-    if ( !found )   // Entry not found - nothing deleted
+    DirEntry* e = find_by_name( fname );
+    if ( e == NULL ) {   // Entry not found - nothing deleted
+        pthread_rwlock_unlock( &dirLock );
         return MINIBASE_FIRST_ERROR( DBMGR, FILE_NOT_FOUND );
+    }
 
+    char* pg = 0;
+    PageID hpid = e->header_page;
+    status = MINIBASE_BM->PinPage( hpid, (Page*&)pg );
+    if ( status != OK ) {
+        pthread_rwlock_unlock( &dirLock );
+        return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    }
+
+      // This complication is because the first page has a different
+      // structure from that of subsequent pages.
+    directory_page* dp = (hpid == 0)? &((first_page*)pg)->dir : (directory_page*)pg;
+    for ( unsigned entry = 0; entry < dp->num_entries; ++entry )
+        if ( dp->entries[entry].pagenum == e->pagenum
+             && strcmp(fname,dp->entries[entry].fname) == 0 ) {
+            dp->entries[entry].pagenum = INVALID_PAGE;
+            break;
+        }
 
-      // Have to delete record at hpnum:slot
-    dp->entries[slot].pagenum = INVALID_PAGE;
+    remove_entry( e );
+      // The freed slot may be before the one AddFileEntry would start at.
+    firstFreeHeader = 0;
+    pthread_rwlock_unlock( &dirLock );
 
     status = MINIBASE_BM->UnpinPage( hpid , TRUE );
     if ( status != OK )
@@ -469,8 +889,8 @@ Status DB::DeleteFileEntry(const char* fname)
 }
 
 // ***************************************************************
-// This function gets the start page number for the specified file.
-// This is done by looking up the directory stored in the header pages.
+// This function gets the start page number for the specified file,
+// from the in-memory directory.
 
 Status DB::GetFileEntry(const char* fname, PageID& start_page)
 {
@@ -478,55 +898,47 @@ Status DB::GetFileEntry(const char* fname, PageID& start_page)
     cout << "Getting the file entry for " << fname << endl;
 #endif
 
-    char* pg = 0;
-    Status status;
-    directory_page* dp = 0;
-    bool found = false;
-    unsigned slot = 0;
-    PageID hpid, nexthpid = 0;
-
-    do {
-        hpid = nexthpid;
-          // Pin the header page.
-        status = MINIBASE_BM->PinPage( hpid, (Page*&)pg );
-        if ( status != OK )
-            return MINIBASE_CHAIN_ERROR( DBMGR, status );
-
-          // This complication is because the first page has a different
-          // structure from that of subsequent pages.
-        dp = (hpid == 0)? &((first_page*)pg)->dir : (directory_page*)pg;
-        nexthpid = dp->next_page;
-
-        unsigned entry = 0;
-        while ((entry < dp->num_entries)
-              && ((dp->entries[entry].pagenum == INVALID_PAGE)
-                 || (strcmp(fname,dp->entries[entry].fname) != 0)) )
-            ++entry;
+    Status status = lock_directory( FALSE );
+    if ( status != OK )
+        return status;
 
-        if ( entry < dp->num_entries ) {
-            slot = entry;
-            found = true;
-        }
+    DirEntry* e = find_by_name( fname );
+    if ( e != NULL )
+        start_page = e->pagenum;
+    pthread_rwlock_unlock( &dirLock );
 
-        status = MINIBASE_BM->UnpinPage( hpid );
-        if ( status != OK )
-            return MINIBASE_CHAIN_ERROR( DBMGR, status );
+    if ( e == NULL )   // Entry not found - don't post error, just fail.
+        return FAIL;
+    return OK;
+}
 
-    } while ((nexthpid != INVALID_PAGE) && !found );
+// ***************************************************************
+// This function gets the name of the file that starts at the given
+// page, the reverse of GetFileEntry. fname must have room for MAX_NAME
+// characters.
 
+Status DB::GetFileName(PageID start_page, char* fname)
+{
+    Status status = lock_directory( FALSE );
+    if ( status != OK )
+        return status;
 
-    if ( !found )   // Entry not found - don't post error, just fail.
-        return FAIL;
+    DirEntry* e = (start_page != INVALID_PAGE) ? find_by_page( start_page ) : NULL;
+    if ( e != NULL )
+        strcpy( fname, e->fname );
+    pthread_rwlock_unlock( &dirLock );
 
-    start_page = dp->entries[slot].pagenum;
-    return OK;
+    // Not found - don't post error, just fail.
+    return (e != NULL) ? OK : FAIL;
 }
 
 // **************************************************************
 // This function reads the contents of the page into the specified
 // memory area.
 // The exact position in the file where reading has to start is found
-// through the page number.
+// through the page number. One pread does it without touching the
+// file offset, so any number of threads can read and write pages at
+// once.
 
 
 Status DB::ReadPage(PageID pageno, Page* pageptr)
@@ -538,19 +950,219 @@ Status DB::ReadPage(PageID pageno, Page* pageptr)
     if ((pageno < 0) || (pageno >= (int) num_pages))
         return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
 
-    // Seek to the correct page
-    if (_lseek( fd, (long)pageno*MINIBASE_PAGESIZE, SEEK_SET ) < 0 )
-        return MINIBASE_FIRST_ERROR( DBMGR, UNIX_ERROR );
+    long start = LatencyClock();
 
-	// Read the appropriate number of bytes.
-    if (_read( fd, pageptr, MINIBASE_PAGESIZE ) != MINIBASE_PAGESIZE )
+    if (pread( fd, pageptr, MINIBASE_PAGESIZE, (off_t)pageno*MINIBASE_PAGESIZE ) != MINIBASE_PAGESIZE )
         return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
 
+    RecordLatency( READ_PAGE_LATENCY, start );
     return OK;
 }
 
 // ******************************************************
-// This function writes out the given page to disk.
+// This function reads a run of consecutive pages into memory areas
+// that may be anywhere, with one preadv per MAX_IOVECS pages.
+
+Status DB::ReadPages(PageID start_page_num, Page** pageptrs, int run_size)
+{
+    if ((start_page_num < 0) || (run_size < 1) ||
+        (start_page_num + run_size > (int) num_pages))
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+
+    struct iovec iov[MAX_IOVECS];
+    int done = 0;
+    while (done < run_size) {
+        int n = (run_size - done < MAX_IOVECS) ? run_size - done : MAX_IOVECS;
+        for (int i = 0; i < n; i++) {
+            iov[i].iov_base = pageptrs[done + i];
+            iov[i].iov_len = MINIBASE_PAGESIZE;
+        }
+        ssize_t len = (ssize_t)n * MINIBASE_PAGESIZE;
+        if (preadv( fd, iov, n, (off_t)(start_page_num + done)*MINIBASE_PAGESIZE ) != len)
+            return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+        done += n;
+    }
+
+    return OK;
+}
+
+// ******************************************************
+// This function writes out a run of consecutive pages whose contents
+// may be anywhere in memory, with one pwritev per MAX_IOVECS pages
+// instead of a seek and a write for each.
+
+Status DB::WritePages(PageID start_page_num, Page** pageptrs, int run_size)
+{
+    if ((start_page_num < 0) || (run_size < 1) ||
+        (start_page_num + run_size > (int) num_pages))
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+
+    struct iovec iov[MAX_IOVECS];
+    int done = 0;
+    while (done < run_size) {
+        int n = (run_size - done < MAX_IOVECS) ? run_size - done : MAX_IOVECS;
+        for (int i = 0; i < n; i++) {
+            iov[i].iov_base = pageptrs[done + i];
+            iov[i].iov_len = MINIBASE_PAGESIZE;
+        }
+        ssize_t len = (ssize_t)n * MINIBASE_PAGESIZE;
+        if (pwritev( fd, iov, n, (off_t)(start_page_num + done)*MINIBASE_PAGESIZE ) != len)
+            return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+        done += n;
+    }
+
+    return OK;
+}
+
+// ******************************************************
+// The engine for the database whose file is fd, made the first time
+// it is asked for; NULL if its requests are to be done at once.
+
+static AIOEngine* EngineOf( int fd )
+{
+    pthread_mutex_lock( &aioLock );
+    if (aioFd == -1) {
+        aio = AIOEngine::Create( fd, NULL );
+        aioFd = fd;
+    }
+    AIOEngine* engine = (aioFd == fd) ? aio : NULL;
+    pthread_mutex_unlock( &aioLock );
+    return engine;
+}
+
+static void ReleaseAsyncIO( int fd )
+{
+    pthread_mutex_lock( &aioLock );
+    if (aioFd == fd) {
+        delete aio;
+        aio = NULL;
+        aioFd = -1;
+    }
+    pthread_mutex_unlock( &aioLock );
+}
+
+// ******************************************************
+// These functions start a read or a write of a run of pages and
+// return without waiting for it. The request is handed to the engine
+// with one iovec per page, or, if there is none, done right here.
+
+static Status SubmitPages( int fd, AIOOp op, PageID start_page_num,
+                           Page** pageptrs, int run_size, AIORequest& request )
+{
+    request.op = op;
+    request.firstPid = start_page_num;
+    request.numOfPages = run_size;
+    for (int i = 0; i < run_size; i++) {
+        request.iov[i].iov_base = pageptrs[i];
+        request.iov[i].iov_len = MINIBASE_PAGESIZE;
+    }
+
+    AIOEngine* engine = EngineOf( fd );
+    if (engine != NULL) {
+        engine->Submit( &request );
+        return OK;
+    }
+
+    ssize_t len = (ssize_t)run_size * MINIBASE_PAGESIZE;
+    off_t offset = (off_t)start_page_num * MINIBASE_PAGESIZE;
+    ssize_t done = (op == AIO_READ) ? preadv( fd, request.iov, run_size, offset )
+                                    : pwritev( fd, request.iov, run_size, offset );
+    request.status = (done == len) ? OK : FAIL;
+    request.done = true;
+    return OK;
+}
+
+Status DB::SubmitReadPages(PageID start_page_num, Page** pageptrs,
+                           int run_size, AIORequest& request)
+{
+    request.status = FAIL;
+    request.done = true;
+    if ((start_page_num < 0) || (run_size < 1) || (run_size > AIO_MAX_RUN) ||
+        (start_page_num + run_size > (int) num_pages))
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+
+    return SubmitPages( fd, AIO_READ, start_page_num, pageptrs, run_size, request );
+}
+
+Status DB::SubmitWritePages(PageID start_page_num, Page** pageptrs,
+                            int run_size, AIORequest& request)
+{
+    request.status = FAIL;
+    request.done = true;
+    if ((start_page_num < 0) || (run_size < 1) || (run_size > AIO_MAX_RUN) ||
+        (start_page_num + run_size > (int) num_pages))
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+
+    return SubmitPages( fd, AIO_WRITE, start_page_num, pageptrs, run_size, request );
+}
+
+// ******************************************************
+// This function waits for a read or write started by SubmitReadPages
+// or SubmitWritePages.
+
+Status DB::WaitIO(AIORequest& request)
+{
+    // A request that was done at once is done for the engine too.
+    AIOEngine* engine = EngineOf( fd );
+    if (engine != NULL) engine->Wait( &request );
+    if (request.status != OK)
+        return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
+    return OK;
+}
+
+// ******************************************************
+// These functions choose and tell the engine of the database. The old
+// engine is shut down first, so nothing may be in flight.
+
+Status DB::SetAsyncIO(const char* engine)
+{
+    Status status = OK;
+    pthread_mutex_lock( &aioLock );
+    if (aioFd != -1 && aioFd != fd) {
+        status = MINIBASE_FIRST_ERROR( DBMGR, AIO_ENGINE_IN_USE );
+    } else {
+        delete aio;
+        aio = NULL;
+        aioFd = fd;
+        if (strcmp( engine, "sync" ) != 0) {
+            aio = AIOEngine::Create( fd, engine );
+            if (aio == NULL) {
+                aioFd = -1;
+                status = FAIL;
+            }
+        }
+    }
+    pthread_mutex_unlock( &aioLock );
+    return status;
+}
+
+const char* DB::GetAsyncIO()
+{
+    AIOEngine* engine = EngineOf( fd );
+    return (engine != NULL) ? engine->GetName() : "sync";
+}
+
+// ******************************************************
+// This function asks the OS to read a run of pages into its cache in
+// the background, so that the ReadPage calls that follow do not wait
+// for the disk. It is only a hint: it never fails because of I/O.
+
+Status DB::PrefetchPages(PageID start_page_num, int run_size)
+{
+    if ((start_page_num < 0) || (run_size < 1) ||
+        (start_page_num + run_size > (int) num_pages))
+        return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
+
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise( fd, (off_t)start_page_num*MINIBASE_PAGESIZE,
+                   (off_t)run_size*MINIBASE_PAGESIZE, POSIX_FADV_WILLNEED );
+#endif
+    return OK;
+}
+
+// ******************************************************
+// This function writes out the given page to disk, with one pwrite
+// like ReadPage.
 
 Status DB::WritePage(PageID pageno, Page* pageptr)
 {
@@ -564,21 +1176,20 @@ Status DB::WritePage(PageID pageno, Page* pageptr)
         return MINIBASE_FIRST_ERROR( DBMGR, BAD_PAGE_NO );
     }
 
-      // Seek to the correct page
-    if (_lseek( fd, (long)pageno*MINIBASE_PAGESIZE, SEEK_SET ) < 0 )
-        return MINIBASE_FIRST_ERROR( DBMGR, UNIX_ERROR );
+    long start = LatencyClock();
 
-      // Write the appropriate number of bytes.
-    if (_write( fd, pageptr, MINIBASE_PAGESIZE ) != MINIBASE_PAGESIZE )
+    if (pwrite( fd, pageptr, MINIBASE_PAGESIZE, (off_t)pageno*MINIBASE_PAGESIZE ) != MINIBASE_PAGESIZE )
         return MINIBASE_FIRST_ERROR( DBMGR, FILE_IO_ERROR );
 
+    RecordLatency( WRITE_PAGE_LATENCY, start );
     return OK;
 }
 
 // *******************************************************
 // The following function sets a given number of page bits in the
 // space map to the given bit value.  This function is used both
-// for allocating and deallocating pages in the space map.
+// for allocating and deallocating pages in the space map, and
+// keeps the free-extent tree in step with it.
 
 Status DB::set_bits( PageID start_page, unsigned run_size, int bit )
 {
@@ -590,6 +1201,8 @@ Status DB::set_bits( PageID start_page, unsigned run_size, int bit )
     dump_space_map();
 #endif
 
+    unsigned num_bits = run_size;
+
       // Locate the run within the space map.
     int first_map_page = start_page / bits_per_page + 1;
     int last_map_page = (start_page+run_size-1) / bits_per_page + 1;
@@ -642,6 +1255,8 @@ Status DB::set_bits( PageID start_page, unsigned run_size, int bit )
             return MINIBASE_CHAIN_ERROR( DBMGR, status );
     }
 
+    if ( treeFd == fd )
+        mark_extent( start_page, num_bits, bit );
 
 #ifdef DEBUG
     printf("set_bits:: space_map_afterwards \n");
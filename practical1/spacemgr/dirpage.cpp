@@ -10,6 +10,8 @@ Status DirPage::Init(PageID pid)
 	curr = pid;
 	next = INVALID_PAGE;
 	prev = INVALID_PAGE;
+	firstSpare = INVALID_PAGE;
+	numOfSpares = 0;
 
 	return OK;
 }
@@ -76,20 +78,20 @@ Status DirPage::DeleteItSelf()
 {
 	if (next != INVALID_PAGE)
 	{
-		DirPage *nextPage;
+		PinnedPage<DirPage> nextPage;
 
-		PIN(next, nextPage);
+		PIN_GUARD(next, nextPage);
 		nextPage->SetPrevPage(prev);
-		UNPIN(next, DIRTY);
+		UNPIN_GUARD(nextPage, DIRTY);
 	}
 
 	if (prev != INVALID_PAGE)
 	{
-		DirPage *prevPage;
+		PinnedPage<DirPage> prevPage;
 
-		PIN(prev, prevPage);
+		PIN_GUARD(prev, prevPage);
 		prevPage->SetNextPage(next);
-		UNPIN(prev, DIRTY);
+		UNPIN_GUARD(prevPage, DIRTY);
 	}
 
 	return OK;
@@ -194,18 +196,17 @@ DirPageIterator::~DirPageIterator()
 
 PageID DirPageIterator::operator() ()
 {
-	DirPage *page;
-	PageID next;
+	PinnedPage<DirPage> page;
 	PageID toReturn;
 
 	toReturn = curr;
 
 	if (curr != INVALID_PAGE)
 	{
-		MINIBASE_BM->PinPage(curr, (Page *&)page);
-		next = page->next;
-		MINIBASE_BM->UnpinPage(curr);
-		curr = next;
+		if (MINIBASE_BM->PinPage(curr, page) == OK)
+			curr = page->next;
+		else
+			curr = INVALID_PAGE;
 	}
 
 	return toReturn;
@@ -27,8 +27,12 @@ static int breakpoint()
 
 HeapFile::HeapFile( const char *name, Status& returnStatus )
 {
-	DirPage *page;
+	PinnedPage<DirPage> page;
 	Status s;
+
+	ring = NULL;
+	nextSparePid = INVALID_PAGE;
+	numOfSpares = 0;
 	
 	if (name == NULL)
 	{
@@ -36,7 +40,7 @@ HeapFile::HeapFile( const char *name, Status& returnStatus )
 		filename = tmpnam(NULL);
 		type = TEMPORARY;
 		
-		s = MINIBASE_BM->NewPage(dirPid, (Page *&)page);
+		s = MINIBASE_BM->NewPage(dirPid, page);
 		if (s != OK)
 		{
 			cerr << "Error creating new file.\n" << endl;
@@ -54,7 +58,7 @@ HeapFile::HeapFile( const char *name, Status& returnStatus )
 		
 		// Create a new DirPage.
 		
-		s = MINIBASE_BM->NewPage(dirPid, (Page *&)page);
+		s = MINIBASE_BM->NewPage(dirPid, page);
 		if (s != OK)
 		{
 			cerr << "Error creating new file.\n" << endl;
@@ -73,9 +77,8 @@ HeapFile::HeapFile( const char *name, Status& returnStatus )
 		filename = strcpy((char *)malloc(strlen(name)+1), name);
 		type = PERMENANT;
 
-		DirPage *page;
-
-		s = MINIBASE_BM->PinPage(dirPid, (Page *&)page);
+		StatScope tag(dirPid);
+		s = MINIBASE_BM->PinPage(dirPid, page);
 		if (s != OK)
 		{
 			cerr << "HeapFile::HeapFile - Error pinning the directories\n";
@@ -87,14 +90,14 @@ HeapFile::HeapFile( const char *name, Status& returnStatus )
 		PageID prevPid = dirPid;
 		while ((currPid = page->GetNextPage()) != INVALID_PAGE)
 		{
-			s = MINIBASE_BM->UnpinPage(prevPid);
+			s = page.Release();
 			if (s != OK)
 			{
 				cerr << "HeapFile::HeapFile - Error unpinning the directories\n";
 				returnStatus = FAIL;
 				return;
 			}
-			s = MINIBASE_BM->PinPage(currPid, (Page *&)page);
+			s = MINIBASE_BM->PinPage(currPid, page);
 			if (s != OK)
 			{
 				cerr << "HeapFile::HeapFile - Error pinning the directories\n";
@@ -105,7 +108,17 @@ HeapFile::HeapFile( const char *name, Status& returnStatus )
 		}
 
 		lastDirPid = prevPid;
-		s = MINIBASE_BM->UnpinPage(prevPid);
+		s = page.Release();
+		if (s == OK)
+		{
+			// Pick up the pages of the last extent not used yet.
+			s = MINIBASE_BM->PinPage(dirPid, page);
+			if (s == OK)
+			{
+				nextSparePid = page->GetSpares(numOfSpares);
+				s = page.Release();
+			}
+		}
 		if (s != OK)
 		{
 			cerr << "Error unpinning the directories\n";
@@ -129,7 +142,8 @@ HeapFile::HeapFile( const char *name, Status& returnStatus )
 	
 	lastDirPid = dirPid;
 
-	s = MINIBASE_BM->UnpinPage(dirPid, DIRTY);
+	page.MarkDirty();
+	s = page.Release();
 	if (s != OK)
 	{
 		cerr << "Error unpinning the directory." << endl;
@@ -154,6 +168,30 @@ HeapFile::~HeapFile()
 {
 	if (type == TEMPORARY)
 		DeleteFile();
+	delete ring;
+}
+
+
+//-----------------------------------------------------------------------
+// HeapFile::BeginBulkLoad, HeapFile::EndBulkLoad
+//
+// Purpose  : Start and end a bulk load. In between, InsertRecord
+//            creates and fills data pages through a private ring of
+//            BULK_LOAD_RING_SIZE frames, which writes each filled page
+//            back when it recycles its frame, so a large load leaves
+//            the rest of the buffer pool alone.
+//-----------------------------------------------------------------------
+
+void HeapFile::BeginBulkLoad()
+{
+	if (ring == NULL)
+		ring = new BufferRing(BULK_LOAD_RING_SIZE);
+}
+
+void HeapFile::EndBulkLoad()
+{
+	delete ring;
+	ring = NULL;
 }
 
 
@@ -170,23 +208,33 @@ HeapFile::~HeapFile()
 
 Status HeapFile::DeleteFile()
 {
+	StatScope tag(dirPid);   // charge the buffer pool statistics to this file
 	DirPageIterator nextDirPage(dirPid);
-	DirPage *dirPage;
+	PinnedPage<DirPage> dirPage;
 	PageID currDirPid;
 	PageInfo *info;
 
+	// The pages allocated but not in the directory yet.
+	PIN_GUARD(dirPid, dirPage);
+	PageID spare = dirPage->GetSpares(numOfSpares);
+	for (; numOfSpares > 0; numOfSpares--)
+	{
+		FREEPAGE(spare++);
+	}
+	nextSparePid = INVALID_PAGE;
+	UNPIN_GUARD(dirPage, CLEAN);
+
 	while ((currDirPid = nextDirPage()) != INVALID_PAGE)
 	{
-		PIN(currDirPid, dirPage);
-		PageInfoIterator nextPageInfo(dirPage);
+		PIN_GUARD(currDirPid, dirPage);
+		PageInfoIterator nextPageInfo(dirPage.Get());
 
 		while (info = nextPageInfo())
 		{
 			FREEPAGE(info->pid);
 		}
 
-		UNPIN(currDirPid, CLEAN);
-		FREEPAGE(currDirPid);
+		FREEPAGE_GUARD(dirPage);
 	} 
 
 	if (type == PERMENANT)
@@ -207,21 +255,22 @@ Status HeapFile::DeleteFile()
 
 int HeapFile::GetNumOfRecords()
 {
+	StatScope tag(dirPid);
 	DirPageIterator nextDirPage(dirPid);
-	DirPage *dirPage;
+	PinnedPage<DirPage> dirPage;
 	PageID currDirPid;
 	PageInfo *info;
 	int sum = 0;
 
 	while ((currDirPid = nextDirPage()) != INVALID_PAGE)
 	{
-		PIN(currDirPid, dirPage);
-		PageInfoIterator nextPageInfo(dirPage);
+		PIN_GUARD(currDirPid, dirPage);
+		PageInfoIterator nextPageInfo(dirPage.Get());
 		while (info = nextPageInfo())
 		{
 			sum += info->numOfRecords;
 		}
-		UNPIN(currDirPid, CLEAN);
+		UNPIN_GUARD(dirPage, CLEAN);
 	} 
 
     return sum;
@@ -244,7 +293,8 @@ int HeapFile::GetNumOfRecords()
             
 Status HeapFile::InsertRecord(char *recPtr, int recLen, RecordID& outRid)
 {
-	DirPage *dirPage;
+	StatScope tag(dirPid);
+	PinnedPage<DirPage> dirPage;
 	PageID   currDirPid;
 	PageID   pid;
 
@@ -260,9 +310,9 @@ Status HeapFile::InsertRecord(char *recPtr, int recLen, RecordID& outRid)
 	currDirPid = dirPid;
 	do 
 	{
-		PIN(currDirPid, dirPage);
+		PIN_GUARD(currDirPid, dirPage);
 		
-		PageInfoIterator nextPageInfo(dirPage);
+		PageInfoIterator nextPageInfo(dirPage.Get());
 		while (info = nextPageInfo())
 		{
 			if (info->spaceAvailable > (short)recLen) 
@@ -272,7 +322,7 @@ Status HeapFile::InsertRecord(char *recPtr, int recLen, RecordID& outRid)
 		if (info != NULL)
 			break;
 
-		UNPIN(currDirPid, CLEAN);
+		UNPIN_GUARD(dirPage, CLEAN);
 
 	} while ((currDirPid = nextDirPage()) != INVALID_PAGE);
 
@@ -282,23 +332,28 @@ Status HeapFile::InsertRecord(char *recPtr, int recLen, RecordID& outRid)
 		// Create a new data page pid, whose dirPageRecord
 		// resides on currDirPid
 
-		NewPage(pid, currDirPid);
-		PIN(currDirPid, dirPage);
+		if (NewPage(pid, currDirPid) != OK)
+			return FAIL;
+		PIN_GUARD(currDirPid, dirPage);
 	}
 	else
 	{
 		pid = info->pid;
 	}
 
-	HeapPage *page;
+	PinnedPage<HeapPage> page;
 	// Insert into this page.
 
-	PIN(pid, page);
+	if (MINIBASE_BM->PinPage(pid, page, FALSE, ring) != OK)
+	{
+		cerr << "Unable to pin page " << pid << endl;
+		return FAIL;
+	}
 	page->InsertRecord(recPtr, recLen, outRid);
-	dirPage->InsertRecordIntoPage(pid, page);
+	dirPage->InsertRecordIntoPage(pid, page.Get());
 	
-	UNPIN(pid, DIRTY);
-	UNPIN(currDirPid, DIRTY);
+	UNPIN_GUARD(page, DIRTY);
+	UNPIN_GUARD(dirPage, DIRTY);
 
 
 	return OK;
@@ -318,11 +373,15 @@ Status HeapFile::InsertRecord(char *recPtr, int recLen, RecordID& outRid)
 
 Status HeapFile::GetRecord (const RecordID& rid, char *recPtr, int& recLen)
 {
-	HeapPage *page;
+	StatScope tag(dirPid);
+	// A copy of the page will do, and is usually had without pinning it.
+	Page copy;
 
-	PIN(rid.pageNo, page);
-	page->GetRecord(rid, recPtr, recLen);
-	UNPIN(rid.pageNo, CLEAN);
+	if (MINIBASE_BM->CopyPage(rid.pageNo, &copy) != OK) {
+		cerr << "Unable to read page " << rid.pageNo << endl;
+		return FAIL;
+	}
+	((HeapPage *)&copy)->GetRecord(rid, recPtr, recLen);
 
 	return OK;
 }
@@ -344,15 +403,16 @@ Status HeapFile::GetRecord (const RecordID& rid, char *recPtr, int& recLen)
 
 Status HeapFile::DeleteRecord (const RecordID& rid)
 {
+	StatScope tag(dirPid);
 	DirPageIterator nextDirPage(dirPid);
-	DirPage *dirPage;
+	PinnedPage<DirPage> dirPage;
 	PageID currDirPid;
 	PageInfo *info;
 
 	while ((currDirPid = nextDirPage()) != INVALID_PAGE)
 	{
-		PIN(currDirPid, dirPage);
-		PageInfoIterator nextPageInfo(dirPage);
+		PIN_GUARD(currDirPid, dirPage);
+		PageInfoIterator nextPageInfo(dirPage.Get());
 		
 		while (info = nextPageInfo())
 		{
@@ -365,7 +425,7 @@ Status HeapFile::DeleteRecord (const RecordID& rid)
 			break;
 		}
 
-		UNPIN(currDirPid, CLEAN);
+		UNPIN_GUARD(dirPage, CLEAN);
 	} 
 
 	if (currDirPid == INVALID_PAGE)
@@ -376,21 +436,21 @@ Status HeapFile::DeleteRecord (const RecordID& rid)
 	{
 		// Delete the record.
 		// First from the data page.
-		HeapPage *page;
+		PinnedPage<HeapPage> page;
 
-		PIN(info->pid, page);
+		PIN_GUARD(info->pid, page);
 		page->DeleteRecord(rid);
 
 		// Then update the PageInfo. ARRGGGH ! must update
 		// this everytime we change a page.
 
-		dirPage->DeleteRecordFromPage(info->pid, page);
+		dirPage->DeleteRecordFromPage(info->pid, page.Get());
 
 		if (page->IsEmpty())
 		{
 			// If HeapPage is now empty, we have to deallocate it.
 			
-			FREEPAGE(info->pid);
+			FREEPAGE_GUARD(page);
 			dirPage->DeletePage(info->pid);
 			if (dirPage->IsEmpty())
 			{
@@ -410,22 +470,22 @@ Status HeapFile::DeleteRecord (const RecordID& rid)
 
 						dirPid = dirPage->GetNextPage();
 					}
-					FREEPAGE(currDirPid);
+					FREEPAGE_GUARD(dirPage);
 				}
 				else
 				{
-					UNPIN(currDirPid, DIRTY);
+					UNPIN_GUARD(dirPage, DIRTY);
 				}
 			}
 			else
 			{
-				UNPIN(currDirPid, DIRTY);
+				UNPIN_GUARD(dirPage, DIRTY);
 			}
 		}
 		else
 		{
-			UNPIN(info->pid, DIRTY);
-			UNPIN(currDirPid, DIRTY);
+			UNPIN_GUARD(page, DIRTY);
+			UNPIN_GUARD(dirPage, DIRTY);
 		}
 	}
 
@@ -446,27 +506,26 @@ Status HeapFile::DeleteRecord (const RecordID& rid)
 
 Status HeapFile::UpdateRecord (const RecordID& rid, char *recPtr, int recLen)
 { 
+	StatScope tag(dirPid);
 	DirPageIterator nextDirPage(dirPid);
-	DirPage *dirPage;
+	PinnedPage<DirPage> dirPage;
 	PageID currDirPid;
 	PageInfo *info;
 
 	while ((currDirPid = nextDirPage()) != INVALID_PAGE)
 	{
-		PIN(currDirPid, dirPage);
-		PageInfoIterator nextPageInfo(dirPage);
+		PIN_GUARD(currDirPid, dirPage);
+		PageInfoIterator nextPageInfo(dirPage.Get());
 		while (info = nextPageInfo())
 		{
 			if (info->pid == rid.pageNo) 
-			{
-				UNPIN(currDirPid, CLEAN);
 				break;
-			}
 		}
 
+		// info points into dirPage, so keep it pinned while info is used.
 		if (info != NULL)
 			break;
-		UNPIN(currDirPid, CLEAN);
+		UNPIN_GUARD(dirPage, CLEAN);
 	} 
 
 	if (currDirPid == INVALID_PAGE)
@@ -475,11 +534,11 @@ Status HeapFile::UpdateRecord (const RecordID& rid, char *recPtr, int recLen)
 	}
 	else
 	{
-		HeapPage *page;
+		PinnedPage<HeapPage> page;
 		char *oldPtr;
 		int  oldLen;
 
-		PIN(info->pid, page);
+		PIN_GUARD(info->pid, page);
 		page->ReturnRecord(rid, oldPtr, oldLen);
 		
 		if (oldLen != recLen)
@@ -489,7 +548,7 @@ Status HeapFile::UpdateRecord (const RecordID& rid, char *recPtr, int recLen)
 		}
 
 		memcpy(oldPtr, recPtr, oldLen);	
-		UNPIN(info->pid, DIRTY);
+		UNPIN_GUARD(page, DIRTY);
 	}
           
 	return OK;
@@ -520,13 +579,76 @@ Scan *HeapFile::OpenScan(Status& status)
 
 PageID HeapFile::NextPage(PageID pid)
 {
-	HeapPage *page;
-	PageID next;
+	StatScope tag(dirPid);
+	PinnedPage<HeapPage> page;
 
-	PIN (pid, page);
-	next = page->GetNextPage();
-	UNPIN (pid, CLEAN);
-	return next;
+	PIN_GUARD (pid, page);
+	return page->GetNextPage();
+}
+
+
+//-----------------------------------------------------------------------
+// HeapFile::NewExtent, HeapFile::RecordSpares
+//
+// Purpose  : Allocate the next HEAP_EXTENT_SIZE data pages together,
+//            or fewer in a small pool or ring (see HEAP_EXTENT_SHARE),
+//            and fewer again, down to one, while the pool has too few
+//            frames free to pin them all. NewPage then adds them to
+//            the directory one at a time as the file grows, since a
+//            scan expects no data page to be empty, and only
+//            initializes each when it does, so none is written or read
+//            back before. Each extent is asked for right after the
+//            previous one (or, for a file just opened, its last
+//            directory page), so a sequential scan of the file reads
+//            mostly in page id order. RecordSpares keeps the pages not
+//            in the directory yet in the first directory page, where
+//            DeleteFile finds them to free, and the file picks them up
+//            again when it is next opened.
+// Return   : OK if successful, FAIL otherwise
+//-----------------------------------------------------------------------
+
+Status HeapFile::NewExtent()
+{
+	Page *pages[HEAP_EXTENT_SIZE];
+	PageID firstPid;
+	PageID near = (nextSparePid != INVALID_PAGE) ? nextSparePid : lastDirPid;
+
+	int size = HEAP_EXTENT_SIZE;
+	int share = (int)MINIBASE_BM->GetNumOfBuffers() / HEAP_EXTENT_SHARE;
+
+	if (size > share)
+		size = share;
+	if (ring != NULL && size > BULK_LOAD_RING_SIZE / 2)
+		size = BULK_LOAD_RING_SIZE / 2;
+	if (size < 1)
+		size = 1;
+	while (MINIBASE_BM->NewExtent(firstPid, pages, size, ring, near) != OK)
+	{
+		if (size == 1)
+		{
+			cerr << "Unable to allocate a new page" << endl;
+			return FAIL;
+		}
+		size /= 2;
+	}
+
+	for (int i = 0; i < size; i++)
+	{
+		UNPIN(firstPid + i, CLEAN);
+	}
+	nextSparePid = firstPid;
+	numOfSpares = size;
+	return RecordSpares();
+}
+
+Status HeapFile::RecordSpares()
+{
+	PinnedPage<DirPage> page;
+
+	PIN_GUARD(dirPid, page);
+	page->SetSpares(nextSparePid, numOfSpares);
+	UNPIN_GUARD(page, DIRTY);
+	return OK;
 }
 
 
@@ -534,17 +656,17 @@ Status HeapFile::NewPage(PageID &pid, PageID &currDirPid)
 {
 
 	DirPageIterator nextDirPage(dirPid);
-	DirPage *dirPage;
-	HeapPage *newDataPage;
+	PinnedPage<DirPage> dirPage;
+	PinnedPage<HeapPage> newDataPage;
 
 	while ((currDirPid = nextDirPage()) != INVALID_PAGE)
 	{
-		PIN(currDirPid, dirPage);
+		PIN_GUARD(currDirPid, dirPage);
 		if (dirPage->HasFreeSpace())
 		{
 			break;
 		}
-		UNPIN(currDirPid, CLEAN);
+		UNPIN_GUARD(dirPage, CLEAN);
 	}
 
 	if (currDirPid == INVALID_PAGE)
@@ -552,30 +674,40 @@ Status HeapFile::NewPage(PageID &pid, PageID &currDirPid)
 		// Directory Pages are full. Create new one.
 		// Insert at the end of the dirPage list
 
-		NEWPAGE (currDirPid, dirPage);
+		NEWPAGE_GUARD (currDirPid, dirPage);
 		dirPage->Init(currDirPid);
 		dirPage->SetNextPage(INVALID_PAGE);
 		dirPage->SetPrevPage(lastDirPid);
 
-		DirPage *lastPage;
+		PinnedPage<DirPage> lastPage;
 		
-		PIN(lastDirPid, lastPage);
+		PIN_GUARD(lastDirPid, lastPage);
 		lastPage->SetNextPage(currDirPid);
-		UNPIN(lastDirPid, DIRTY);
+		UNPIN_GUARD(lastPage, DIRTY);
 
 		lastDirPid = currDirPid;
 	}
 	
-	NEWPAGE (pid, newDataPage);
-	
+	if (numOfSpares == 0 && NewExtent() != OK)
+		return FAIL;
+
+	// The next page of the extent holds nothing yet, so it is pinned
+	// without being read.
+	pid = nextSparePid;
+	if (MINIBASE_BM->PinPage(pid, newDataPage, TRUE, ring) != OK)
+	{
+		cerr << "Unable to pin page " << pid << endl;
+		return FAIL;
+	}
 	newDataPage->Init(pid);
+	nextSparePid++;
+	numOfSpares--;
 
-	// Create a new page
-	dirPage->InsertPage(pid, newDataPage);
+	dirPage->InsertPage(pid, newDataPage.Get());
 
-	UNPIN(pid, DIRTY);
-	UNPIN(currDirPid, DIRTY);
+	UNPIN_GUARD(newDataPage, DIRTY);
+	UNPIN_GUARD(dirPage, DIRTY);
 
-	return OK;
+	return RecordSpares();
 }
 
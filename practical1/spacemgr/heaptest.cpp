@@ -8,6 +8,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <sys/time.h>
+#include <unistd.h>
 
 #include "../include/db.h"
 #include "../include/heapfile.h"
@@ -26,6 +28,13 @@ struct Rec
 
 static const int reclen = sizeof(Rec);
 
+#define TEST6_NUM_FILES 4000
+#define TEST6_STEP 1000
+#define TEST6_NUM_OPENS 500
+#define TEST6_NUM_PAGES 6000
+#define TEST6_DB "SCALE.DB"
+#define TEST6_LOG "SCALE.LOG"
+
 
 
 HeapDriver::HeapDriver() : TestDriver( "hftest" )
@@ -524,5 +533,150 @@ int HeapDriver::Test5()
 
 int HeapDriver::Test6()
 {
-    return TRUE;
+    cout << "\n  Test 6: Open files in a directory of thousands\n";
+    Status status = OK;
+
+    // Tests 1 to 5 fit in a small database; this needs a page for each
+    // file, and the directory pages. It gets a file of its own, as a
+    // database file is reused, space map and all, when created again.
+    delete minibase_globals;
+    minibase_globals = new SystemDefs(status, TEST6_DB, TEST6_LOG,
+		TEST6_NUM_PAGES, 500, 100, "Clock");
+    if (status != OK)
+	{
+        cerr << "*** Could not create a larger database\n";
+        return FALSE;
+	}
+
+    PageID *dirPids = new PageID[TEST6_NUM_FILES];
+    char name[MAX_NAME];
+    int n = 0;
+    while (status == OK && n < TEST6_NUM_FILES)
+	{
+        for (int end = n + TEST6_STEP; status == OK && n < end; n++)
+		{
+            sprintf(name, "scale_%d", n);
+            HeapFile f(name, status);
+            if (status != OK)
+                cerr << "*** Could not create heap file " << name << endl;
+            else
+                status = MINIBASE_DB->GetFileEntry(name, dirPids[n]);
+		}
+
+        // Opening a file looks it up in the directory; that should take
+        // as long with many files as with few.
+        unsigned int seed = n;
+        struct timeval initTime, endTime;
+        gettimeofday(&initTime, NULL);
+        for (int i = 0; status == OK && i < TEST6_NUM_OPENS; i++)
+		{
+            seed = seed * 1103515245 + 12345;
+            int k = (seed >> 8) % n;
+            sprintf(name, "scale_%d", k);
+            HeapFile f(name, status);
+            PageID pid;
+            if (status == OK && (MINIBASE_DB->GetFileEntry(name, pid) != OK || pid != dirPids[k]))
+			{
+                cerr << "*** Heap file " << name << " is not where it was created\n";
+                status = FAIL;
+			}
+		}
+        gettimeofday(&endTime, NULL);
+        double usecs = (endTime.tv_sec - initTime.tv_sec) * 1e6 + (endTime.tv_usec - initTime.tv_usec);
+        if (status == OK)
+            cout << "  - Open among " << n << " files: " << usecs / TEST6_NUM_OPENS << "us each\n";
+	}
+
+    if (status == OK)
+	{
+        cout << "  - Delete every other file\n";
+        for (int k = 0; status == OK && k < TEST6_NUM_FILES; k += 2)
+		{
+            sprintf(name, "scale_%d", k);
+            HeapFile f(name, status);
+            if (status == OK)
+                status = f.DeleteFile();
+		}
+        for (int k = 0; status == OK && k < TEST6_NUM_FILES; k++)
+		{
+            sprintf(name, "scale_%d", k);
+            PageID pid;
+            bool found = (MINIBASE_DB->GetFileEntry(name, pid) == OK);
+            if (found != (k % 2 == 1))
+			{
+                cerr << "*** Heap file " << name << (found ? " is still" : " is no longer") << " in the directory\n";
+                status = FAIL;
+			}
+		}
+	}
+
+    if (status == OK)
+	{
+        cout << "  - Create a deleted file again\n";
+        HeapFile f("scale_0", status);
+        PageID pid;
+        if (status == OK && MINIBASE_DB->GetFileEntry("scale_0", pid) != OK)
+		{
+            cerr << "*** Heap file scale_0 is not in the directory\n";
+            status = FAIL;
+		}
+	}
+
+    if (status == OK)
+	{
+        cout << "  - Reopen a file with pages of its last extent unused, and delete it\n";
+        Rec rec;
+        RecordID rid;
+        PageID firstPid = INVALID_PAGE;
+        memset(&rec, 0, reclen);
+        {
+            HeapFile f("spares", status);
+            if (status == OK)
+                status = f.InsertRecord((char *)&rec, reclen, rid);
+            firstPid = rid.pageNo;
+        }
+
+        // The file keeps the rest of the extent while it is closed.
+        if (status == OK)
+		{
+            HeapFile f("spares", status);
+            while (status == OK && rid.pageNo == firstPid)
+                status = f.InsertRecord((char *)&rec, reclen, rid);
+            if (status == OK && rid.pageNo != firstPid + 1)
+			{
+                cerr << "*** The reopened file did not go on with its extent\n";
+                status = FAIL;
+			}
+            if (status == OK)
+                status = f.DeleteFile();
+		}
+
+        // Then all of it is free again.
+        PageID pid;
+        if (status == OK)
+		{
+            if (MINIBASE_DB->AllocatePage(pid, HEAP_EXTENT_SIZE, firstPid) != OK || pid != firstPid)
+			{
+                cerr << "*** The unused pages of the deleted file were not freed\n";
+                status = FAIL;
+			}
+            else
+                status = MINIBASE_DB->DeallocatePage(pid, HEAP_EXTENT_SIZE);
+		}
+	}
+
+    delete[] dirPids;
+    delete minibase_globals;
+    unlink(TEST6_DB);
+    unlink(TEST6_LOG);
+
+    // Leave a small database behind for any test that runs next.
+    Status newStatus;
+    minibase_globals = new SystemDefs(newStatus, "MINIBASE.DB", "MINIBASE.LOG",
+		100, 500, 100, "Clock");
+    if (newStatus != OK)
+        status = FAIL;
+    if (status == OK)
+        cout << "  Test 6 completed successfully.\n";
+    return (status == OK);
 }
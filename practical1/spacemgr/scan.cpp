@@ -18,11 +18,17 @@ Scan::Scan (HeapFile *hf, Status& status)
 {
 	currDirPid = hf->GetFirstDirPage();
 	firstDirPid = currDirPid;
+	StatScope tag(firstDirPid);   // charge the buffer pool statistics to the file
 	currEntry = 0;
 	
 	noMore = FALSE;
+	numOfPagesRead = 0;
+	ring = NULL;
+	readAhead = READ_AHEAD_INIT;
+	prefetchEntry = 0;
+	readAtWindow = -1;
 	
-	MINIBASE_BM->PinPage(currDirPid, (Page *&)dirPage);
+	MINIBASE_BM->PinPage(currDirPid, dirPage);
 	
 	PageInfo *info;
 	
@@ -37,7 +43,9 @@ Scan::Scan (HeapFile *hf, Status& status)
 	else
 	{
 		currPid = info->pid;
-		MINIBASE_BM->PinPage(currPid, (Page *&)page);
+		status = PinCurrPage();
+		if (status != OK)
+			return;
 		status = page->FirstRecord(currRid);
 		if (status != OK)
 			return;
@@ -51,13 +59,91 @@ Scan::Scan (HeapFile *hf, Status& status)
 
 Scan::~Scan()
 {
-	// No error checking here. What can we do if something goes
-	// wrong ?
+	// page and dirPage unpin themselves. No error checking there.
+	// What can we do if something goes wrong ?
 
-	if (page) 
-		MINIBASE_BM->UnpinPage(currPid, CLEAN);
-	if (dirPage)
-		MINIBASE_BM->UnpinPage(currDirPid, CLEAN);
+	delete ring;
+}
+
+
+//------------------------------------------------------------------
+// Scan::PinCurrPage
+//
+// Purpose  : Pin the data page currPid into page. Once the scan has
+//            read a quarter of the buffer pool's worth of pages, it
+//            is a large scan and goes on through its own ring of
+//            SCAN_RING_SIZE frames. Directory pages always use the
+//            shared pool.
+// Return   : OK if successful, FAIL otherwise
+//------------------------------------------------------------------
+
+Status Scan::PinCurrPage()
+{
+	if (ring == NULL && numOfPagesRead >= (int)MINIBASE_BM->GetNumOfBuffers() / 4)
+		ring = new BufferRing(SCAN_RING_SIZE);
+	numOfPagesRead++;
+
+	ReadAhead();
+	if (MINIBASE_BM->PinPage(currPid, page, FALSE, ring) != OK)
+	{
+		cerr << "Unable to pin page " << currPid << endl;
+		return FAIL;
+	}
+	return OK;
+}
+
+
+//------------------------------------------------------------------
+// Scan::ReadAhead
+//
+// Purpose  : Keep the buffer manager prefetching the data pages listed
+//            on dirPage after the one about to be pinned (entry
+//            currEntry-1). A full window is issued when the scan moves
+//            onto a directory page, and the next one whenever less
+//            than half of the previous is left. The window adapts to
+//            the prefetch hit rate of the pins since the last one, see
+//            READ_AHEAD_INIT; the counts are the buffer pool's, so
+//            other scans blur them a little.
+//------------------------------------------------------------------
+
+void Scan::ReadAhead()
+{
+	if (prefetchEntry - currEntry > readAhead / 2)
+		return;
+	if (prefetchEntry < currEntry)
+		prefetchEntry = currEntry;
+
+	long prefetches, hits, wasted;
+	MINIBASE_BM->GetPrefetchStat(prefetches, hits, wasted);
+	int pinned = numOfPagesRead - readAtWindow;
+	if (readAtWindow >= 0 && pinned > 0)
+	{
+		if (wasted > prefetchWaste || 4 * (hits - prefetchHits) < pinned)
+			readAhead /= 2;
+		else if (4 * (hits - prefetchHits) >= 3 * pinned)
+			readAhead *= 2;
+	}
+	int limit = (ring != NULL) ? SCAN_RING_SIZE / 2 : READ_AHEAD_MAX;
+	if (readAhead > limit)
+		readAhead = limit;
+	if (readAhead < READ_AHEAD_MIN)
+		readAhead = READ_AHEAD_MIN;
+	readAtWindow = numOfPagesRead;
+	prefetchHits = hits;
+	prefetchWaste = wasted;
+
+	PageID pids[READ_AHEAD_MAX];
+	PageInfo *info;
+	int n = 0;
+	while (n < readAhead && (info = dirPage->GetPageInfo(prefetchEntry)) != NULL)
+	{
+		pids[n++] = info->pid;
+		prefetchEntry++;
+	}
+	if (n == 0)
+		return;
+
+	MINIBASE_BM->Prefetch(pids, n, ring);
 }
 
 
@@ -75,6 +161,7 @@ Scan::~Scan()
 
 Status Scan::GetNext(RecordID& rid, char *recPtr, int& recLen)
 {
+	StatScope tag(firstDirPid);
 	Status s;
 	
 	if (noMore)
@@ -97,8 +184,7 @@ Status Scan::GetNext(RecordID& rid, char *recPtr, int& recLen)
 		
 		PageInfo *info;
 		
-		UNPIN(currPid, CLEAN);
-		page = NULL;
+		UNPIN_GUARD(page, CLEAN);
 		info = dirPage->GetPageInfo(currEntry);
 		currEntry++;
 		if (info == NULL)
@@ -108,8 +194,7 @@ Status Scan::GetNext(RecordID& rid, char *recPtr, int& recLen)
 			PageID next;
 			
 			next = dirPage->GetNextPage();
-			UNPIN(currDirPid, CLEAN);
-			dirPage = NULL;
+			UNPIN_GUARD(dirPage, CLEAN);
 			if (next == INVALID_PAGE)
 			{
 				// No more record on this file !
@@ -117,14 +202,16 @@ Status Scan::GetNext(RecordID& rid, char *recPtr, int& recLen)
 				noMore = TRUE;
 				return OK;
 			}
-			PIN(next, dirPage);
+			PIN_GUARD(next, dirPage);
 			currDirPid = next;
 			currEntry = 0;
+			prefetchEntry = 0;
 			info = dirPage->GetPageInfo(currEntry);
 			currEntry++;
 		}
 		currPid = info->pid;
-		PIN(currPid, page);
+		if (PinCurrPage() != OK)
+			return FAIL;
 		
 		s = page->FirstRecord(currRid);
 		if (s != OK)
@@ -142,23 +229,15 @@ Status Scan::GetNext(RecordID& rid, char *recPtr, int& recLen)
 //		to get that record.
 Status Scan::MoveTo (RecordID rid)
 {
+	StatScope tag(firstDirPid);
 	currRid = rid;
 	if (currPid != rid.pageNo || noMore == (int)TRUE)
 	{	
 		// Damn. I forgot to unpin the current one 
 		// before I pin the new pages.
 
-		if (page != NULL) 
-		{
-			UNPIN(currPid, CLEAN);
-			page = NULL;
-		}
-
-		if (dirPage != NULL)
-		{
-			UNPIN(currDirPid, CLEAN);
-			dirPage = NULL;
-		}
+		UNPIN_GUARD(page, CLEAN);
+		UNPIN_GUARD(dirPage, CLEAN);
 
 		currPid = rid.pageNo;
 
@@ -167,9 +246,10 @@ Status Scan::MoveTo (RecordID rid)
 		
 		while ((currDirPid = nextDirPage()) != INVALID_PAGE)
 		{
-			PIN(currDirPid, dirPage);
-			PageInfoIterator nextPageInfo(dirPage);
+			PIN_GUARD(currDirPid, dirPage);
+			PageInfoIterator nextPageInfo(dirPage.Get());
 			currEntry = 0;
+			prefetchEntry = 0;
 			while (info = nextPageInfo())
 			{
 				currEntry++;
@@ -182,15 +262,14 @@ Status Scan::MoveTo (RecordID rid)
 				break;
 			}
 			
-			UNPIN(currDirPid, CLEAN);
-			dirPage = NULL;
+			UNPIN_GUARD(dirPage, CLEAN);
 		} 
 		if (info == NULL)
 		{
 			return FAIL;
 		}
 
-		PIN(currPid, page);		
+		PIN_GUARD(currPid, page);
 	}
 	
 	noMore = FALSE;
@@ -67,6 +67,21 @@ bool TestDriver::Test6()
     return true;
 }
 
+bool TestDriver::Test7()
+{
+    return true;
+}
+
+bool TestDriver::Test8()
+{
+    return true;
+}
+
+bool TestDriver::Test9()
+{
+    return true;
+}
+
 
 const char* TestDriver::TestName()
 {
@@ -187,14 +202,13 @@ Status TestDriver::RunAllTests()
 	const int inTxtLen = 32;
 	char *inputTxt = new char[inTxtLen];
 
-	//there are really 6 tests but the last one doesn't do anything so I'll only mention 1-5
 	cout << "Input a space separated test sequence (ie. a list of numbers " << endl <<
-		" in the range 1-5: 1 5 2 3) or hit ENTER to run all tests: ";
+		" in the range 1-6: 1 5 2 3) or hit ENTER to run all tests: ";
 
 	cin.getline ( inputTxt, inTxtLen );
 	if ( strlen(inputTxt) == 0 )
 	{
-		inputTxt = "12345";
+		inputTxt = "123456";
 	}	
 	for ( i = 0; i < (int)strlen(inputTxt); i++)
 	{
@@ -0,0 +1,486 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <iostream>
+
+using namespace std;
+
+#include "include/bufmgr.h"
+#include "include/db.h"
+#include "include/latency.h"
+
+int MINIBASE_RESTART_FLAG = 0;
+
+#define BENCH_DB "bmbench.minibase-db"
+#define BENCH_LOG "bmbench.minibase-log"
+#define NUM_PINS 4000000
+
+#define FLUSH_BUF_SIZE 16384
+
+#define WRITER_BUF_SIZE 256
+#define WRITER_NUM_PAGES 1024
+#define WRITER_NUM_PINS 400000
+#define WRITER_DIRTY_RATIO 0.02
+#define WRITER_INTERVAL 5
+
+#define READS_BUF_SIZE 1024
+#define READS_NUM_PAGES 16
+
+#define BLOCK_BUF_SIZE 1024
+#define BLOCK_NUM_PAGES 8192
+#define BLOCK_SIZE 256
+
+#define ALLOC_NUM_PAGES 65536
+#define ALLOC_NUM_OPS 20000
+
+// With --json, the writer benchmarks also dump all buffer manager
+// statistics as JSON, as monitoring would scrape them.
+static bool exportJSON = false;
+
+//--------------------------------------------------------------------
+// BenchPins
+//
+// Input    : bufSize - number of frames in the buffer pool
+// Purpose  : Fill most of a pool of bufSize frames with new pages,
+//            then pin and unpin randomly chosen resident pages. Every
+//            pin is a hit, so the rate only measures the frame lookup
+//            and should stay flat as the pool grows.
+// Return   : OK if the benchmark ran, FAIL otherwise.
+//--------------------------------------------------------------------
+
+static Status BenchPins(int bufSize)
+{
+	Status status;
+	minibase_globals = new SystemDefs(status, BENCH_DB, BENCH_LOG,
+		bufSize + 64, 500, bufSize, "Clock");
+	if (status != OK) return status;
+
+	// Leave room for the DB header and space map pages.
+	int numPages = bufSize - 16;
+	PageID *pids = new PageID[numPages];
+	Page *pg;
+	for (int i = 0; status == OK && i < numPages; i++) {
+		status = MINIBASE_BM->NewPage(pids[i], pg);
+		if (status == OK) status = MINIBASE_BM->UnpinPage(pids[i], true);
+	}
+
+	if (status == OK) {
+		MINIBASE_BM->ResetStat();
+		unsigned int seed = 12345;
+		clock_t initTime = clock();
+		for (int i = 0; status == OK && i < NUM_PINS; i++) {
+			seed = seed * 1103515245 + 12345;
+			PageID pid = pids[(seed >> 8) % numPages];
+			status = MINIBASE_BM->PinPage(pid, pg);
+			if (status == OK) status = MINIBASE_BM->UnpinPage(pid);
+		}
+		clock_t endTime = clock();
+
+		long pins, misses;
+		MINIBASE_BM->GetStat(pins, misses);
+		double secs = (endTime - initTime) / (double)CLOCKS_PER_SEC;
+		cout << "  - " << MINIBASE_BM->GetNumOfBuffers() << " frames: "
+			 << (long)(pins / secs) << " pins/sec (" << misses << " misses)\n";
+	}
+
+	delete[] pids;
+	delete minibase_globals;
+	minibase_globals = 0;
+	remove(BENCH_DB);
+	remove(BENCH_LOG);
+	return status;
+}
+
+//--------------------------------------------------------------------
+// BenchWriter
+//
+// Input    : background - whether to run the background writer
+// Purpose  : Pin and unpin random pages of a file four times the size
+//            of the pool, dirtying one in five, and report how many
+//            dirty victims PinPage had to write itself.
+// Return   : OK if the benchmark ran, FAIL otherwise.
+//--------------------------------------------------------------------
+
+static Status BenchWriter(bool background)
+{
+	Status status;
+	minibase_globals = new SystemDefs(status, BENCH_DB, BENCH_LOG,
+		WRITER_NUM_PAGES + 64, 500, WRITER_BUF_SIZE, "Clock");
+	if (status != OK) return status;
+
+	PageID firstPid;
+	Page *pg;
+	status = MINIBASE_BM->NewPage(firstPid, pg, WRITER_NUM_PAGES);
+	if (status == OK) status = MINIBASE_BM->UnpinPage(firstPid);
+	if (status == OK && background) status = MINIBASE_BM->StartBackgroundWriter(WRITER_DIRTY_RATIO, WRITER_INTERVAL);
+
+	if (status == OK) {
+		MINIBASE_BM->ResetStat();
+		unsigned int seed = 12345;
+		struct timeval initTime, endTime;
+		gettimeofday(&initTime, NULL);
+		for (int i = 0; status == OK && i < WRITER_NUM_PINS; i++) {
+			seed = seed * 1103515245 + 12345;
+			PageID pid = firstPid + (seed >> 8) % WRITER_NUM_PAGES;
+			status = MINIBASE_BM->PinPage(pid, pg, i < WRITER_NUM_PAGES);
+			if (status == OK) status = MINIBASE_BM->UnpinPage(pid, (seed >> 4) % 5 == 0);
+		}
+		gettimeofday(&endTime, NULL);
+
+		long foreground, background;
+		MINIBASE_BM->GetWriteStat(foreground, background);
+		LatencyHistogram pins;
+		GetLatencyHistogram(PIN_PAGE_LATENCY, pins);
+		double secs = (endTime.tv_sec - initTime.tv_sec) + (endTime.tv_usec - initTime.tv_usec) / 1e6;
+		cout << "  - " << (background ? "with" : "without") << " background writer: "
+			 << (long)(WRITER_NUM_PINS / secs) << " pins/sec, " << foreground
+			 << " foreground writes, " << background << " background writes, PinPage p50 "
+			 << pins.Percentile(0.5) << "ns p99 " << pins.Percentile(0.99) << "ns\n";
+		if (exportJSON) MINIBASE_BM->ExportStat(cout, STAT_JSON);
+	}
+
+	delete minibase_globals;
+	minibase_globals = 0;
+	remove(BENCH_DB);
+	remove(BENCH_LOG);
+	return status;
+}
+
+//--------------------------------------------------------------------
+// BenchReads
+//
+// Input    : mode - 0: PinPage/UnpinPage around each read
+//                   1: an optimistic read, starting afresh each time
+//                   2: an optimistic read, keeping one OptimisticRead
+//                      per page between reads
+// Purpose  : Read one word from randomly chosen pages of a small hot
+//            set, as a directory or index lookup would.
+// Return   : OK if the benchmark ran, FAIL otherwise.
+//--------------------------------------------------------------------
+
+static Status BenchReads(int mode)
+{
+	static const char *modes[] = { "pin and unpin", "optimistic", "optimistic, kept" };
+	Status status;
+	minibase_globals = new SystemDefs(status, BENCH_DB, BENCH_LOG,
+		READS_BUF_SIZE + 64, 500, READS_BUF_SIZE, "Clock");
+	if (status != OK) return status;
+
+	PageID firstPid;
+	Page *pg;
+	status = MINIBASE_BM->NewPage(firstPid, pg, READS_NUM_PAGES);
+	if (status == OK) status = MINIBASE_BM->UnpinPage(firstPid);
+	for (int i = 0; status == OK && i < READS_NUM_PAGES; i++) {
+		PageID pid = firstPid + i;
+		status = MINIBASE_BM->PinPage(pid, pg, true);
+		if (status == OK) {
+			memcpy((char *)pg, &pid, sizeof(PageID));
+			status = MINIBASE_BM->UnpinPage(pid, true);
+		}
+	}
+
+	if (status == OK) {
+		OptimisticRead reads[READS_NUM_PAGES];
+		long sum = 0;
+		unsigned int seed = 12345;
+		clock_t initTime = clock();
+		for (int i = 0; status == OK && i < NUM_PINS; i++) {
+			seed = seed * 1103515245 + 12345;
+			int n = (seed >> 8) % READS_NUM_PAGES;
+			PageID pid = firstPid + n, data;
+			if (mode == 0) {
+				status = MINIBASE_BM->PinPage(pid, pg);
+				memcpy(&data, pg, sizeof(PageID));
+				if (status == OK) status = MINIBASE_BM->UnpinPage(pid);
+			} else {
+				OptimisticRead fresh;
+				OptimisticRead& read = (mode == 1) ? fresh : reads[n];
+				do {
+					status = MINIBASE_BM->BeginOptimisticRead(pid, pg, read);
+					memcpy(&data, pg, sizeof(PageID));
+				} while (status == OK && !MINIBASE_BM->EndOptimisticRead(read));
+			}
+			sum += data;
+		}
+		clock_t endTime = clock();
+
+		double secs = (endTime - initTime) / (double)CLOCKS_PER_SEC;
+		cout << "  - " << modes[mode] << ": " << (long)(NUM_PINS / secs) << " reads/sec\n";
+		if (sum == 0) status = FAIL;
+	}
+
+	delete minibase_globals;
+	minibase_globals = 0;
+	remove(BENCH_DB);
+	remove(BENCH_LOG);
+	return status;
+}
+
+//--------------------------------------------------------------------
+// BenchBlocks
+//
+// Input    : batched - pin each block with one PinPages rather than
+//                      page by page with PinPage
+// Purpose  : Read a file several times the size of the pool in blocks
+//            of BLOCK_SIZE pages, as a block nested loop join fills
+//            its block, pinning a whole block before unpinning it.
+//            Every pin is a miss.
+// Return   : OK if the benchmark ran, FAIL otherwise.
+//--------------------------------------------------------------------
+
+static Status BenchBlocks(bool batched)
+{
+	Status status;
+	minibase_globals = new SystemDefs(status, BENCH_DB, BENCH_LOG,
+		BLOCK_NUM_PAGES + 64, 500, BLOCK_BUF_SIZE, "Clock");
+	if (status != OK) return status;
+
+	PageID firstPid;
+	Page *pg;
+	status = MINIBASE_BM->NewPage(firstPid, pg, BLOCK_NUM_PAGES);
+	if (status == OK) status = MINIBASE_BM->UnpinPage(firstPid);
+	for (int i = 0; status == OK && i < BLOCK_NUM_PAGES; i++) {
+		PageID pid = firstPid + i;
+		status = MINIBASE_BM->PinPage(pid, pg, true);
+		if (status == OK) {
+			memcpy((char *)pg, &pid, sizeof(PageID));
+			status = MINIBASE_BM->UnpinPage(pid, true);
+		}
+	}
+	if (status == OK) status = MINIBASE_BM->FlushAllPages();
+
+	if (status == OK) {
+		PageID pids[BLOCK_SIZE];
+		Page *pages[BLOCK_SIZE];
+		long sum = 0;
+		MINIBASE_BM->ResetStat();
+		struct timeval initTime, endTime;
+		gettimeofday(&initTime, NULL);
+		for (int block = 0; status == OK && block < BLOCK_NUM_PAGES / BLOCK_SIZE; block++) {
+			for (int i = 0; i < BLOCK_SIZE; i++) pids[i] = firstPid + block * BLOCK_SIZE + i;
+			if (batched) {
+				status = MINIBASE_BM->PinPages(pids, BLOCK_SIZE, pages);
+			} else {
+				for (int i = 0; status == OK && i < BLOCK_SIZE; i++) status = MINIBASE_BM->PinPage(pids[i], pages[i]);
+			}
+			for (int i = 0; status == OK && i < BLOCK_SIZE; i++) {
+				PageID data;
+				memcpy(&data, pages[i], sizeof(PageID));
+				sum += data;
+				status = MINIBASE_BM->UnpinPage(pids[i]);
+			}
+		}
+		gettimeofday(&endTime, NULL);
+
+		LatencyHistogram reads;
+		GetLatencyHistogram(READ_PAGE_LATENCY, reads);
+		long pins, misses;
+		MINIBASE_BM->GetStat(pins, misses);
+		double msecs = (endTime.tv_sec - initTime.tv_sec) * 1e3 + (endTime.tv_usec - initTime.tv_usec) / 1e3;
+		cout << "  - " << (batched ? "PinPages" : "PinPage each") << ": " << msecs << "ms, "
+			 << misses << " misses, " << reads.numOfCalls << " single page reads\n";
+		if (sum == 0) status = FAIL;
+	}
+
+	delete minibase_globals;
+	minibase_globals = 0;
+	remove(BENCH_DB);
+	remove(BENCH_LOG);
+	return status;
+}
+
+//--------------------------------------------------------------------
+// BenchFlush
+//
+// Input    : flushAll - flush with FlushAllPages rather than page by
+//                       page with FlushPage
+// Purpose  : Fill the pool with dirty pages, pinned in random order so
+//            frame order is not page order, then time writing them all
+//            back. FlushPage in the order the pages were loaded is what
+//            FlushAllPages used to do.
+// Return   : OK if the benchmark ran, FAIL otherwise.
+//--------------------------------------------------------------------
+
+static Status BenchFlush(bool flushAll)
+{
+	Status status;
+	minibase_globals = new SystemDefs(status, BENCH_DB, BENCH_LOG,
+		FLUSH_BUF_SIZE + 64, 500, FLUSH_BUF_SIZE, "Clock");
+	if (status != OK) return status;
+
+	// Leave room for the DB header and space map pages.
+	int numPages = FLUSH_BUF_SIZE - 16;
+	PageID firstPid;
+	Page *pg;
+	status = MINIBASE_BM->NewPage(firstPid, pg, numPages);
+	if (status == OK) status = MINIBASE_BM->UnpinPage(firstPid);
+
+	PageID *order = new PageID[numPages];
+	for (int i = 0; i < numPages; i++) order[i] = firstPid + i;
+	unsigned int seed = 12345;
+	for (int i = numPages - 1; i > 0; i--) {
+		seed = seed * 1103515245 + 12345;
+		int j = (seed >> 8) % (i + 1);
+		PageID t = order[i]; order[i] = order[j]; order[j] = t;
+	}
+	for (int i = 0; status == OK && i < numPages; i++) {
+		status = MINIBASE_BM->PinPage(order[i], pg, true);
+		if (status == OK) {
+			memcpy((char *)pg, &order[i], sizeof(PageID));
+			status = MINIBASE_BM->UnpinPage(order[i], true);
+		}
+	}
+
+	if (status == OK) {
+		struct timeval initTime, endTime;
+		gettimeofday(&initTime, NULL);
+		if (flushAll) {
+			status = MINIBASE_BM->FlushAllPages();
+		} else {
+			for (int i = 0; status == OK && i < numPages; i++) status = MINIBASE_BM->FlushPage(order[i]);
+		}
+		gettimeofday(&endTime, NULL);
+
+		double msecs = (endTime.tv_sec - initTime.tv_sec) * 1e3 + (endTime.tv_usec - initTime.tv_usec) / 1e3;
+		cout << "  - " << (flushAll ? "FlushAllPages" : "FlushPage each") << ": " << msecs << "ms\n";
+	}
+
+	delete[] order;
+	delete minibase_globals;
+	minibase_globals = 0;
+	remove(BENCH_DB);
+	remove(BENCH_LOG);
+	return status;
+}
+
+//--------------------------------------------------------------------
+// BenchAlloc
+//
+// Input    : fullness - percentage of the database's pages in use
+// Purpose  : Allocate every page of a database of ALLOC_NUM_PAGES
+//            pages, free random ones until it is fullness percent
+//            full, then time allocating a page and freeing a random
+//            page in use, so it stays that full. Also counts the space
+//            map pages pinned per allocation.
+// Return   : OK if the benchmark ran, FAIL otherwise.
+//--------------------------------------------------------------------
+
+static Status BenchAlloc(int fullness)
+{
+	Status status;
+	minibase_globals = new SystemDefs(status, BENCH_DB, BENCH_LOG,
+		ALLOC_NUM_PAGES, 500, 64, "Clock");
+	if (status != OK) return status;
+
+	PageID firstPid;
+	int numPages = 0;
+	while (MINIBASE_DB->AllocatePage(firstPid, ALLOC_NUM_PAGES - numPages) != OK) numPages += 64;
+	minibase_errors.clear_errors();
+	numPages = ALLOC_NUM_PAGES - numPages;
+
+	PageID *used = new PageID[numPages];
+	for (int i = 0; i < numPages; i++) used[i] = firstPid + i;
+	int numUsed = numPages;
+	unsigned int seed = 12345;
+	while (status == OK && numUsed > (long)ALLOC_NUM_PAGES * fullness / 100) {
+		seed = seed * 1103515245 + 12345;
+		int i = (seed >> 8) % numUsed;
+		status = MINIBASE_DB->DeallocatePage(used[i]);
+		used[i] = used[--numUsed];
+	}
+
+	if (status == OK) {
+		MINIBASE_BM->ResetStat();
+		struct timeval initTime, endTime;
+		gettimeofday(&initTime, NULL);
+		for (int op = 0; status == OK && op < ALLOC_NUM_OPS; op++) {
+			seed = seed * 1103515245 + 12345;
+			int i = (seed >> 8) % numUsed;
+			PageID pid;
+			status = MINIBASE_DB->AllocatePage(pid);
+			if (status == OK) status = MINIBASE_DB->DeallocatePage(used[i]);
+			used[i] = pid;
+		}
+		gettimeofday(&endTime, NULL);
+
+		long pins, misses;
+		MINIBASE_BM->GetStat(pins, misses);
+		double msecs = (endTime.tv_sec - initTime.tv_sec) * 1e3 + (endTime.tv_usec - initTime.tv_usec) / 1e3;
+		cout << "  - " << fullness << "% full: " << (int)(ALLOC_NUM_OPS / (msecs / 1e3)) << " allocations/s, "
+			 << (double)pins / ALLOC_NUM_OPS << " map page pins each\n";
+	}
+
+	delete[] used;
+	delete minibase_globals;
+	minibase_globals = 0;
+	remove(BENCH_DB);
+	remove(BENCH_LOG);
+	return status;
+}
+
+int main (int argc, char **argv)
+{
+	exportJSON = (argc > 1 && strcmp(argv[1], "--json") == 0);
+
+	cout << "\n  Pin throughput against buffer pool size, " << NUM_PINS << " pins each:\n";
+	for (int bufSize = 64; bufSize <= 16384; bufSize *= 4) {
+		if (BenchPins(bufSize) != OK) {
+			cerr << "*** Benchmark failed for " << bufSize << " frames\n";
+			minibase_errors.show_errors();
+			return 1;
+		}
+	}
+
+	cout << "\n  Point reads on " << READS_NUM_PAGES << " resident pages, " << NUM_PINS << " reads each:\n";
+	for (int mode = 0; mode <= 2; mode++) {
+		if (BenchReads(mode) != OK) {
+			cerr << "*** Benchmark failed\n";
+			minibase_errors.show_errors();
+			return 1;
+		}
+	}
+
+	cout << "\n  Reading " << BLOCK_NUM_PAGES << " pages in blocks of " << BLOCK_SIZE << " with "
+		 << BLOCK_BUF_SIZE << " frames:\n";
+	for (int batched = 0; batched <= 1; batched++) {
+		if (BenchBlocks(batched) != OK) {
+			cerr << "*** Benchmark failed\n";
+			minibase_errors.show_errors();
+			return 1;
+		}
+	}
+
+	cout << "\n  Writing back " << FLUSH_BUF_SIZE << " dirty frames:\n";
+	for (int flushAll = 0; flushAll <= 1; flushAll++) {
+		if (BenchFlush(flushAll) != OK) {
+			cerr << "*** Benchmark failed\n";
+			minibase_errors.show_errors();
+			return 1;
+		}
+	}
+
+	cout << "\n  Dirty page writes, " << WRITER_NUM_PINS << " pins on " << WRITER_NUM_PAGES
+		 << " pages with " << WRITER_BUF_SIZE << " frames:\n";
+	for (int background = 0; background <= 1; background++) {
+		if (BenchWriter(background) != OK) {
+			cerr << "*** Benchmark failed\n";
+			minibase_errors.show_errors();
+			return 1;
+		}
+	}
+
+	static const int fullness[] = { 10, 50, 95 };
+	cout << "\n  Allocating and freeing single pages in a database of " << ALLOC_NUM_PAGES << " pages, "
+		 << ALLOC_NUM_OPS << " of each:\n";
+	for (int i = 0; i < 3; i++) {
+		if (BenchAlloc(fullness[i]) != OK) {
+			cerr << "*** Benchmark failed\n";
+			minibase_errors.show_errors();
+			return 1;
+		}
+	}
+	cout << endl;
+	return 0;
+}
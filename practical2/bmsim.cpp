@@ -0,0 +1,325 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <iostream>
+
+using namespace std;
+
+#include "include/frame.h"
+#include "include/replacer.h"
+#include "include/pagetable.h"
+#include "include/trace.h"
+
+int MINIBASE_RESTART_FLAG = 0;
+
+#define MIN_SIM_FRAMES 8
+#define MAX_POLICIES   16
+
+static const char *allPolicies[] = { "Clock", "GClock", "LRU", "LRUK", "2Q", "ARC" };
+
+// A BufferRing of the replay, recycling frames as PickVictim does.
+struct SimRing
+{
+	int size;
+	int current;
+	int *frameNos;
+	PageID *pids;
+	unsigned long *stamps;
+};
+
+struct SimResult
+{
+	long pins;
+	long misses;
+	long failed;   // pins that found every frame pinned
+};
+
+//--------------------------------------------------------------------
+// LoadTrace
+//
+// Input    : filename - a trace written by BufMgr::StartTrace
+// Output   : n - number of events
+// Return   : The events, NULL if the file is not a trace or is cut
+//            short.
+//--------------------------------------------------------------------
+
+static TraceEvent *LoadTrace(const char *filename, long& n)
+{
+	Status status;
+	TraceReader reader(filename, status);
+	if (status != OK) return NULL;
+
+	long capacity = 1 << 16;
+	TraceEvent *events = (TraceEvent *)malloc(capacity * sizeof(TraceEvent));
+	n = 0;
+	while ((status = reader.Next(events[n])) == OK) {
+		if (++n == capacity) {
+			capacity *= 2;
+			events = (TraceEvent *)realloc(events, capacity * sizeof(TraceEvent));
+		}
+	}
+	if (status != DONE) {
+		free(events);
+		return NULL;
+	}
+	return events;
+}
+
+static int ComparePageIDs(const void *a, const void *b)
+{
+	return *(const PageID *)a - *(const PageID *)b;
+}
+
+// The ring of the replay with the given id, made on first use.
+static SimRing *GetRing(SimRing *&rings, int& numOfRings, int id, int size)
+{
+	if (id >= numOfRings) {
+		int n = (id + 1 > 2 * numOfRings) ? id + 1 : 2 * numOfRings;
+		rings = (SimRing *)realloc(rings, n * sizeof(SimRing));
+		memset(&rings[numOfRings], 0, (n - numOfRings) * sizeof(SimRing));
+		numOfRings = n;
+	}
+	SimRing *ring = &rings[id];
+	if (ring->size == 0) {
+		ring->size = size;
+		ring->frameNos = new int[size];
+		ring->pids = new PageID[size];
+		ring->stamps = new unsigned long[size];
+		for (int i = 0; i < size; i++) {
+			ring->frameNos[i] = INVALID_FRAME;
+			ring->pids[i] = INVALID_PAGE;
+			ring->stamps[i] = 0;
+		}
+	}
+	return ring;
+}
+
+// Number of different pages the trace pins.
+static int CountPages(const TraceEvent *events, long n)
+{
+	PageID *pids = new PageID[n > 0 ? n : 1];
+	long numOfPins = 0;
+	for (long i = 0; i < n; i++) {
+		if (events[i].op == TRACE_PIN || events[i].op == TRACE_PIN_EMPTY) pids[numOfPins++] = events[i].pid;
+	}
+	qsort(pids, numOfPins, sizeof(PageID), ComparePageIDs);
+	int numOfPages = 0;
+	for (long i = 0; i < numOfPins; i++) {
+		if (i == 0 || pids[i] != pids[i - 1]) numOfPages++;
+	}
+	delete[] pids;
+	return numOfPages;
+}
+
+//--------------------------------------------------------------------
+// Simulate
+//
+// Input    : events, n - the trace
+//            policy    - replacement policy, as for Replacer::Create
+//            size      - number of frames
+// Purpose  : Replay the trace against a pool of one shard in memory,
+//            making the same calls on the replacer as BufMgr does, and
+//            recycling the frames of the rings pins went through, but
+//            reading and writing nothing. A pin of a page that is not
+//            resident is a miss, whether it is to be read or not, as
+//            in BufMgr::GetStat.
+// Return   : The pins and misses of the replay.
+//--------------------------------------------------------------------
+
+static SimResult Simulate(const TraceEvent *events, long n, const char *policy, int size)
+{
+	SimResult result = { 0, 0, 0 };
+	Frame *frameArray = new Frame[size];
+	Frame **frames = new Frame*[size];
+	for (int i = 0; i < size; i++) frames[i] = &frameArray[i];
+	PageTable pageTable(size);
+	Replacer *replacer = Replacer::Create(policy, size, frames);
+	SimRing *rings = NULL;
+	int numOfRings = 0;
+
+	for (long i = 0; i < n; i++) {
+		const TraceEvent& event = events[i];
+		int frameNo = (event.op == TRACE_FLUSH_ALL) ? INVALID_FRAME : pageTable.LookUp(event.pid);
+		SimRing *ring = (event.ring != 0) ? GetRing(rings, numOfRings, event.ring, event.ringSize) : NULL;
+		int slot = 0;
+		switch (event.op) {
+		case TRACE_PIN :
+		case TRACE_PIN_EMPTY :
+			result.pins++;
+			if (frameNo != INVALID_FRAME) {
+				replacer->PageHit(frameNo);
+				frames[frameNo]->Pin();
+				if (ring != NULL) {
+					int last = (ring->current + ring->size - 1) % ring->size;
+					if (ring->frameNos[last] == frameNo) ring->stamps[last] = frames[frameNo]->GetTimeStamp();
+				}
+				break;
+			}
+			result.misses++;
+			replacer->PageMiss(event.pid);
+			frameNo = INVALID_FRAME;
+			if (ring != NULL) {
+				slot = ring->current;
+				int f = ring->frameNos[slot];
+				if (f != INVALID_FRAME && frames[f]->GetPageID() == ring->pids[slot]
+					&& frames[f]->GetPinCount() == 0 && frames[f]->GetTimeStamp() == ring->stamps[slot]) {
+					frameNo = f;
+				}
+			}
+			if (frameNo == INVALID_FRAME) frameNo = replacer->PickVictim();
+			if (frameNo == INVALID_FRAME) {
+				result.failed++;
+				break;
+			}
+			if (frames[frameNo]->GetPageID() != INVALID_PAGE) {
+				pageTable.Delete(frames[frameNo]->GetPageID());
+				frames[frameNo]->EmptyIt();
+			}
+			frames[frameNo]->SetPageID(event.pid);
+			pageTable.Insert(event.pid, frameNo);
+			replacer->PageIn(frameNo);
+			frames[frameNo]->Pin();
+			if (ring != NULL) {
+				ring->frameNos[slot] = frameNo;
+				ring->pids[slot] = event.pid;
+				ring->stamps[slot] = frames[frameNo]->GetTimeStamp();
+				ring->current = (slot + 1) % ring->size;
+			}
+			break;
+		case TRACE_UNPIN :
+		case TRACE_UNPIN_DIRTY :
+			// A page whose pin failed, or that was pinned before the
+			// trace started, is not there to unpin.
+			if (frameNo != INVALID_FRAME && frames[frameNo]->GetPinCount() > 0
+				&& frames[frameNo]->Unpin() == 0) {
+				replacer->Unpinned(frameNo);
+			}
+			break;
+		case TRACE_FREE :
+		case TRACE_FLUSH :
+			if (frameNo != INVALID_FRAME) {
+				pageTable.Delete(event.pid);
+				frames[frameNo]->EmptyIt();
+				replacer->PageOut(frameNo);
+			}
+			break;
+		case TRACE_FLUSH_ALL :
+			for (int f = 0; f < size; f++) {
+				if (frames[f]->GetPageID() == INVALID_PAGE) continue;
+				frames[f]->EmptyIt();
+				replacer->PageOut(f);
+			}
+			pageTable.EmptyIt();
+			break;
+		default :
+			break;
+		}
+	}
+
+	for (int r = 0; r < numOfRings; r++) {
+		if (rings[r].size == 0) continue;
+		delete[] rings[r].frameNos;
+		delete[] rings[r].pids;
+		delete[] rings[r].stamps;
+	}
+	free(rings);
+	delete replacer;
+	delete[] frames;
+	delete[] frameArray;
+	return result;
+}
+
+static void Usage()
+{
+	cerr << "Usage: minibase-bmsim TRACE [POLICY,...] [FRAMES ...]\n"
+		 << "  Replays a trace captured with BufMgr::StartTrace and prints the miss ratio\n"
+		 << "  of each policy (default: all) at each pool size (default: powers of two\n"
+		 << "  from " << MIN_SIM_FRAMES << " until every page fits).\n";
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		Usage();
+		return 1;
+	}
+
+	long n;
+	TraceEvent *events = LoadTrace(argv[1], n);
+	if (events == NULL) {
+		cerr << "*** " << argv[1] << " is not a buffer manager trace\n";
+		return 1;
+	}
+	int numOfPages = CountPages(events, n);
+
+	const char *policies[MAX_POLICIES];
+	int numOfPolicies = 0;
+	char *policyList = NULL;
+	int arg = 2;
+	if (arg < argc && !(argv[arg][0] >= '0' && argv[arg][0] <= '9')) {
+		policyList = strdup(argv[arg++]);
+		for (char *p = strtok(policyList, ","); p != NULL && numOfPolicies < MAX_POLICIES; p = strtok(NULL, ",")) {
+			policies[numOfPolicies++] = p;
+		}
+	} else {
+		for (int i = 0; i < (int)(sizeof(allPolicies) / sizeof(allPolicies[0])); i++) {
+			policies[numOfPolicies++] = allPolicies[i];
+		}
+	}
+	for (int i = 0; i < numOfPolicies; i++) {
+		Frame frame;
+		Frame *frames[1] = { &frame };
+		Replacer *replacer = Replacer::Create(policies[i], 1, frames);
+		if (replacer == NULL) {
+			cerr << "*** Unknown replacement policy " << policies[i] << endl;
+			return 1;
+		}
+		delete replacer;
+	}
+
+	int numOfSizes = 0;
+	int *sizes = new int[argc + 32];
+	for (; arg < argc; arg++) {
+		int size = atoi(argv[arg]);
+		if (size < 1) {
+			Usage();
+			return 1;
+		}
+		sizes[numOfSizes++] = size;
+	}
+	if (numOfSizes == 0) {
+		int size = MIN_SIM_FRAMES;
+		for (; size < numOfPages; size *= 2) sizes[numOfSizes++] = size;
+		sizes[numOfSizes++] = size;
+	}
+
+	cout << "Replaying " << argv[1] << ": " << n << " events on " << numOfPages << " pages\n\n";
+	cout << "  Miss ratio by pool size:\n";
+	printf("%10s", "frames");
+	for (int p = 0; p < numOfPolicies; p++) printf("%10s", policies[p]);
+	printf("\n");
+
+	clock_t start = clock();
+	long failed = 0;
+	for (int s = 0; s < numOfSizes; s++) {
+		printf("%10d", sizes[s]);
+		for (int p = 0; p < numOfPolicies; p++) {
+			SimResult result = Simulate(events, n, policies[p], sizes[s]);
+			printf("%10.4f", result.pins > 0 ? (double)result.misses / result.pins : 0.0);
+			failed += result.failed;
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+	double secs = (clock() - start) / (double)CLOCKS_PER_SEC;
+	cout << "\n  " << numOfSizes * numOfPolicies << " replays in " << secs << "s\n";
+	if (failed > 0) {
+		cout << "  " << failed << " pins found every frame pinned; those pools are too small for the trace\n";
+	}
+
+	free(policyList);
+	delete[] sizes;
+	free(events);
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include "../include/replacer.h"
+
+ARC::ARC( int bufSize, Frame **frames ) {
+	this->frames = frames;
+	this->numOfBuf = bufSize;
+	p = 0;
+	missGhost = -1;
+	resident = new PageID[bufSize];
+	lists = new LinkedLists(bufSize, 5);
+	// T1 + B1 never exceed the pool size and all four lists never exceed
+	// twice it, so B1 + B2 need at most 2 * bufSize slots.
+	ghosts = new GhostLists(2 * bufSize, 2);
+	for (int i = 0; i < bufSize; i++) {
+		resident[i] = frames[i]->GetPageID();
+		lists->PushBack((resident[i] == INVALID_PAGE) ? FREE : T1, i);
+	}
+}
+
+ARC::~ARC() {
+	delete[] resident;
+	delete lists;
+	delete ghosts;
+}
+
+int ARC::Size(int queue) {
+	return lists->Length(queue) + lists->Length(queue + PARKED);
+}
+
+int ARC::OldestUnpinned(int queue) {
+	// Pinned frames met at the front are parked until they are unpinned,
+	// so each is passed over once per pin, not on every miss.
+	int i;
+	while ((i = lists->Front(queue)) >= 0 && frames[i]->GetPinCount() != 0) lists->PushBack(queue + PARKED, i);
+	return (i >= 0) ? i : INVALID_FRAME;
+}
+
+int ARC::PickVictim() {
+	if (lists->Length(FREE) > 0) return lists->Front(FREE);
+	int t1 = Size(T1);
+	int first = (t1 > 0 && ((missGhost == B2 && t1 == p) || t1 > p)) ? T1 : T2;
+	int victim = OldestUnpinned(first);
+	if (victim == INVALID_FRAME) victim = OldestUnpinned((first == T1) ? T2 : T1);
+	return victim;
+}
+
+void ARC::PageMiss(PageID pid) {
+	int slot = ghosts->Find(pid);
+	missGhost = -1;
+	if (slot < 0) return;
+
+	int b1 = ghosts->Length(B1), b2 = ghosts->Length(B2);
+	missGhost = ghosts->ListOf(slot);
+	if (missGhost == B1) {
+		p += (b2 / b1 > 1) ? b2 / b1 : 1;
+		if (p > numOfBuf) p = numOfBuf;
+	} else {
+		p -= (b1 / b2 > 1) ? b1 / b2 : 1;
+		if (p < 0) p = 0;
+	}
+	ghosts->Remove(slot);
+}
+
+void ARC::PageIn(int frameNo) {
+	int list = lists->ListOf(frameNo);
+	if (resident[frameNo] != INVALID_PAGE && list != FREE) {
+		ghosts->Add((list == T1) ? B1 : B2, resident[frameNo]);
+	}
+	resident[frameNo] = frames[frameNo]->GetPageID();
+
+	if (missGhost >= 0) {
+		lists->PushBack(T2, frameNo);
+	} else {
+		lists->PushBack(T1, frameNo);
+		while (Size(T1) + ghosts->Length(B1) > numOfBuf && ghosts->Length(B1) > 0) {
+			ghosts->RemoveOldest(B1);
+		}
+		while (Size(T1) + Size(T2) + ghosts->Length(B1) + ghosts->Length(B2) > 2 * numOfBuf
+			   && ghosts->Length(B2) > 0) {
+			ghosts->RemoveOldest(B2);
+		}
+	}
+	missGhost = -1;
+}
+
+void ARC::PageHit(int frameNo) {
+	lists->PushBack(T2, frameNo);
+}
+
+void ARC::Unpinned(int frameNo) {
+	int list = lists->ListOf(frameNo);
+	if (list >= PARKED) lists->PushBack(list - PARKED, frameNo);
+}
+
+void ARC::PageOut(int frameNo) {
+	resident[frameNo] = INVALID_PAGE;
+	lists->PushFront(FREE, frameNo);
+}
+
+void ARC::MoveFrame(int from, int to) {
+	lists->Replace(from, to);
+	resident[to] = resident[from];
+	PageOut(from);
+}
+
+void ARC::Resize(int bufSize) {
+	PageID *newResident = new PageID[bufSize];
+	for (int i = 0; i < bufSize; i++) newResident[i] = (i < numOfBuf) ? resident[i] : INVALID_PAGE;
+	delete[] resident;
+	resident = newResident;
+	lists->Resize(bufSize);
+	for (int i = numOfBuf; i < bufSize; i++) lists->PushBack(FREE, i);
+	numOfBuf = bufSize;
+	if (p > bufSize) p = bufSize;
+	// Trim the ghosts to what a pool of the new size may remember, as
+	// PageIn does.
+	while (Size(T1) + ghosts->Length(B1) > numOfBuf && ghosts->Length(B1) > 0) {
+		ghosts->RemoveOldest(B1);
+	}
+	while (Size(T1) + Size(T2) + ghosts->Length(B1) + ghosts->Length(B2) > 2 * numOfBuf
+		   && ghosts->Length(B2) > 0) {
+		ghosts->RemoveOldest(B2);
+	}
+	ghosts->Resize(2 * bufSize);
+}
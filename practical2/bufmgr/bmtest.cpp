@@ -6,12 +6,48 @@
 #include <iostream>
 #include <assert.h>
 #include <time.h>
+#include <pthread.h>
+#include <sched.h>
 #include "../include/bufmgr.h"
 #include "../include/db.h"
 #include "../include/bmtest.h"
 
 using namespace std;
 
+// Test 3 pins its pages with PinPages, and reads them ahead, this many at a time.
+#define TEST3_BATCH         12
+// It ends in a pool with as small a page table as there is, full of
+// dirty pages.
+#define TEST3_SMALL_BUF     16
+#define TEST3_SMALL_PAGES   40
+
+// Test 6 needs a pool big enough to be split into shards.
+#define TEST6_NUM_BUF       1024
+#define TEST6_NUM_DB_PAGES  4000
+#define TEST6_NUM_SHARED    2048   // more than fit, so the threads evict each other's pages
+#define TEST6_NUM_THREADS   8
+#define TEST6_NUM_OPS       20000  // per thread
+#define TEST6_MAX_OWN       16     // pages a thread has allocated and not freed yet
+#define TEST6_NUM_REWRITES  2000   // of the page that is copied while it is pinned
+#define TEST6_BATCH         4      // consecutive shared pages pinned with one PinPages
+
+// Test 7 restarts with half the pool, which only has room for the pages
+// used most before the restart (and the database's own pages).
+#define TEST7_NUM_PAGES     (NUMBUF - 10)
+#define TEST7_NUM_BUF       (NUMBUF / 2)
+#define TEST7_NUM_HOT       (TEST7_NUM_PAGES / 2)
+
+// Test 8 grows the pool until all its pages fit, then shrinks it again.
+#define TEST8_NUM_PAGES     (3 * NUMBUF)
+#define TEST8_LARGE_BUF     (4 * NUMBUF)
+#define TEST8_SMALL_BUF     (NUMBUF / 2)
+#define TEST8_MEDIUM_BUF    (2 * NUMBUF)
+
+// Test 9 reads more pages than the pool holds, all of which fit in the
+// compressed cache because they are almost empty.
+#define TEST9_NUM_PAGES     (3 * NUMBUF)
+#define TEST9_CACHE_BYTES   (16 * MINIBASE_PAGESIZE)
+
 BMTester::BMTester() : TestDriver( "buftest" )
 {
 
@@ -296,6 +332,129 @@ int BMTester::Test3()
         }
     }
 
+    if ( status == OK )
+        cout << "  - Pin them in batches, backwards and with a page listed twice\n";
+
+    for ( index=0; status == OK && index + TEST3_BATCH <= numPages; index += TEST3_BATCH )
+    {
+        PageID batch[TEST3_BATCH + 1];
+        Page* batchPages[TEST3_BATCH + 1];
+        for ( unsigned i = 0; i < TEST3_BATCH; ++i )
+            batch[i] = pids[index + TEST3_BATCH - 1 - i];
+        batch[TEST3_BATCH] = batch[0];
+
+        if ( MINIBASE_BM->PinPages( batch, TEST3_BATCH + 1, batchPages ) != OK )
+        {
+            status = FAIL;
+            cerr << "*** Could not pin pages " << pids[index] << " to " << batch[0] << endl;
+            break;
+        }
+        for ( unsigned i = 0; i <= TEST3_BATCH; ++i )
+        {
+            int data;
+            memcpy( &data, (void*)batchPages[i], sizeof data );
+            if ( data != batch[i] + 99999 )
+            {
+                status = FAIL;
+                cerr << "*** Read wrong data back from page " << batch[i] << endl;
+            }
+            if ( MINIBASE_BM->UnpinPage( batch[i] ) != OK )
+            {
+                status = FAIL;
+                cerr << "*** Could not unpin page " << batch[i] << endl;
+            }
+        }
+    }
+
+    if ( status == OK )
+    {
+        cout << "  - Try to pin more pages at once than there are frames\n";
+        Page* allPages[NUMBUF+10];
+        unsigned unpinned = MINIBASE_BM->GetNumOfUnpinnedFrames();
+        if ( MINIBASE_BM->PinPages( pids, numPages, allPages ) == OK )
+        {
+            status = FAIL;
+            cerr << "*** Pinned " << numPages << " pages in " << NUMBUF << " frames\n";
+        }
+        else if ( MINIBASE_BM->GetNumOfUnpinnedFrames() != unpinned )
+        {
+            status = FAIL;
+            cerr << "*** The failed PinPages left pages pinned\n";
+        }
+    }
+
+    if ( status == OK )
+    {
+        cout << "  - Allocate an extent, all of it pinned\n";
+        Page* extent[TEST3_BATCH];
+        PageID firstPid;
+        unsigned unpinned = MINIBASE_BM->GetNumOfUnpinnedFrames();
+        if ( MINIBASE_BM->NewExtent( firstPid, extent, TEST3_BATCH ) != OK )
+        {
+            status = FAIL;
+            cerr << "*** Could not allocate " << TEST3_BATCH << " new pages\n";
+        }
+        else
+        {
+            if ( MINIBASE_BM->GetNumOfUnpinnedFrames() != unpinned - TEST3_BATCH )
+            {
+                status = FAIL;
+                cerr << "*** NewExtent did not pin every page\n";
+            }
+            for ( unsigned i = 0; i < TEST3_BATCH; ++i )
+            {
+                if ( MINIBASE_BM->FreePage( firstPid + i ) != OK )
+                {
+                    status = FAIL;
+                    cerr << "*** Error freeing page " << firstPid + i << endl;
+                }
+            }
+        }
+    }
+
+    if ( status == OK )
+    {
+        cout << "  - Read a batch ahead and pin it, then read another ahead for nothing\n";
+        long prefetches, hits, wasted;
+        MINIBASE_BM->FlushAllPages();
+        MINIBASE_BM->ResetStat();
+        MINIBASE_BM->Prefetch( pids, TEST3_BATCH );
+        for ( index=0; status == OK && index < TEST3_BATCH; ++index )
+        {
+            int data;
+            pid = pids[index];
+            if ( MINIBASE_BM->PinPage( pid, pg ) != OK )
+            {
+                status = FAIL;
+                cerr << "*** Could not pin page " << pid << endl;
+                break;
+            }
+            memcpy( &data, (void*)pg, sizeof data );
+            if ( data != pid + 99999 )
+            {
+                status = FAIL;
+                cerr << "*** Read wrong data back from page " << pid << endl;
+            }
+            if ( MINIBASE_BM->UnpinPage( pid ) != OK )
+                status = FAIL;
+        }
+        MINIBASE_BM->Prefetch( pids + TEST3_BATCH, TEST3_BATCH );
+        MINIBASE_BM->FlushAllPages();
+        MINIBASE_BM->GetPrefetchStat( prefetches, hits, wasted );
+        // A page pinned while it was still being read is not a hit.
+        if ( prefetches != 2 * TEST3_BATCH || hits > TEST3_BATCH || wasted != TEST3_BATCH )
+        {
+            status = FAIL;
+            cerr << "*** Prefetched " << prefetches << " pages, " << hits << " hits and "
+                 << wasted << " wasted\n";
+        }
+        if ( MINIBASE_BM->GetNumOfUnpinnedFrames() != NUMBUF )
+        {
+            status = FAIL;
+            cerr << "*** Prefetching left frames pinned\n";
+        }
+    }
+
 	for ( index=0; index < numPages; index++ )
     {
 		pid = pids[index];
@@ -308,6 +467,73 @@ int BMTester::Test3()
         }
     }
 
+    if ( status == OK )
+    {
+        cout << "  - Pin batches that only dirty pages make room for, in a pool of "
+             << TEST3_SMALL_BUF << " frames\n";
+        PageID small[TEST3_SMALL_PAGES];
+        Page* smallPages[TEST3_SMALL_BUF + 1];
+        // The tests that follow get the database back once this one is done.
+        SystemDefs* saved = minibase_globals;
+        minibase_globals = new SystemDefs( status, dbpath, logpath,
+                      TEST3_SMALL_PAGES + 20, 500, TEST3_SMALL_BUF, "Clock" );
+        if ( status != OK )
+        {
+            cerr << "*** Could not create a database with " << TEST3_SMALL_BUF << " buffers.\n";
+            minibase_globals = saved;
+            return false;
+        }
+        unlink( dbpath );
+
+        for ( index=0; status == OK && index < TEST3_SMALL_PAGES; ++index )
+        {
+            status = MINIBASE_BM->NewPage( small[index], pg );
+            if ( status != OK )
+            {
+                cerr << "*** Could not allocate new page number " << index+1 << endl;
+                break;
+            }
+            int data = small[index] + 99999;
+            memcpy( (void*)pg, &data, sizeof data );
+            status = MINIBASE_BM->UnpinPage( small[index], true );
+        }
+
+        // The pool holds the last pages, all dirty, so every frame the
+        // batches take has to be written back first.
+        if ( status == OK && MINIBASE_BM->PinPages( small, TEST3_SMALL_BUF + 1, smallPages ) == OK )
+        {
+            status = FAIL;
+            cerr << "*** Pinned " << TEST3_SMALL_BUF + 1 << " pages in " << TEST3_SMALL_BUF << " frames\n";
+        }
+        if ( status == OK && MINIBASE_BM->GetNumOfUnpinnedFrames() != TEST3_SMALL_BUF )
+        {
+            status = FAIL;
+            cerr << "*** The failed PinPages left pages pinned\n";
+        }
+        if ( status == OK && MINIBASE_BM->PinPages( small, TEST3_SMALL_BUF, smallPages ) != OK )
+        {
+            status = FAIL;
+            cerr << "*** Could not pin pages " << small[0] << " to " << small[TEST3_SMALL_BUF - 1] << endl;
+        }
+        for ( index=0; status == OK && index < TEST3_SMALL_BUF; ++index )
+        {
+            int data;
+            memcpy( &data, (void*)smallPages[index], sizeof data );
+            if ( data != small[index] + 99999 )
+            {
+                status = FAIL;
+                cerr << "*** Read wrong data back from page " << small[index] << endl;
+            }
+            if ( MINIBASE_BM->UnpinPage( small[index] ) != OK )
+            {
+                status = FAIL;
+                cerr << "*** Could not unpin page " << small[index] << endl;
+            }
+        }
+        delete minibase_globals;
+        minibase_globals = saved;
+    }
+
     if ( status == OK )
         cout << "  Test 3 completed successfully.\n";
 
@@ -570,12 +796,775 @@ int BMTester::Test5()
     return true;
 }
 
+struct Test6Worker
+{
+	pthread_t thread;
+	PageID firstShared;
+	unsigned seed;
+	int errors;
+};
+
+// One thread of Test 6: reads random shared pages, pinned one or a
+// batch at a time or optimistically, and checks them, and allocates,
+// checks and frees pages of its own.
+static void *Test6Work( void *arg )
+{
+	Test6Worker *worker = (Test6Worker *)arg;
+	OptimisticRead read;
+	PageID own[TEST6_MAX_OWN];
+	int numOwn = 0;
+	Page* pg;
+	Page* pages[TEST6_BATCH];
+	PageID pids[TEST6_BATCH];
+	PageID pid;
+	int data;
+
+	for ( int op = 0; op < TEST6_NUM_OPS; op++ )
+	{
+		int choice = rand_r( &worker->seed ) % 10;
+		if ( choice == 2 )
+		{
+			// Their frames are read into with no latch held.
+			int first = rand_r( &worker->seed ) % TEST6_NUM_SHARED;
+			for ( int i = 0; i < TEST6_BATCH; i++ )
+				pids[i] = worker->firstShared + (first + i) % TEST6_NUM_SHARED;
+			if ( MINIBASE_BM->PinPages( pids, TEST6_BATCH, pages ) != OK )
+			{
+				worker->errors++;
+				continue;
+			}
+			for ( int i = 0; i < TEST6_BATCH; i++ )
+			{
+				memcpy( &data, (void*)pages[i], sizeof data );
+				if ( data != pids[i] + 99999 ) worker->errors++;
+				if ( MINIBASE_BM->UnpinPage( pids[i], i == 0 ) != OK ) worker->errors++;
+			}
+		}
+		else if ( choice < 6 )
+		{
+			pid = worker->firstShared + rand_r( &worker->seed ) % TEST6_NUM_SHARED;
+			if ( choice >= 3 && MINIBASE_BM->BeginOptimisticRead( pid, pg, read ) == OK )
+			{
+				// The page may be evicted while it is read; if so, pin it.
+				memcpy( &data, (void*)pg, sizeof data );
+				if ( MINIBASE_BM->EndOptimisticRead( read ) )
+				{
+					if ( data != pid + 99999 ) worker->errors++;
+					continue;
+				}
+			}
+			if ( MINIBASE_BM->PinPage( pid, pg ) != OK )
+			{
+				worker->errors++;
+				continue;
+			}
+			memcpy( &data, (void*)pg, sizeof data );
+			if ( data != pid + 99999 ) worker->errors++;
+			// Dirtying without a change still makes evictions write.
+			if ( MINIBASE_BM->UnpinPage( pid, choice == 0 ) != OK ) worker->errors++;
+		}
+		else if ( choice < 8 && numOwn < TEST6_MAX_OWN )
+		{
+			if ( MINIBASE_BM->NewPage( pid, pg ) != OK )
+			{
+				worker->errors++;
+				continue;
+			}
+			data = pid + 99999;
+			memcpy( (void*)pg, &data, sizeof data );
+			if ( MINIBASE_BM->UnpinPage( pid, true ) != OK ) worker->errors++;
+			own[numOwn++] = pid;
+		}
+		else if ( numOwn > 0 )
+		{
+			int i = rand_r( &worker->seed ) % numOwn;
+			pid = own[i];
+			own[i] = own[--numOwn];
+			if ( MINIBASE_BM->PinPage( pid, pg ) != OK )
+			{
+				worker->errors++;
+				continue;
+			}
+			memcpy( &data, (void*)pg, sizeof data );
+			if ( data != pid + 99999 ) worker->errors++;
+			if ( MINIBASE_BM->FreePage( pid ) != OK ) worker->errors++;
+		}
+	}
+
+	while ( numOwn > 0 )
+	{
+		if ( MINIBASE_BM->FreePage( own[--numOwn] ) != OK ) worker->errors++;
+	}
+	return NULL;
+}
+
+struct Test6Copier
+{
+	pthread_t thread;
+	PageID pid;
+	int *done;
+	int torn;
+};
+
+// The writer of Test 6's last part: rewrites the page over and over,
+// every byte the same, holding it pinned. It lets the others run half
+// way through, as if it were preempted there.
+static void *Test6Rewrite( void *arg )
+{
+	Test6Copier *writer = (Test6Copier *)arg;
+	Page *pg;
+	for ( int round = 1; round <= TEST6_NUM_REWRITES; round++ )
+	{
+		if ( MINIBASE_BM->PinPage( writer->pid, pg ) != OK )
+		{
+			writer->torn++;
+			break;
+		}
+		memset( (void*)pg, round, MINIBASE_PAGESIZE / 2 );
+		sched_yield();
+		memset( (char*)pg + MINIBASE_PAGESIZE / 2, round, MINIBASE_PAGESIZE / 2 );
+		if ( MINIBASE_BM->UnpinPage( writer->pid, true ) != OK ) writer->torn++;
+		sched_yield();
+	}
+	__atomic_store_n( writer->done, 1, __ATOMIC_RELEASE );
+	return NULL;
+}
+
+// A reader of Test 6's last part: copies the page until the writer is
+// done, and counts the copies that are not all one byte.
+static void *Test6Copy( void *arg )
+{
+	Test6Copier *reader = (Test6Copier *)arg;
+	Page copy;
+	while ( !__atomic_load_n( reader->done, __ATOMIC_ACQUIRE ) )
+	{
+		if ( MINIBASE_BM->CopyPage( reader->pid, &copy ) != OK )
+		{
+			reader->torn++;
+			break;
+		}
+		const char *bytes = (const char*)&copy;
+		for ( int i = 1; i < MINIBASE_PAGESIZE; i++ )
+		{
+			if ( bytes[i] != bytes[0] )
+			{
+				reader->torn++;
+				break;
+			}
+		}
+	}
+	return NULL;
+}
+
 /**
  * Assumptions: Database starts out empty
  */
 int BMTester::Test6()
 {
-	return true;
+	Page* pg;
+	PageID pid, firstPid;
+	Status status;
+	int data;
+
+	cout << "\n  Test 6 stresses the buffer manager from " << TEST6_NUM_THREADS << " threads at once\n";
+
+	// Start over with a pool that is split into shards. Its database
+	// file goes away once it is closed.
+	delete minibase_globals;
+	minibase_globals = new SystemDefs( status, dbpath, logpath,
+				  TEST6_NUM_DB_PAGES, 500, TEST6_NUM_BUF, "Clock" );
+	if ( status != OK )
+	{
+		cerr << "*** Could not create a database with " << TEST6_NUM_BUF << " buffers.\n";
+		return false;
+	}
+	unlink( dbpath );
+
+	cout << "  - Allocate " << TEST6_NUM_SHARED << " pages and write something on each one\n";
+	status = MINIBASE_BM->NewPage( firstPid, pg, TEST6_NUM_SHARED );
+	if ( status != OK )
+	{
+		cerr << "*** Could not allocate " << TEST6_NUM_SHARED << " new pages in the database.\n";
+		return false;
+	}
+	status = MINIBASE_BM->UnpinPage( firstPid );
+	for ( pid = firstPid; status == OK && pid < firstPid + TEST6_NUM_SHARED; ++pid )
+	{
+		status = MINIBASE_BM->PinPage( pid, pg, true );
+		if ( status != OK )
+		{
+			cerr << "*** Could not pin new page " << pid << endl;
+			break;
+		}
+		data = pid + 99999;
+		memcpy( (void*)pg, &data, sizeof data );
+		status = MINIBASE_BM->UnpinPage( pid, true );
+	}
+	if ( status != OK ) return false;
+
+	cout << "  - Pin, unpin, allocate and free pages from every thread\n";
+	MINIBASE_BM->ResetStat();
+	Test6Worker workers[TEST6_NUM_THREADS];
+	int started = 0;
+	for ( int i = 0; i < TEST6_NUM_THREADS; i++ )
+	{
+		workers[i].firstShared = firstPid;
+		workers[i].seed = i + 1;
+		workers[i].errors = 0;
+		if ( pthread_create( &workers[i].thread, NULL, Test6Work, &workers[i] ) != 0 )
+		{
+			cerr << "*** Could not start thread " << i << endl;
+			status = FAIL;
+			break;
+		}
+		started++;
+	}
+
+	int errors = 0;
+	for ( int i = 0; i < started; i++ )
+	{
+		pthread_join( workers[i].thread, NULL );
+		errors += workers[i].errors;
+	}
+	if ( errors > 0 )
+	{
+		cerr << "*** " << errors << " operations failed or read wrong data\n";
+		status = FAIL;
+	}
+
+	if ( MINIBASE_BM->GetNumOfUnpinnedFrames() != TEST6_NUM_BUF )
+	{
+		cerr << "*** Some pages were left pinned\n";
+		status = FAIL;
+	}
+
+	// Whoever has a page pinned may be changing it, so a copy must
+	// never catch it half way.
+	cout << "  - Rewrite a pinned page from one thread while the others copy it\n";
+	PageID copied;
+	if ( MINIBASE_BM->NewPage( copied, pg ) != OK )
+	{
+		cerr << "*** Could not allocate a page to copy\n";
+		return false;
+	}
+	memset( (void*)pg, 0, MINIBASE_PAGESIZE );
+	MINIBASE_BM->UnpinPage( copied, true );
+	int done = 0;
+	Test6Copier copiers[TEST6_NUM_THREADS];
+	started = 0;
+	for ( int i = 0; i < TEST6_NUM_THREADS; i++ )
+	{
+		copiers[i].pid = copied;
+		copiers[i].done = &done;
+		copiers[i].torn = 0;
+		if ( pthread_create( &copiers[i].thread, NULL, (i == 0) ? Test6Rewrite : Test6Copy, &copiers[i] ) != 0 )
+		{
+			cerr << "*** Could not start thread " << i << endl;
+			status = FAIL;
+			break;
+		}
+		started++;
+	}
+	// The writer is started first, so whenever a reader runs there is
+	// a writer to stop it.
+	int torn = 0;
+	for ( int i = 0; i < started; i++ )
+	{
+		pthread_join( copiers[i].thread, NULL );
+		torn += copiers[i].torn;
+	}
+	if ( torn > 0 )
+	{
+		cerr << "*** " << torn << " copies were taken half way through a change\n";
+		status = FAIL;
+	}
+	if ( MINIBASE_BM->FreePage( copied ) != OK )
+	{
+		cerr << "*** Error freeing page " << copied << endl;
+		status = FAIL;
+	}
+
+	cout << "  - Read the pages back and free them\n";
+	for ( pid = firstPid; pid < firstPid + TEST6_NUM_SHARED; ++pid )
+	{
+		if ( MINIBASE_BM->PinPage( pid, pg ) != OK )
+		{
+			cerr << "*** Could not pin page " << pid << endl;
+			status = FAIL;
+			continue;
+		}
+		memcpy( &data, (void*)pg, sizeof data );
+		if ( data != pid + 99999 )
+		{
+			cerr << "*** Read wrong data back from page " << pid << endl;
+			status = FAIL;
+		}
+		if ( MINIBASE_BM->FreePage( pid ) != OK )
+		{
+			cerr << "*** Error freeing page " << pid << endl;
+			status = FAIL;
+		}
+	}
+
+	MINIBASE_BM->PrintStat();
+
+	if ( status == OK )
+		cout << "  Test 6 completed successfully.\n";
+
+	return status == OK;
+}
+
+/**
+ * Assumptions: Database starts out empty
+ */
+int BMTester::Test7()
+{
+	Page* pg;
+	PageID pid, firstPid;
+	Status status;
+	int data;
+	long pins, misses;
+
+	cout << "\n  Test 7 warms up a restarted buffer pool with the pages in use before\n";
+
+	char* warmpath = new char[ strlen(dbpath) + 20 ];
+	sprintf( warmpath, "%s.warm", dbpath );
+
+	delete minibase_globals;
+	minibase_globals = new SystemDefs( status, dbpath, logpath,
+				  TEST7_NUM_PAGES + 20, 500, NUMBUF, "Clock" );
+	if ( status != OK )
+	{
+		cerr << "*** Could not create a database.\n";
+		return false;
+	}
+
+	cout << "  - Allocate " << TEST7_NUM_PAGES << " pages, write something on each one"
+		 << " and use every other one more\n";
+	status = MINIBASE_BM->NewPage( firstPid, pg, TEST7_NUM_PAGES );
+	if ( status != OK )
+	{
+		cerr << "*** Could not allocate " << TEST7_NUM_PAGES << " new pages in the database.\n";
+		return false;
+	}
+	status = MINIBASE_BM->UnpinPage( firstPid );
+	for ( pid = firstPid; status == OK && pid < firstPid + TEST7_NUM_PAGES; ++pid )
+	{
+		status = MINIBASE_BM->PinPage( pid, pg, true );
+		if ( status != OK )
+		{
+			cerr << "*** Could not pin new page " << pid << endl;
+			break;
+		}
+		data = pid + 99999;
+		memcpy( (void*)pg, &data, sizeof data );
+		status = MINIBASE_BM->UnpinPage( pid, true );
+	}
+	for ( int i = 0; status == OK && i < 3; i++ )
+	{
+		for ( pid = firstPid + 1; status == OK && pid < firstPid + TEST7_NUM_PAGES; pid += 2 )
+		{
+			status = MINIBASE_BM->PinPage( pid, pg );
+			if ( status == OK ) status = MINIBASE_BM->UnpinPage( pid );
+		}
+	}
+	if ( status != OK ) return false;
+
+	cout << "  - Dump the resident pages and restart with " << TEST7_NUM_BUF << " buffers\n";
+	if ( MINIBASE_BM->DumpResidentPages( warmpath ) != OK )
+	{
+		cerr << "*** Could not write " << warmpath << endl;
+		return false;
+	}
+	delete minibase_globals;
+	minibase_globals = new SystemDefs( status, dbpath, logpath, 0, 500, TEST7_NUM_BUF, "Clock" );
+	if ( status != OK )
+	{
+		cerr << "*** Could not open the database again.\n";
+		return false;
+	}
+
+	int loaded = MINIBASE_BM->WarmUp( warmpath );
+	if ( loaded < TEST7_NUM_HOT || loaded > TEST7_NUM_BUF )
+	{
+		cerr << "*** Warming up loaded " << loaded << " pages\n";
+		status = FAIL;
+	}
+
+	cout << "  - Read the pages used most without a miss\n";
+	MINIBASE_BM->ResetStat();
+	for ( pid = firstPid + 1; pid < firstPid + TEST7_NUM_PAGES; pid += 2 )
+	{
+		if ( MINIBASE_BM->PinPage( pid, pg ) != OK )
+		{
+			cerr << "*** Could not pin page " << pid << endl;
+			status = FAIL;
+			continue;
+		}
+		memcpy( &data, (void*)pg, sizeof data );
+		if ( data != pid + 99999 )
+		{
+			cerr << "*** Read wrong data back from page " << pid << endl;
+			status = FAIL;
+		}
+		if ( MINIBASE_BM->UnpinPage( pid ) != OK )
+		{
+			cerr << "*** Error unpinning page " << pid << endl;
+			status = FAIL;
+		}
+	}
+	MINIBASE_BM->GetStat( pins, misses );
+	if ( misses != 0 )
+	{
+		cerr << "*** " << misses << " of them were not loaded\n";
+		status = FAIL;
+	}
+
+	cout << "  - Shut down, which dumps the resident pages again\n";
+	delete minibase_globals;
+	minibase_globals = NULL;
+	FILE* warmfile = fopen( warmpath, "rb" );
+	if ( warmfile == NULL )
+	{
+		cerr << "*** " << warmpath << " was not written at shutdown\n";
+		status = FAIL;
+	}
+	else
+		fclose( warmfile );
+	unlink( warmpath );
+	unlink( dbpath );
+	delete[] warmpath;
+
+	// Leave a fresh database behind for any test that runs next.
+	Status newStatus;
+	minibase_globals = new SystemDefs( newStatus, dbpath, logpath, NUMBUF+20, 500, NUMBUF, "Clock" );
+	if ( newStatus != OK ) return false;
+	unlink( dbpath );
+
+	if ( status == OK )
+		cout << "  Test 7 completed successfully.\n";
+
+	return status == OK;
+}
+
+// Pin every page of Tests 8 and 9 and check what is on it, changing
+// it to newData + pid if newData is not 0.
+static Status ReadTestPages( PageID firstPid, int numPages, int oldData, int newData )
+{
+	Status status = OK;
+	Page* pg;
+	int data;
+
+	for ( PageID pid = firstPid; pid < firstPid + numPages; ++pid )
+	{
+		if ( MINIBASE_BM->PinPage( pid, pg ) != OK )
+		{
+			cerr << "*** Could not pin page " << pid << endl;
+			status = FAIL;
+			continue;
+		}
+		memcpy( &data, (void*)pg, sizeof data );
+		if ( data != pid + oldData )
+		{
+			cerr << "*** Read wrong data back from page " << pid << endl;
+			status = FAIL;
+		}
+		if ( newData != 0 )
+		{
+			data = pid + newData;
+			memcpy( (void*)pg, &data, sizeof data );
+		}
+		if ( MINIBASE_BM->UnpinPage( pid, newData != 0 ) != OK )
+		{
+			cerr << "*** Error unpinning page " << pid << endl;
+			status = FAIL;
+		}
+	}
+	return status;
+}
+
+/**
+ * Assumptions: Database starts out empty
+ */
+int BMTester::Test8()
+{
+	Page *pg, *pinned;
+	PageID pid, firstPid;
+	Status status;
+	int data;
+	long pins, misses;
+
+	cout << "\n  Test 8 resizes the buffer pool while it is in use\n";
+
+	delete minibase_globals;
+	minibase_globals = new SystemDefs( status, dbpath, logpath,
+				  TEST8_NUM_PAGES + 20, 500, NUMBUF, "Clock" );
+	if ( status != OK )
+	{
+		cerr << "*** Could not create a database.\n";
+		return false;
+	}
+	unlink( dbpath );
+
+	cout << "  - Allocate " << TEST8_NUM_PAGES << " pages and write something on each one\n";
+	status = MINIBASE_BM->NewPage( firstPid, pg, TEST8_NUM_PAGES );
+	if ( status != OK )
+	{
+		cerr << "*** Could not allocate " << TEST8_NUM_PAGES << " new pages in the database.\n";
+		return false;
+	}
+	status = MINIBASE_BM->UnpinPage( firstPid );
+	for ( pid = firstPid; status == OK && pid < firstPid + TEST8_NUM_PAGES; ++pid )
+	{
+		status = MINIBASE_BM->PinPage( pid, pg, true );
+		if ( status != OK )
+		{
+			cerr << "*** Could not pin new page " << pid << endl;
+			break;
+		}
+		data = pid + 99999;
+		memcpy( (void*)pg, &data, sizeof data );
+		status = MINIBASE_BM->UnpinPage( pid, true );
+	}
+	if ( status != OK ) return false;
+
+	cout << "  - Grow to " << TEST8_LARGE_BUF << " buffers with a page pinned\n";
+	if ( MINIBASE_BM->PinPage( firstPid, pinned ) != OK )
+	{
+		cerr << "*** Could not pin page " << firstPid << endl;
+		return false;
+	}
+	if ( MINIBASE_BM->Resize( TEST8_LARGE_BUF ) != OK
+		 || MINIBASE_BM->GetNumOfBuffers() != TEST8_LARGE_BUF )
+	{
+		cerr << "*** Could not grow the pool\n";
+		status = FAIL;
+	}
+	memcpy( &data, (void*)pinned, sizeof data );
+	if ( data != firstPid + 99999 || MINIBASE_BM->UnpinPage( firstPid ) != OK )
+	{
+		cerr << "*** The pinned page did not survive growing the pool\n";
+		status = FAIL;
+	}
+
+	cout << "  - Read all pages twice, the second time without a miss\n";
+	if ( ReadTestPages( firstPid, TEST8_NUM_PAGES, 99999, 0 ) != OK ) status = FAIL;
+	MINIBASE_BM->ResetStat();
+	if ( ReadTestPages( firstPid, TEST8_NUM_PAGES, 99999, 88888 ) != OK ) status = FAIL;
+	MINIBASE_BM->GetStat( pins, misses );
+	if ( misses != 0 )
+	{
+		cerr << "*** " << misses << " pages did not stay in the grown pool\n";
+		status = FAIL;
+	}
+
+	cout << "  - Under each policy, shrink to " << TEST8_MEDIUM_BUF
+		 << " buffers after making room, and read the pages left without a miss\n";
+	const char *policies[] = { "Clock", "LRU", "LRUK", "2Q", "ARC" };
+	for ( int p = 0; p < (int)(sizeof policies / sizeof policies[0]); p++ )
+	{
+		if ( MINIBASE_BM->SetReplacementPolicy( policies[p] ) != OK
+			 || MINIBASE_BM->Resize( TEST8_LARGE_BUF ) != OK )
+		{
+			cerr << "*** Could not grow the pool under " << policies[p] << endl;
+			status = FAIL;
+			continue;
+		}
+		if ( ReadTestPages( firstPid, TEST8_NUM_PAGES, 88888, 0 ) != OK ) status = FAIL;
+		for ( pid = firstPid; pid < firstPid + TEST8_NUM_PAGES - TEST8_MEDIUM_BUF; ++pid )
+		{
+			if ( MINIBASE_BM->FlushPage( pid ) != OK )
+			{
+				cerr << "*** Error flushing page " << pid << endl;
+				status = FAIL;
+			}
+		}
+		// The pages left may sit in any frames, so those in frames that
+		// go have to move.
+		if ( MINIBASE_BM->Resize( TEST8_MEDIUM_BUF ) != OK )
+		{
+			cerr << "*** Could not shrink the pool under " << policies[p] << endl;
+			status = FAIL;
+			continue;
+		}
+		MINIBASE_BM->ResetStat();
+		if ( ReadTestPages( firstPid + TEST8_NUM_PAGES - TEST8_MEDIUM_BUF, TEST8_MEDIUM_BUF, 88888, 0 ) != OK )
+			status = FAIL;
+		MINIBASE_BM->GetStat( pins, misses );
+		if ( misses != 0 )
+		{
+			cerr << "*** " << misses << " pages were evicted by shrinking under " << policies[p] << endl;
+			status = FAIL;
+		}
+	}
+	if ( MINIBASE_BM->Resize( TEST8_LARGE_BUF ) != OK ) status = FAIL;
+
+	cout << "  - Shrink to " << TEST8_SMALL_BUF << " buffers with a page pinned\n";
+	if ( MINIBASE_BM->PinPage( firstPid, pinned ) != OK )
+	{
+		cerr << "*** Could not pin page " << firstPid << endl;
+		return false;
+	}
+	// This fails if the page is pinned in a frame that would go.
+	if ( MINIBASE_BM->Resize( TEST8_SMALL_BUF ) != OK
+		 && MINIBASE_BM->GetNumOfBuffers() != TEST8_LARGE_BUF )
+	{
+		cerr << "*** Failing to shrink the pool changed its size\n";
+		status = FAIL;
+	}
+	memcpy( &data, (void*)pinned, sizeof data );
+	if ( data != firstPid + 88888 || MINIBASE_BM->UnpinPage( firstPid ) != OK )
+	{
+		cerr << "*** The pinned page did not survive shrinking the pool\n";
+		status = FAIL;
+	}
+	if ( MINIBASE_BM->Resize( TEST8_SMALL_BUF ) != OK
+		 || MINIBASE_BM->GetNumOfBuffers() != TEST8_SMALL_BUF )
+	{
+		cerr << "*** Could not shrink the pool with nothing pinned\n";
+		status = FAIL;
+	}
+
+	cout << "  - Read the changes back through the shrunk pool\n";
+	if ( ReadTestPages( firstPid, TEST8_NUM_PAGES, 88888, 0 ) != OK ) status = FAIL;
+	if ( MINIBASE_BM->GetNumOfUnpinnedFrames() != TEST8_SMALL_BUF )
+	{
+		cerr << "*** Some pages were left pinned\n";
+		status = FAIL;
+	}
+
+	for ( pid = firstPid; pid < firstPid + TEST8_NUM_PAGES; ++pid )
+	{
+		if ( MINIBASE_BM->FreePage( pid ) != OK )
+		{
+			cerr << "*** Error freeing page " << pid << endl;
+			status = FAIL;
+		}
+	}
+
+	MINIBASE_BM->PrintStat();
+
+	if ( status == OK )
+		cout << "  Test 8 completed successfully.\n";
+
+	return status == OK;
+}
+
+/**
+ * Assumptions: Database starts out empty
+ */
+int BMTester::Test9()
+{
+	Page *pg;
+	PageID pid, firstPid;
+	Status status;
+	int data;
+	long pins, misses, lookups, cacheHits, cachedPages, cachedBytes;
+
+	cout << "\n  Test 9 keeps evicted pages in the compressed cache\n";
+
+	cout << "  - Compress and decompress a page\n";
+	char page[MINIBASE_PAGESIZE], code[MINIBASE_PAGESIZE], back[MINIBASE_PAGESIZE];
+	for ( int i = 0; i < MINIBASE_PAGESIZE; i++ )
+		page[i] = (i < MINIBASE_PAGESIZE / 4) ? (char)(i * 7) : (char)(i / 100);
+	int length = PageCache::Compress( page, code );
+	if ( length <= 0 || length >= MINIBASE_PAGESIZE )
+	{
+		cerr << "*** A page with long runs compressed to " << length << " bytes\n";
+		return false;
+	}
+	PageCache::Decompress( code, length, back );
+	if ( memcmp( page, back, MINIBASE_PAGESIZE ) != 0 )
+	{
+		cerr << "*** The page changed going through the codec\n";
+		return false;
+	}
+	srand( 9 );
+	for ( int i = 0; i < MINIBASE_PAGESIZE; i++ )
+		page[i] = (char)rand();
+	if ( PageCache::Compress( page, code ) != 0 )
+	{
+		cerr << "*** A page of random bytes was compressed\n";
+		return false;
+	}
+
+	delete minibase_globals;
+	minibase_globals = new SystemDefs( status, dbpath, logpath,
+				  TEST9_NUM_PAGES + 20, 500, NUMBUF, "Clock" );
+	if ( status != OK )
+	{
+		cerr << "*** Could not create a database.\n";
+		return false;
+	}
+	unlink( dbpath );
+	MINIBASE_BM->SetCompressedCacheSize( TEST9_CACHE_BYTES );
+
+	cout << "  - Allocate " << TEST9_NUM_PAGES << " pages and write something on each one\n";
+	status = MINIBASE_BM->NewPage( firstPid, pg, TEST9_NUM_PAGES );
+	if ( status != OK )
+	{
+		cerr << "*** Could not allocate " << TEST9_NUM_PAGES << " new pages in the database.\n";
+		return false;
+	}
+	status = MINIBASE_BM->UnpinPage( firstPid );
+	for ( pid = firstPid; status == OK && pid < firstPid + TEST9_NUM_PAGES; ++pid )
+	{
+		status = MINIBASE_BM->PinPage( pid, pg, true );
+		if ( status != OK )
+		{
+			cerr << "*** Could not pin new page " << pid << endl;
+			break;
+		}
+		memset( (void*)pg, 0, MINIBASE_PAGESIZE );
+		data = pid + 99999;
+		memcpy( (void*)pg, &data, sizeof data );
+		status = MINIBASE_BM->UnpinPage( pid, true );
+	}
+	if ( status != OK ) return false;
+
+	cout << "  - Read all pages, changing them, then read them again\n";
+	MINIBASE_BM->ResetStat();
+	if ( ReadTestPages( firstPid, TEST9_NUM_PAGES, 99999, 88888 ) != OK ) status = FAIL;
+	if ( ReadTestPages( firstPid, TEST9_NUM_PAGES, 88888, 0 ) != OK ) status = FAIL;
+
+	cout << "  - Every miss was served by the compressed cache\n";
+	MINIBASE_BM->GetStat( pins, misses );
+	MINIBASE_BM->GetCompressedCacheStat( lookups, cacheHits, cachedPages, cachedBytes );
+	if ( misses == 0 || lookups != misses || cacheHits != misses )
+	{
+		cerr << "*** " << cacheHits << " of " << lookups << " lookups hit the cache for "
+			 << misses << " misses\n";
+		status = FAIL;
+	}
+	if ( cachedPages == 0 || cachedBytes > TEST9_CACHE_BYTES )
+	{
+		cerr << "*** The cache holds " << cachedPages << " pages in " << cachedBytes << " bytes\n";
+		status = FAIL;
+	}
+
+	cout << "  - Free the pages, which drops them from the cache\n";
+	long pagesBefore = cachedPages;
+	for ( pid = firstPid; pid < firstPid + TEST9_NUM_PAGES; ++pid )
+	{
+		if ( MINIBASE_BM->FreePage( pid ) != OK )
+		{
+			cerr << "*** Error freeing page " << pid << endl;
+			status = FAIL;
+		}
+	}
+	MINIBASE_BM->GetCompressedCacheStat( lookups, cacheHits, cachedPages, cachedBytes );
+	if ( cachedPages >= pagesBefore )
+	{
+		cerr << "*** The cache still holds " << cachedPages << " pages\n";
+		status = FAIL;
+	}
+
+	MINIBASE_BM->PrintStat();
+
+	if ( status == OK )
+		cout << "  Test 9 completed successfully.\n";
+
+	return status == OK;
 }
 
 
@@ -1,23 +1,564 @@
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdint.h>
+#include <sched.h>
+#include <new>
+
 #include "../include/bufmgr.h"
 #include "../include/frame.h"
+#include "../include/latency.h"
+
+#define HUGE_PAGE_SIZE  (2 * 1024 * 1024)     // also the arena's alignment, enough for O_DIRECT buffers
+#define POOL_GROWTH     4                    // a pool can grow to this many times its initial size, unless told otherwise
+#define ARENA_PAGE_SIZE 4096                 // unit in which a shrinking pool returns memory
+#define MIN_FRAMES_PER_SHARD 64              // smaller pools are not split
+#define MAX_SHARDS      16
+#define COPY_TRIES      256                  // optimistic reads before CopyPage copies under a pin
+#define RESIDENT_SET_MAGIC 0x53524d42        // "BMRS", first word of a resident set file
+
+// SystemDefs allocates 56 bytes for the buffer manager; fail to compile
+// rather than overrun that block if BufMgr ever grows.
+typedef char BufMgrMustFitSystemDefs[(sizeof(BufMgr) <= 56) ? 1 : -1];
+
+// Holds the latch of a shard for the rest of the enclosing block.
+class ShardLatch
+{
+	private:
+		pthread_mutex_t *latch;
+	public:
+		ShardLatch( BufShard *shard ) : latch(&shard->latch) { pthread_mutex_lock(latch); }
+		~ShardLatch() { pthread_mutex_unlock(latch); }
+};
+
+// Statistics slots of the file and the operator the calling thread
+// works for, -1 for none; see BufMgr::SetFileTag.
+static __thread int threadFile = -1;
+static __thread int threadOperator = -1;
+
+static inline double Now()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static inline void AddStat( AccessStat *stat, long pins, long misses, long writes, double ioTime )
+{
+	stat->numOfPins += pins;
+	stat->numOfMisses += misses;
+	stat->numDirtyPageWrites += writes;
+	stat->ioTime += ioTime;
+}
+
+// Charge a file and an operator slot, either -1 for none, with what
+// was done for them. The latch of the shard is held.
+static inline void Charge( BufShard *shard, int file, int op, long pins, long misses, long writes, double ioTime )
+{
+	if (file >= 0) AddStat(&shard->fileStats[file], pins, misses, writes, ioTime);
+	if (op >= 0) AddStat(&shard->operatorStats[op], pins, misses, writes, ioTime);
+}
+
+// Record an event in the trace being captured, if any; see StartTrace.
+static inline void Trace( BufPool *pool, TraceOp op, PageID pid, int count = 0, int ring = 0, int ringSize = 0 )
+{
+	if (__atomic_load_n(&pool->trace, __ATOMIC_ACQUIRE) == NULL) return;
+	TraceEvent event = { op, pid, count, ring, ringSize };
+	pthread_mutex_lock(&pool->traceLock);
+	if (pool->trace != NULL) pool->trace->Write(event);
+	pthread_mutex_unlock(&pool->traceLock);
+}
+
+// The shard a page belongs to. Fibonacci hashing spreads the runs of
+// consecutive page ids that files are made of over all the shards.
+static inline BufShard *ShardOf( BufPool *pool, PageID pid )
+{
+	if (pool->numOfShards == 1) return pool->shards;
+	return &pool->shards[((unsigned)pid * 2654435769u) >> pool->shardShift];
+}
+
+// Frames are dealt out to the shards in turn: frame f of the pool is
+// frame f / numOfShards of shard f % numOfShards. Resizing the pool
+// adds or removes frames at the end of every shard, so no frame ever
+// changes shard or number.
+static inline int FrameInShard( BufPool *pool, int frameNo )
+{
+	return frameNo >> (32 - pool->shardShift);
+}
+
+static inline int FrameInPool( BufPool *pool, BufShard *shard, int i )
+{
+	return (i << (32 - pool->shardShift)) + shard->index;
+}
+
+// Number of frames shard s has in a pool of bufSize frames.
+static inline int FramesOfShard( BufPool *pool, int s, int bufSize )
+{
+	return (bufSize - s + pool->numOfShards - 1) / pool->numOfShards;
+}
+
+// Mark a frame as being read into for pid, see Frame::BeginRead, unless
+// the second tier has the page: TRUE if it did, and the frame holds the
+// page already. The latch of the frame's shard is held.
+static bool BeginFrameRead( BufShard *shard, Frame *frame, PageID pid, PageCache *cache )
+{
+	if (frame->BeginRead(pid, cache)) return true;
+	shard->numOfReads++;
+	return false;
+}
+
+// End a read begun by BeginFrameRead, and wake whoever waits for it.
+static void EndFrameRead( BufShard *shard, Frame *frame, PageID pid, Status status )
+{
+	frame->EndRead(pid, status);
+	shard->numOfReads--;
+	pthread_cond_broadcast(&shard->readDone);
+}
+
+// Whether PinPages is writing pid back from a frame it has taken. The
+// latch of the page's shard is held.
+static bool IsBeingWrittenBack( BufShard *shard, PageID pid )
+{
+	for (int i = 0; i < shard->numOfWritingBack; i++) {
+		if (shard->writingBack[i] == pid) return true;
+	}
+	return false;
+}
+
+// Mark pid as being written back from a frame PinPages has taken. It
+// leaves the page table. The latch of the page's shard is held.
+static void BeginWriteBack( BufShard *shard, PageID pid )
+{
+	shard->pageTable->Delete(pid);
+	shard->writingBack[shard->numOfWritingBack++] = pid;
+}
+
+// End a write back begun by BeginWriteBack, and wake whoever waits for
+// the page.
+static void EndWriteBack( BufShard *shard, PageID pid )
+{
+	for (int i = 0; i < shard->numOfWritingBack; i++) {
+		if (shard->writingBack[i] != pid) continue;
+		shard->writingBack[i] = shard->writingBack[--shard->numOfWritingBack];
+		break;
+	}
+	pthread_cond_broadcast(&shard->readDone);
+}
+
+// Claim a prefetch run in flight, for the caller to end with
+// FinishPrefetchRun: the one page pid is in, or any if pid is
+// INVALID_PAGE; with doneOnly, only one whose read is over already.
+// NULL if there is none.
+static PrefetchRun *ClaimPrefetchRun( BufPool *pool, PageID pid, bool doneOnly )
+{
+	PrefetchRun *claimed = NULL;
+	pthread_mutex_lock(&pool->prefetchLock);
+	for (int r = 0; r < MAX_PREFETCH_RUNS && claimed == NULL; r++) {
+		PrefetchRun *run = &pool->prefetchRuns[r];
+		if (run->state != PREFETCH_IN_FLIGHT) continue;
+		if (pid != INVALID_PAGE && (pid < run->firstPid || pid >= run->firstPid + run->numOfPages)) continue;
+		if (doneOnly && !__atomic_load_n(&run->request.done, __ATOMIC_ACQUIRE)) continue;
+		run->state = PREFETCH_FINISHING;
+		claimed = run;
+	}
+	pthread_mutex_unlock(&pool->prefetchLock);
+	return claimed;
+}
+
+// Wait for the read of a claimed prefetch run and end it: the pages are
+// left unpinned in their frames if it went well, and their frames are
+// emptied otherwise. No latch is held.
+static void FinishPrefetchRun( BufPool *pool, PrefetchRun *run )
+{
+	Status status = MINIBASE_DB->WaitIO(run->request);
+	for (int i = 0; i < run->numOfPages; i++) {
+		PageID pid = run->firstPid + i;
+		BufShard *shard = ShardOf(pool, pid);
+		ShardLatch latch(shard);
+		Frame *frame = &pool->frameArray[run->frameNos[i]];
+		int slot = FrameInShard(pool, run->frameNos[i]);
+		EndFrameRead(shard, frame, pid, status);
+		if (status == OK) {
+			frame->SetPrefetched(TRUE);
+			if (frame->Unpin() == 0) shard->replacer->Unpinned(slot);
+		} else {
+			shard->pageTable->Delete(pid);
+			frame->EmptyIt();
+			shard->replacer->PageOut(slot);
+		}
+	}
+	pthread_mutex_lock(&pool->prefetchLock);
+	pool->numOfPrefetching -= run->numOfPages;
+	if (status != OK) pool->numPrefetches -= run->numOfPages;
+	run->state = PREFETCH_FREE;
+	pthread_mutex_unlock(&pool->prefetchLock);
+}
+
+// Latch every shard, in shard order, once no frame is being read into
+// with the latch let go (see PinPages and Prefetch): the reader needs the
+// latches to finish, and the frame is no use to anyone before. Prefetch
+// runs are ended here if need be, as nobody else may be about to.
+static void LockAllShards( BufPool *pool )
+{
+	for (;;) {
+		int s;
+		for (s = 0; s < pool->numOfShards; s++) {
+			pthread_mutex_lock(&pool->shards[s].latch);
+			if (pool->shards[s].numOfReads > 0) break;
+		}
+		if (s == pool->numOfShards) return;
+		for (int t = s - 1; t >= 0; t--) pthread_mutex_unlock(&pool->shards[t].latch);
+		BufShard *shard = &pool->shards[s];
+		PrefetchRun *run = ClaimPrefetchRun(pool, INVALID_PAGE, false);
+		if (run == NULL) pthread_cond_wait(&shard->readDone, &shard->latch);
+		pthread_mutex_unlock(&shard->latch);
+		if (run != NULL) FinishPrefetchRun(pool, run);
+	}
+}
+
+static void UnlockAllShards( BufPool *pool )
+{
+	for (int s = pool->numOfShards - 1; s >= 0; s--) pthread_mutex_unlock(&pool->shards[s].latch);
+}
+
+// The first pin of a prefetched page that finds it loaded is a prefetch
+// hit. The latch of the frame's shard is held.
+static void CountPrefetchHit( BufPool *pool, Frame *frame )
+{
+	if (!frame->IsPrefetched()) return;
+	frame->SetPrefetched(FALSE);
+	pthread_mutex_lock(&pool->prefetchLock);
+	pool->numPrefetchHits++;
+	pthread_mutex_unlock(&pool->prefetchLock);
+}
+
+// Empty a frame; a prefetched page nobody pinned was a wasted prefetch.
+// The latch of the frame's shard is held.
+static void EmptyFrame( BufPool *pool, Frame *frame )
+{
+	if (frame->IsPrefetched()) {
+		pthread_mutex_lock(&pool->prefetchLock);
+		pool->numWastedPrefetches++;
+		pthread_mutex_unlock(&pool->prefetchLock);
+	}
+	frame->EmptyIt();
+}
+
+// The frame of a page, as BufMgr::FindFrame, once it is not being read
+// into any more, nor written back by PinPages if it is not resident; a
+// prefetch run it is in is ended here and then. The latch of the page's
+// shard is held, and let go while waiting, so the caller must not have
+// frames of its own being read or pages being written back. A
+// prefetched page that had to be waited for is no prefetch hit.
+static int WaitForFrame( BufPool *pool, BufShard *shard, PageID pid )
+{
+	int frameNo;
+	bool waited = false;
+	for (;;) {
+		frameNo = shard->pageTable->LookUp(pid);
+		if (frameNo == INVALID_FRAME ? !IsBeingWrittenBack(shard, pid) : !pool->frameArray[frameNo].IsBeingRead()) break;
+		waited = true;
+		PrefetchRun *run = (frameNo != INVALID_FRAME) ? ClaimPrefetchRun(pool, pid, false) : NULL;
+		if (run == NULL) {
+			pthread_cond_wait(&shard->readDone, &shard->latch);
+			continue;
+		}
+		pthread_mutex_unlock(&shard->latch);
+		FinishPrefetchRun(pool, run);
+		pthread_mutex_lock(&shard->latch);
+	}
+	if (waited && frameNo != INVALID_FRAME) pool->frameArray[frameNo].SetPrefetched(FALSE);
+	return frameNo;
+}
+
+// Empty a victim frame of its shard for another page, writing its page
+// back first if it was modified. The latch of the shard is held.
+static Status EvictFrame( BufPool *pool, BufShard *shard, Frame *frame )
+{
+	if (frame->GetPageID() == INVALID_PAGE) return OK;
+	if (frame->IsDirty()) {
+		double start = Now();
+		if (frame->Write() != OK) return FAIL;
+		shard->numDirtyPageWrites++;
+		Charge(shard, frame->GetFileTag(), threadOperator, 0, 0, 1, Now() - start);
+		// The background writer, if any, is falling behind.
+		pthread_cond_signal(&pool->writerWakeUp);
+	}
+	// The page is on disk as it is, so it may go to the second tier.
+	if (shard->cache != NULL) shard->cache->Put(frame->GetPageID(), frame->GetPage());
+	shard->pageTable->Delete(frame->GetPageID());
+	EmptyFrame(pool, frame);
+	return OK;
+}
+
+struct DirtyPage
+{
+	PageID pid;
+	int frameNo;
+};
+
+static int CompareDirtyPages( const void *a, const void *b )
+{
+	return ((const DirtyPage *)a)->pid - ((const DirtyPage *)b)->pid;
+}
+
+//--------------------------------------------------------------------
+// WriteBack
+//
+// Input   : dirty   - dirty pages and the frames they are in, in any
+//                     order; sorted on return
+//           n       - number of pages
+//           latched - whether the caller holds the latches of the
+//                     pages' shards; if not, each is taken just to
+//                     count the write
+// Purpose : Write dirty pages back in page id order, each run of
+//           consecutive page ids (up to AIO_MAX_RUN) with one
+//           MINIBASE_DB->SubmitWritePages. Up to AIO_QUEUE_DEPTH runs
+//           are submitted before waiting for any, so the device sees
+//           them all at once. The frames are left dirty.
+// PreCond : The frames cannot change meanwhile: their shards are
+//           latched, or they are pinned by the caller.
+// Return  : OK if all were written.  FAIL otherwise.
+//--------------------------------------------------------------------
+
+static Status WriteBack( BufPool *pool, Frame **frames, DirtyPage *dirty, int n, bool latched )
+{
+	Status status = OK;
+	qsort(dirty, n, sizeof(DirtyPage), CompareDirtyPages);
+	Page **pages = new Page*[n > 0 ? n : 1];
+	for (int i = 0; i < n; i++) pages[i] = frames[dirty[i].frameNo]->GetPage();
+	AIORequest *requests = new AIORequest[AIO_QUEUE_DEPTH];
+	for (int first = 0; first < n; ) {
+		int begin = first;
+		int numOfRuns = 0;
+		double start = Now();
+		while (first < n && numOfRuns < AIO_QUEUE_DEPTH) {
+			int last = first + 1;
+			while (last < n && last - first < AIO_MAX_RUN && dirty[last].pid == dirty[first].pid + (last - first)) last++;
+			MINIBASE_DB->SubmitWritePages(dirty[first].pid, &pages[first], last - first, requests[numOfRuns++]);
+			first = last;
+		}
+		for (int r = 0; r < numOfRuns; r++) {
+			if (MINIBASE_DB->WaitIO(requests[r]) != OK) status = FAIL;
+		}
+		double ioTime = (Now() - start) / (first - begin);
+		for (int i = begin; i < first; i++) {
+			BufShard *shard = ShardOf(pool, dirty[i].pid);
+			if (!latched) pthread_mutex_lock(&shard->latch);
+			shard->numDirtyPageWrites++;
+			Charge(shard, frames[dirty[i].frameNo]->GetFileTag(), threadOperator, 0, 0, 1, ioTime);
+			if (!latched) pthread_mutex_unlock(&shard->latch);
+		}
+	}
+	delete[] requests;
+	delete[] pages;
+	return status;
+}
+
+// An entry of a resident set file, see DumpResidentPages.
+struct ResidentPage
+{
+	PageID pid;
+	int uses;
+};
+
+// A page WarmUp loads, and the frame it goes into.
+struct WarmPage
+{
+	PageID pid;
+	int uses;
+	int frameNo;
+};
+
+static int CompareWarmPagesByPageID( const void *a, const void *b )
+{
+	return ((const WarmPage *)a)->pid - ((const WarmPage *)b)->pid;
+}
+
+// Least used first.
+static int CompareWarmPagesByUses( const void *a, const void *b )
+{
+	return ((const WarmPage *)a)->uses - ((const WarmPage *)b)->uses;
+}
+
+// A page PinPages did not find resident, and the frame it goes into.
+struct BatchPage
+{
+	PageID pid;
+	int shard;      // index of its shard
+	int index;      // in the caller's arrays
+	int frameNo;    // INVALID_FRAME until it is pinned
+	PageID oldPid;  // dirty page the frame held until that is written back, see BeginWriteBack; INVALID_PAGE if none
+	bool unread;    // its frame is being read into for it, see BeginFrameRead
+	Status read;    // how the read went
+	double ioTime;  // spent reading it
+};
+
+static int CompareBatchPages( const void *a, const void *b )
+{
+	const BatchPage *x = (const BatchPage *)a, *y = (const BatchPage *)b;
+	return (x->pid != y->pid) ? x->pid - y->pid : x->index - y->index;
+}
+
+// Give up the frame PinPages took for a page it did not read. The frame
+// goes back to the dirty page it held, if that was not written back, and
+// is emptied otherwise. The latch of its shard is held.
+static void AbandonFrame( BufPool *pool, BufShard *shard, Frame *frame, BatchPage *page )
+{
+	int slot = FrameInShard(pool, page->frameNo);
+	shard->pageTable->Delete(page->pid);
+	if (page->oldPid != INVALID_PAGE) {
+		shard->pageTable->Insert(page->oldPid, page->frameNo);
+		EndWriteBack(shard, page->oldPid);
+	}
+	if (frame->IsBeingRead()) EndFrameRead(shard, frame, page->pid, FAIL);
+	if (page->oldPid != INVALID_PAGE) {
+		if (frame->Unpin() == 0) shard->replacer->Unpinned(slot);
+	} else {
+		frame->EmptyIt();
+		shard->replacer->PageOut(slot);
+	}
+	page->frameNo = INVALID_FRAME;
+}
+
+//--------------------------------------------------------------------
+// ReserveArena
+//
+// Input   : size      - number of bytes the pool may grow to
+//           hugePages - whether to ask for transparent huge pages
+// Output  : reserved  - number of bytes actually reserved
+// Purpose : Reserve the address space backing the whole buffer pool,
+//           as large as it may ever grow, in one block aligned to huge
+//           pages, so frames keep their addresses however the pool is
+//           resized. Memory is only committed as frames are first
+//           used. Pools of at least one huge page ask for transparent
+//           huge pages to cut TLB misses.
+// Return  : The arena. Throws bad_alloc if it cannot be reserved.
+//--------------------------------------------------------------------
+
+static char *ReserveArena( size_t size, bool hugePages, size_t& reserved )
+{
+	reserved = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	size_t mapped = reserved + HUGE_PAGE_SIZE;
+	char *block = (char *)mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+							   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (block == MAP_FAILED) throw std::bad_alloc();
+
+	// Give back what lies outside the aligned part.
+	char *arena = (char *)(((uintptr_t)block + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+	if (arena > block) munmap(block, arena - block);
+	if (block + mapped > arena + reserved) munmap(arena + reserved, block + mapped - (arena + reserved));
+#ifdef MADV_HUGEPAGE
+	if (hugePages) madvise(arena, reserved, MADV_HUGEPAGE);
+#endif
+	return arena;
+}
+
+// Construct the frames of a pool that has never had upTo frames before.
+static void ConstructFrames( BufPool *pool, Frame **frames, int upTo )
+{
+	for (; pool->numOfConstructed < upTo; pool->numOfConstructed++) {
+		int i = pool->numOfConstructed;
+		frames[i] = new (&pool->frameArray[i]) Frame;
+		frames[i]->SetPage((Page *)(pool->arena + (size_t)i * MINIBASE_PAGESIZE));
+	}
+}
+
+// Give a shard a page table sized for its current frames, holding the
+// pages in them.
+static void ResizePageTable( BufPool *pool, BufShard *shard )
+{
+	delete shard->pageTable;
+	shard->pageTable = new PageTable(shard->numOfFrames);
+	for (int i = 0; i < shard->numOfFrames; i++) {
+		PageID pid = shard->frames[i]->GetPageID();
+		if (pid != INVALID_PAGE) shard->pageTable->Insert(pid, FrameInPool(pool, shard, i));
+	}
+}
 
 //--------------------------------------------------------------------
 // Constructor for BufMgr
 //
-// Input   : bufSize  - number of pages in the this buffer manager
+// Input   : bufSize    - number of pages in the this buffer manager
+//           maxBufSize - the most pages Resize may grow it to,
+//                        POOL_GROWTH times bufSize if not given
 // Output  : None
-// PostCond: All frames are empty.
+// PostCond: All frames are empty. Pools of at least
+//           2 * MIN_FRAMES_PER_SHARD frames are split into shards of
+//           at least MIN_FRAMES_PER_SHARD frames, up to MAX_SHARDS.
 //--------------------------------------------------------------------
 
 BufMgr::BufMgr( int bufSize )
+{
+	Init(bufSize, POOL_GROWTH * bufSize);
+}
+
+BufMgr::BufMgr( int bufSize, int maxBufSize )
+{
+	Init(bufSize, maxBufSize);
+}
+
+void BufMgr::Init( int bufSize, int maxBufSize )
 {
 	numOfBuf = bufSize;
-	frames = new Frame*[bufSize];
-	for (int i = 0; i < bufSize; i++) {
-		frames[i] = new Frame();
+	pool = new BufPool;
+	pool->capacity = (maxBufSize > bufSize) ? maxBufSize : bufSize;
+	pool->arena = ReserveArena((size_t)pool->capacity * MINIBASE_PAGESIZE,
+							   (size_t)bufSize * MINIBASE_PAGESIZE >= HUGE_PAGE_SIZE, pool->arenaSize);
+	pool->frameArray = (Frame *)mmap(NULL, (size_t)pool->capacity * sizeof(Frame), PROT_READ | PROT_WRITE,
+									 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (pool->frameArray == MAP_FAILED) throw std::bad_alloc();
+	pool->numOfConstructed = 0;
+	frames = new Frame*[pool->capacity];
+	ConstructFrames(pool, frames, bufSize);
+
+	int numOfShards = 1;
+	while (numOfShards < MAX_SHARDS && bufSize / (2 * numOfShards) >= MIN_FRAMES_PER_SHARD) numOfShards *= 2;
+	pool->numOfShards = numOfShards;
+	pool->shardShift = 32;
+	for (int n = numOfShards; n > 1; n /= 2) pool->shardShift--;
+	pool->shards = new BufShard[numOfShards];
+	for (int s = 0; s < numOfShards; s++) {
+		BufShard *shard = &pool->shards[s];
+		pthread_mutex_init(&shard->latch, NULL);
+		shard->index = s;
+		shard->numOfFrames = FramesOfShard(pool, s, bufSize);
+		shard->frames = new Frame*[FramesOfShard(pool, s, pool->capacity)];
+		for (int i = 0; i < shard->numOfFrames; i++) shard->frames[i] = frames[FrameInPool(pool, shard, i)];
+		shard->pageTable = new PageTable(shard->numOfFrames);
+		shard->replacer = new Clock(shard->numOfFrames, shard->frames);
+		shard->cache = NULL;
+		shard->numOfReads = 0;
+		pthread_cond_init(&shard->readDone, NULL);
+		shard->writingBack = new PageID[FramesOfShard(pool, s, pool->capacity)];
+		shard->numOfWritingBack = 0;
+		memset(shard->fileStats, 0, sizeof shard->fileStats);
+		memset(shard->operatorStats, 0, sizeof shard->operatorStats);
 	}
-	replacer = new Clock(bufSize, frames);
+
+	pthread_mutex_init(&pool->allocLock, NULL);
+	pthread_mutex_init(&pool->prefetchLock, NULL);
+	for (int r = 0; r < MAX_PREFETCH_RUNS; r++) pool->prefetchRuns[r].state = PREFETCH_FREE;
+	pool->numOfPrefetching = 0;
+
+	pthread_mutex_init(&pool->writerLock, NULL);
+	pthread_cond_init(&pool->writerWakeUp, NULL);
+	pool->writerRunning = false;
+	pool->stopWriter = false;
+
+	pool->residentSetFile = NULL;
+
+	pthread_mutex_init(&pool->tagLock, NULL);
+	pool->numOfFileTags = pool->numOfOperatorTags = 0;
+	threadFile = threadOperator = -1;   // slots of a previous pool
+
+	pthread_mutex_init(&pool->traceLock, NULL);
+	pool->trace = NULL;
+
 	ResetStat();
 }
 
@@ -31,9 +572,37 @@ BufMgr::BufMgr( int bufSize )
 
 BufMgr::~BufMgr()
 {
+	StopBackgroundWriter();
+	StopTrace();
+	if (pool->residentSetFile != NULL) {
+		DumpResidentPages(pool->residentSetFile);
+		free(pool->residentSetFile);
+	}
+	PrefetchRun *run;
+	while ((run = ClaimPrefetchRun(pool, INVALID_PAGE, false)) != NULL) FinishPrefetchRun(pool, run);
 	FlushAllPages();
-	delete replacer;
+	for (int s = 0; s < pool->numOfShards; s++) {
+		delete pool->shards[s].replacer;
+		delete pool->shards[s].pageTable;
+		delete pool->shards[s].cache;
+		delete[] pool->shards[s].frames;
+		delete[] pool->shards[s].writingBack;
+		pthread_cond_destroy(&pool->shards[s].readDone);
+		pthread_mutex_destroy(&pool->shards[s].latch);
+	}
+	for (int i = 0; i < pool->numOfOperatorTags; i++) free(pool->operatorTags[i]);
+	pthread_mutex_destroy(&pool->tagLock);
+	pthread_mutex_destroy(&pool->traceLock);
+	delete[] pool->shards;
+	pthread_mutex_destroy(&pool->prefetchLock);
+	pthread_mutex_destroy(&pool->allocLock);
+	pthread_cond_destroy(&pool->writerWakeUp);
+	pthread_mutex_destroy(&pool->writerLock);
 	delete[] frames;
+	// Frames need no destruction.
+	munmap(pool->frameArray, (size_t)pool->capacity * sizeof(Frame));
+	munmap(pool->arena, pool->arenaSize);
+	delete pool;
 }
 
 //--------------------------------------------------------------------
@@ -42,8 +611,13 @@ BufMgr::~BufMgr()
 // Input    : pid     - page id of a particular page 
 //            isEmpty - (optional, default to false) if true indicate
 //                      that the page to be pinned is an empty page.
+//            ring    - (optional) access strategy whose frames the
+//                      page is loaded into on a miss, see BufferRing.
 // Output   : page - a pointer to a page in the buffer pool. (NULL
 //            if fail)
+//            guard - or, instead of page, a guard that holds the pin
+//                    and lets it go, see PageGuard. A pin it already
+//                    holds is let go first.
 // Purpose  : Pin the page with page id = pid to the buffer.  
 //            Read the page from disk unless isEmpty is true or unless
 //            the page is already in the buffer.
@@ -54,35 +628,391 @@ BufMgr::~BufMgr()
 //            is pinned. The number of pin on the page increase by
 //            one.
 // Return   : OK if operation is successful.  FAIL otherwise.
+// Note     : Only the latch of the page's shard is held, also while
+//            the page is read, so pins of other shards go ahead.
 //--------------------------------------------------------------------
 
 
 Status BufMgr::PinPage(PageID pid, Page*& page, bool isEmpty)
 {
-	totalCall++;
+	return PinPage(pid, page, isEmpty, NULL);
+}
 
-	int frameIndex = FindFrame(pid);
+Status BufMgr::PinPage(PageID pid, Page*& page, bool isEmpty, BufferRing *ring)
+{
+	long start = LatencyClock();
+	int frameIndex = PinFrame(pid, isEmpty, ring);
+	RecordLatency(PIN_PAGE_LATENCY, start);
+	if (frameIndex == INVALID_FRAME) return FAIL;
+	page = frames[frameIndex]->GetPage();
+	return OK;
+}
+
+Status BufMgr::PinPage(PageID pid, PageGuard& guard, bool isEmpty, BufferRing *ring)
+{
+	guard.Release();
+	long start = LatencyClock();
+	int frameIndex = PinFrame(pid, isEmpty, ring);
+	RecordLatency(PIN_PAGE_LATENCY, start);
+	if (frameIndex == INVALID_FRAME) return FAIL;
+	guard.bufMgr = this;
+	guard.pid = pid;
+	guard.frameNo = frameIndex;
+	guard.page = frames[frameIndex]->GetPage();
+	guard.dirty = FALSE;
+	return OK;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::PinPages
+//
+// Input    : pids  - page ids of the pages to pin, in any order; a page
+//                    listed twice is pinned twice
+//            n     - number of page ids
+// Output   : pages - pages[i] is page pids[i] in the buffer
+// Purpose  : PinPage for many pages at once. The resident pages are
+//            pinned first. The rest are then given frames, one shard
+//            at a time in shard order, and read in page id order with
+//            one MINIBASE_DB->SubmitReadPages per run of consecutive
+//            page ids, all runs in flight at once, so a block of them
+//            costs a few large reads at full queue depth instead of
+//            one small read after another. Dirty victims are written
+//            back the same way first. No latch is held during the
+//            writes and reads: the frames are pinned and marked as
+//            being read into, and their old pages as being written
+//            back, so whoever wants either meanwhile waits for them
+//            (see WaitForFrame). Pages being read or written back by
+//            another thread are pinned last, one at a time.
+// Return   : OK if every page is pinned. FAIL otherwise, with none of
+//            them left pinned.
+//--------------------------------------------------------------------
+
+Status BufMgr::PinPages(const PageID *pids, int n, Page **pages)
+{
+	if (n < 0) return FAIL;
+	int *frameNos = new int[n > 0 ? n : 1];
+	BatchPage *batch = new BatchPage[n > 0 ? n : 1];
+	int numOfMissing = 0;
+
+	// Pin the pages that are in the pool, and set the others aside.
+	for (int i = 0; i < n; i++) {
+		BufShard *shard = ShardOf(pool, pids[i]);
+		ShardLatch latch(shard);
+		frameNos[i] = FindFrame(pids[i]);
+		if (frameNos[i] != INVALID_FRAME && frames[frameNos[i]]->IsBeingRead()) frameNos[i] = INVALID_FRAME;
+		if (frameNos[i] == INVALID_FRAME) {
+			BatchPage *page = &batch[numOfMissing++];
+			page->pid = pids[i];
+			page->shard = shard->index;
+			page->index = i;
+			page->frameNo = INVALID_FRAME;
+			page->oldPid = INVALID_PAGE;
+			page->unread = false;
+			page->read = OK;
+			page->ioTime = 0;
+			continue;
+		}
+		shard->numOfPins++;
+		shard->numOfHits++;
+		Charge(shard, threadFile, threadOperator, 1, 0, 0, 0);
+		Trace(pool, TRACE_PIN, pids[i]);
+		CountPrefetchHit(pool, frames[frameNos[i]]);
+		shard->replacer->PageHit(FrameInShard(pool, frameNos[i]));
+		frames[frameNos[i]]->Pin();
+		pages[i] = frames[frameNos[i]]->GetPage();
+	}
+
+	Status status = OK;
+	if (numOfMissing > 0) {
+		qsort(batch, numOfMissing, sizeof(BatchPage), CompareBatchPages);
+		bool *touched = new bool[pool->numOfShards];
+		for (int s = 0; s < pool->numOfShards; s++) touched[s] = false;
+		for (int i = 0; i < numOfMissing; i++) touched[batch[i].shard] = true;
+
+		// Give each its frame. One found in the pool by now, loaded or
+		// being read by another thread or for an earlier entry of the
+		// same page, or being written back, is left for the end. A dirty
+		// victim keeps its page until that is written back.
+		DirtyPage *dirty = new DirtyPage[numOfMissing];
+		int numOfDirty = 0;
+		for (int s = 0; s < pool->numOfShards && status == OK; s++) {
+			if (!touched[s]) continue;
+			BufShard *shard = &pool->shards[s];
+			ShardLatch latch(shard);
+			for (int i = 0; i < numOfMissing; i++) {
+				BatchPage *page = &batch[i];
+				if (page->shard != s || FindFrame(page->pid) != INVALID_FRAME
+					|| IsBeingWrittenBack(shard, page->pid)) continue;
+				shard->numOfPins++;
+				Charge(shard, threadFile, threadOperator, 1, 0, 0, 0);
+				Trace(pool, TRACE_PIN, page->pid);
+				shard->replacer->PageMiss(page->pid);
+				int slot = 0;
+				int frameIndex = PickVictim(shard, NULL, slot);
+				if (frameIndex == INVALID_FRAME) {
+					status = FAIL;
+					break;
+				}
+				Frame *frame = frames[frameIndex];
+				if (frame->IsDirty()) {
+					page->oldPid = frame->GetPageID();
+					dirty[numOfDirty].pid = page->oldPid;
+					dirty[numOfDirty].frameNo = frameIndex;
+					numOfDirty++;
+					BeginWriteBack(shard, page->oldPid);
+				} else {
+					EvictFrame(pool, shard, frame);
+					frame->SetFileTag(threadFile);
+				}
+				frame->Pin();
+				shard->pageTable->Insert(page->pid, frameIndex);
+				shard->replacer->PageIn(FrameInShard(pool, frameIndex));
+				page->frameNo = frameIndex;
+				page->unread = true;
+				if (BeginFrameRead(shard, frame, page->pid, (page->oldPid == INVALID_PAGE) ? shard->cache : NULL)) {
+					page->unread = false;
+					Charge(shard, threadFile, threadOperator, 0, 1, 0, 0);
+				}
+			}
+		}
+
+		// Write the dirty victims back. Once they are on disk their pages
+		// leave the frames for the second tier, which may have the new ones.
+		if (status == OK && numOfDirty > 0) {
+			if (WriteBack(pool, frames, dirty, numOfDirty, false) != OK) status = FAIL;
+			// The background writer, if any, is falling behind.
+			pthread_cond_signal(&pool->writerWakeUp);
+		}
+		for (int s = 0; s < pool->numOfShards && status == OK && numOfDirty > 0; s++) {
+			if (!touched[s]) continue;
+			BufShard *shard = &pool->shards[s];
+			ShardLatch latch(shard);
+			for (int i = 0; i < numOfMissing; i++) {
+				BatchPage *page = &batch[i];
+				if (page->shard != s || page->oldPid == INVALID_PAGE) continue;
+				Frame *frame = frames[page->frameNo];
+				EndWriteBack(shard, page->oldPid);
+				if (shard->cache != NULL) shard->cache->Put(page->oldPid, frame->GetPage());
+				page->oldPid = INVALID_PAGE;
+				frame->SetFileTag(threadFile);
+				if (shard->cache != NULL && shard->cache->Take(page->pid, frame->GetPage())) {
+					EndFrameRead(shard, frame, page->pid, OK);
+					page->unread = false;
+					Charge(shard, threadFile, threadOperator, 0, 1, 0, 0);
+				}
+			}
+		}
+		delete[] dirty;
+
+		// Read the rest with no latch held, and note how each read went.
+		bool submitted = (status == OK);
+		Page **run = new Page*[numOfMissing];
+		AIORequest *requests = new AIORequest[AIO_QUEUE_DEPTH];
+		int *firsts = new int[AIO_QUEUE_DEPTH + 1];
+		for (int first = 0; submitted && first < numOfMissing; ) {
+			// Submit up to AIO_QUEUE_DEPTH runs, then wait for them.
+			int numOfRuns = 0;
+			double start = Now();
+			int numOfPages = 0;
+			while (first < numOfMissing && numOfRuns < AIO_QUEUE_DEPTH) {
+				int last = first + 1;
+				if (!batch[first].unread) {
+					first = last;
+					continue;
+				}
+				Page **pages = &run[first];
+				int length = 0;
+				pages[length++] = frames[batch[first].frameNo]->GetPage();
+				// Further entries of a page in the run are left for the end.
+				for (; last < numOfMissing && length < AIO_MAX_RUN; last++) {
+					PageID pid = batch[last].pid;
+					if (!batch[last].unread && pid == batch[first].pid + length - 1) continue;
+					if (!batch[last].unread || pid != batch[first].pid + length) break;
+					pages[length++] = frames[batch[last].frameNo]->GetPage();
+				}
+				MINIBASE_DB->SubmitReadPages(batch[first].pid, pages, length, requests[numOfRuns]);
+				firsts[numOfRuns++] = first;
+				numOfPages += length;
+				first = last;
+			}
+			firsts[numOfRuns] = first;
+			for (int r = 0; r < numOfRuns; r++) MINIBASE_DB->WaitIO(requests[r]);
+			double ioTime = (numOfPages > 0) ? (Now() - start) / numOfPages : 0;
+			for (int r = 0; r < numOfRuns; r++) {
+				for (int i = firsts[r]; i < firsts[r + 1]; i++) {
+					batch[i].read = requests[r].status;
+					batch[i].ioTime = ioTime;
+				}
+				if (requests[r].status != OK) status = FAIL;
+			}
+		}
+		delete[] firsts;
+		delete[] requests;
+		delete[] run;
+
+		// End the reads. If all went well the pages are the caller's;
+		// otherwise let go of every pin, and of the frames not read.
+		for (int s = 0; s < pool->numOfShards; s++) {
+			if (!touched[s]) continue;
+			BufShard *shard = &pool->shards[s];
+			ShardLatch latch(shard);
+			for (int i = 0; i < numOfMissing; i++) {
+				BatchPage *page = &batch[i];
+				if (page->shard != s || page->frameNo == INVALID_FRAME) continue;
+				Frame *frame = frames[page->frameNo];
+				if (page->unread && submitted) {
+					EndFrameRead(shard, frame, page->pid, page->read);
+					Charge(shard, threadFile, threadOperator, 0, 1, 0, page->ioTime);
+					if (page->read == OK) page->unread = false;
+				}
+				if (status == OK) {
+					frameNos[page->index] = page->frameNo;
+					pages[page->index] = frame->GetPage();
+					continue;
+				}
+				Trace(pool, TRACE_UNPIN, page->pid);
+				if (page->unread) {
+					AbandonFrame(pool, shard, frame, page);
+				} else if (frame->Unpin() == 0) {
+					shard->replacer->Unpinned(FrameInShard(pool, page->frameNo));
+				}
+			}
+		}
+		delete[] touched;
+
+		// Now that none of its own frames are being read, pin the pages
+		// left for the end.
+		for (int i = 0; status == OK && i < numOfMissing; i++) {
+			BatchPage *page = &batch[i];
+			if (page->frameNo != INVALID_FRAME) continue;
+			int frameIndex = PinFrame(page->pid, FALSE, NULL);
+			if (frameIndex == INVALID_FRAME) {
+				status = FAIL;
+				break;
+			}
+			frameNos[page->index] = frameIndex;
+			pages[page->index] = frames[frameIndex]->GetPage();
+		}
+	}
+
+	if (status != OK) {
+		for (int i = 0; i < n; i++) {
+			if (frameNos[i] != INVALID_FRAME) UnpinPage(pids[i]);
+		}
+	}
+	delete[] frameNos;
+	delete[] batch;
+	return status;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::PinFrame
+//
+// Input    : as for PinPage
+// Output   : None
+// Purpose  : Do the work of PinPage.
+// Return   : The frame the page is pinned in, INVALID_FRAME if it
+//            could not be.
+//--------------------------------------------------------------------
+
+int BufMgr::PinFrame(PageID pid, Bool isEmpty, BufferRing *ring)
+{
+	BufShard *shard = ShardOf(pool, pid);
+	ShardLatch latch(shard);
+	shard->numOfPins++;
+	Charge(shard, threadFile, threadOperator, 1, 0, 0, 0);
+	Trace(pool, isEmpty ? TRACE_PIN_EMPTY : TRACE_PIN, pid, 0, ring ? ring->id : 0, ring ? ring->size : 0);
+
+	int frameIndex = WaitForFrame(pool, shard, pid);
 
 	Frame* frame;
 	if (frameIndex == INVALID_FRAME) {
-		frameIndex = replacer->PickVictim();
-		if (frameIndex == INVALID_FRAME) return FAIL;
+		shard->replacer->PageMiss(pid);
+		int slot = 0;
+		frameIndex = PickVictim(shard, ring, slot);
+		if (frameIndex == INVALID_FRAME) return INVALID_FRAME;
 		frame = frames[frameIndex];
+		if (EvictFrame(pool, shard, frame) != OK) return INVALID_FRAME;
 		if (isEmpty) {
+			if (shard->cache != NULL) shard->cache->Remove(pid);
 			frame->SetPageID(pid);
+			Charge(shard, threadFile, threadOperator, 0, 1, 0, 0);
 		} else {
-			Status status = frame->Read(pid);
-			if (status != OK) return FAIL;
+			double start = Now();
+			Status status = frame->Read(pid, shard->cache);
+			Charge(shard, threadFile, threadOperator, 0, 1, 0, Now() - start);
+			if (status != OK) {
+				shard->replacer->PageOut(FrameInShard(pool, frameIndex));
+				return INVALID_FRAME;
+			}
+		}
+		frame->SetFileTag(threadFile);
+		shard->pageTable->Insert(pid, frameIndex);
+		shard->replacer->PageIn(FrameInShard(pool, frameIndex));
+		frame->Pin();
+		if (ring != NULL) {
+			ring->frameNos[slot] = frameIndex;
+			ring->pids[slot] = pid;
+			ring->stamps[slot] = frame->GetTimeStamp();
+			ring->current = (slot + 1) % ring->size;
 		}
 	} else {
-		totalHit++;
+		shard->numOfHits++;
 		frame = frames[frameIndex];
+		CountPrefetchHit(pool, frame);
+		shard->replacer->PageHit(FrameInShard(pool, frameIndex));
+		frame->Pin();
+		if (ring != NULL) {
+			// Pinning a page the ring loaded again (a bulk load filling
+			// its current page, or a scan reaching a page it read ahead)
+			// keeps it the ring's own.
+			for (int i = 0; i < ring->size; i++) {
+				if (ring->frameNos[i] == frameIndex && ring->pids[i] == pid) ring->stamps[i] = frame->GetTimeStamp();
+			}
+		}
 	}
-	frame->Pin();
-	page = frame->GetPage();
-	return OK;
+	return frameIndex;
 } 
 
+//--------------------------------------------------------------------
+// BufMgr::PickVictim
+//
+// Input    : shard - shard of the missed page, latched by the caller
+//            ring  - access strategy of the caller, NULL if none
+// Output   : slot  - ring slot the page is to be recorded in
+// Purpose  : Choose the frame to load a missed page into. A ring
+//            recycles the frame in its next slot that is empty or
+//            belongs to the shard, if that frame still holds the page
+//            the ring put there, unpinned and not pinned by anyone
+//            else since (nor read ahead and not pinned yet); otherwise
+//            the shard's replacer chooses, and the frame takes that
+//            slot.
+// Return   : The frame number, INVALID_FRAME if all frames of the
+//            shard are pinned.
+//--------------------------------------------------------------------
+
+int BufMgr::PickVictim(BufShard *shard, BufferRing *ring, int& slot)
+{
+	if (ring != NULL) {
+		slot = ring->current;
+		for (int n = 0; n < ring->size; n++) {
+			int i = (ring->current + n) % ring->size;
+			int frameIndex = ring->frameNos[i];
+			if (frameIndex != INVALID_FRAME && frameIndex % pool->numOfShards != shard->index) continue;
+			slot = i;
+			if (frameIndex == INVALID_FRAME) break;
+			Frame *frame = frames[frameIndex];
+			if (frame->GetPageID() == ring->pids[i] && frame->GetPinCount() == 0
+				&& frame->GetTimeStamp() == ring->stamps[i] && !frame->IsPrefetched()) {
+				return frameIndex;
+			}
+			break;
+		}
+	}
+	int victim = shard->replacer->PickVictim();
+	return (victim == INVALID_FRAME) ? INVALID_FRAME : FrameInPool(pool, shard, victim);
+}
+
 //--------------------------------------------------------------------
 // BufMgr::UnpinPage
 //
@@ -101,12 +1031,39 @@ Status BufMgr::PinPage(PageID pid, Page*& page, bool isEmpty)
 
 Status BufMgr::UnpinPage(PageID pid, bool dirty)
 {
+	BufShard *shard = ShardOf(pool, pid);
+	ShardLatch latch(shard);
 	int frameIndex = FindFrame(pid);
 	if (frameIndex == INVALID_FRAME) return FAIL;
 	Frame* frame = frames[frameIndex];
 	if (frame->GetPinCount() == 0) return FAIL;
-	frame->Unpin();
 	if (dirty) frame->DirtyIt();
+	if (frame->Unpin() == 0) shard->replacer->Unpinned(FrameInShard(pool, frameIndex));
+	Trace(pool, dirty ? TRACE_UNPIN_DIRTY : TRACE_UNPIN, pid);
+	return OK;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::UnpinFrame
+//
+// Input    : pid, dirty - as for UnpinPage
+//            frameNo    - the frame PinPage pinned the page in
+// Output   : None
+// Purpose  : UnpinPage for a PageGuard, which knows the frame, so the
+//            page table is not searched. A pinned page cannot have
+//            been evicted, so the frame must still hold it.
+// Return   : OK if operation is successful.  FAIL otherwise.
+//--------------------------------------------------------------------
+
+Status BufMgr::UnpinFrame(PageID pid, int frameNo, Bool dirty)
+{
+	BufShard *shard = ShardOf(pool, pid);
+	ShardLatch latch(shard);
+	Frame* frame = frames[frameNo];
+	if (frame->GetPageID() != pid || frame->GetPinCount() == 0) return FAIL;
+	if (dirty) frame->DirtyIt();
+	if (frame->Unpin() == 0) shard->replacer->Unpinned(FrameInShard(pool, frameNo));
+	Trace(pool, dirty ? TRACE_UNPIN_DIRTY : TRACE_UNPIN, pid);
 	return OK;
 }
 
@@ -115,9 +1072,13 @@ Status BufMgr::UnpinPage(PageID pid, bool dirty)
 //
 // Input    : howMany - (optional, default to 1) how many pages to 
 //                      allocate.
+//            ring    - (optional) access strategy to pin the first page
+//                      through, see PinPage.
 // Output   : firstPid  - the page id of the first page (as output by
 //                   DB::AllocatePage) allocated.
 //            firstPage - a pointer to the page in memory.
+//            guard     - or, instead of firstPage, a guard holding the
+//                        pin on it, see PinPage.
 // Purpose  : Allocate howMany number of pages, and pin the first page
 //            into the buffer. 
 // Condition: howMany > 0 and there is at least one free buffer space
@@ -133,19 +1094,86 @@ Status BufMgr::UnpinPage(PageID pid, bool dirty)
 
 Status BufMgr::NewPage (PageID& firstPid, Page*& firstPage, int howMany)
 {
+	return NewPage(firstPid, firstPage, howMany, NULL);
+}
+
+Status BufMgr::NewPage (PageID& firstPid, Page*& firstPage, int howMany, BufferRing *ring)
+{
+	PageGuard guard;
+	if (NewPage(firstPid, guard, howMany, ring) != OK) return FAIL;
+	firstPage = guard.page;
+	// The caller unpins the page itself.
+	guard.page = NULL;
+	return OK;
+}
+
+Status BufMgr::NewPage (PageID& firstPid, PageGuard& guard, int howMany, BufferRing *ring)
+{
+	guard.Release();
 	if (howMany < 1) return FAIL;
-	if (MINIBASE_DB->AllocatePage(firstPid, howMany) != OK) return FAIL;
-	if (PinPage(firstPid, firstPage, true) != OK) {
+	pthread_mutex_lock(&pool->allocLock);
+	Status status = MINIBASE_DB->AllocatePage(firstPid, howMany);
+	pthread_mutex_unlock(&pool->allocLock);
+	if (status != OK) return FAIL;
+	Trace(pool, TRACE_NEW, firstPid, howMany);
+	if (PinPage(firstPid, guard, true, ring) != OK) {
+		pthread_mutex_lock(&pool->allocLock);
 		MINIBASE_DB->DeallocatePage(firstPid, howMany);
+		pthread_mutex_unlock(&pool->allocLock);
 		return FAIL;
 	}
 	return OK;
 }
 
+//--------------------------------------------------------------------
+// BufMgr::NewExtent
+//
+// Input    : howMany - how many pages to allocate
+//            ring    - (optional) access strategy to pin the pages
+//                      through, see PinPage
+//            near    - (optional) a page to allocate close after, such
+//                      as the last page of the same file
+// Output   : firstPid - the page id of the first page allocated
+//            pages    - pages[i] is page firstPid + i in memory
+// Purpose  : Allocate a run of howMany consecutive pages, like
+//            NewPage, and pin all of them as empty pages, so none is
+//            read. The caller initializes and unpins each.
+// Return   : OK if all pages are allocated and pinned. FAIL otherwise,
+//            with none of them left allocated.
+//--------------------------------------------------------------------
+
+Status BufMgr::NewExtent (PageID& firstPid, Page **pages, int howMany, BufferRing *ring, PageID near)
+{
+	if (howMany < 1) return FAIL;
+	pthread_mutex_lock(&pool->allocLock);
+	Status status = (near == INVALID_PAGE) ? MINIBASE_DB->AllocatePage(firstPid, howMany)
+		: MINIBASE_DB->AllocatePage(firstPid, howMany, near);
+	pthread_mutex_unlock(&pool->allocLock);
+	if (status != OK) return FAIL;
+	Trace(pool, TRACE_NEW, firstPid, howMany);
+	for (int i = 0; i < howMany; i++) {
+		long start = LatencyClock();
+		int frameIndex = PinFrame(firstPid + i, true, ring);
+		RecordLatency(PIN_PAGE_LATENCY, start);
+		if (frameIndex == INVALID_FRAME) {
+			// The pages pinned so far go with their frames.
+			for (int j = 0; j < i; j++) FreePage(firstPid + j);
+			pthread_mutex_lock(&pool->allocLock);
+			MINIBASE_DB->DeallocatePage(firstPid + i, howMany - i);
+			pthread_mutex_unlock(&pool->allocLock);
+			return FAIL;
+		}
+		pages[i] = frames[frameIndex]->GetPage();
+	}
+	return OK;
+}
+
 //--------------------------------------------------------------------
 // BufMgr::FreePage
 //
 // Input    : pid     - page id of a particular page 
+//            guard   - or the guard holding the one pin on it, which
+//                      is cleared
 // Output   : None
 // Purpose  : Free the memory allocated for the page with 
 //            page id = pid  
@@ -162,18 +1190,41 @@ Status BufMgr::NewPage (PageID& firstPid, Page*& firstPage, int howMany)
 
 Status BufMgr::FreePage(PageID pid)
 {
-	int frameIndex = FindFrame(pid);
-	if (frameIndex == INVALID_FRAME) {
-		MINIBASE_DB->DeallocatePage(pid);
-	} else {
+	BufShard *shard = ShardOf(pool, pid);
+	pthread_mutex_lock(&shard->latch);
+	if (shard->cache != NULL) shard->cache->Remove(pid);
+	int frameIndex = WaitForFrame(pool, shard, pid);
+	if (frameIndex != INVALID_FRAME) {
 		Frame* frame = frames[frameIndex];
-		if (frame->GetPinCount() > 1) return FAIL;
-		frame->EmptyIt();
-		MINIBASE_DB->DeallocatePage(pid);
+		if (frame->GetPinCount() > 1) {
+			pthread_mutex_unlock(&shard->latch);
+			return FAIL;
+		}
+		shard->pageTable->Delete(pid);
+		EmptyFrame(pool, frame);
+		shard->replacer->PageOut(FrameInShard(pool, frameIndex));
 	}
+	Trace(pool, TRACE_FREE, pid);
+	// Deallocating pins space map pages, maybe of this very shard.
+	pthread_mutex_unlock(&shard->latch);
+
+	pthread_mutex_lock(&pool->allocLock);
+	MINIBASE_DB->DeallocatePage(pid);
+	pthread_mutex_unlock(&pool->allocLock);
 	return OK;
 }
 
+Status BufMgr::FreePage(PageGuard& guard)
+{
+	if (guard.page == NULL) return FAIL;
+	PageID pid = guard.pid;
+	// The pin goes with the page.
+	guard.page = NULL;
+	guard.pid = INVALID_PAGE;
+	guard.frameNo = INVALID_FRAME;
+	return FreePage(pid);
+}
+
 
 //--------------------------------------------------------------------
 // BufMgr::FlushPage
@@ -192,16 +1243,23 @@ Status BufMgr::FreePage(PageID pid)
 Status BufMgr::FlushPage(PageID pid)
 {
 	if (pid == INVALID_PAGE) return FAIL;
+	BufShard *shard = ShardOf(pool, pid);
+	ShardLatch latch(shard);
 	int frameIndex = FindFrame(pid);
 	if (frameIndex == INVALID_FRAME) return FAIL;
 	Frame* frame = frames[frameIndex];
 	if (frame->GetPinCount() != 0) return FAIL;
 	Status status = OK;
 	if (frame->IsDirty()) {
+		double start = Now();
 		status = frame->Write();
-		numDirtyPageWrites++;
+		shard->numDirtyPageWrites++;
+		Charge(shard, frame->GetFileTag(), threadOperator, 0, 0, 1, Now() - start);
 	}
-	frame->EmptyIt();
+	shard->pageTable->Delete(pid);
+	EmptyFrame(pool, frame);
+	shard->replacer->PageOut(FrameInShard(pool, frameIndex));
+	Trace(pool, TRACE_FLUSH, pid);
 	return status;
 } 
 
@@ -215,23 +1273,150 @@ Status BufMgr::FlushPage(PageID pid)
 // PostCond : All dirty pages in the buffer pool are written to 
 //            disk (even if some pages are pinned). All frames are empty.
 // Return   : OK if operation is successful.  FAIL otherwise.
+// Note     : Dirty pages are written in page id order, the runs of
+//            consecutive page ids all in flight at once, see WriteBack.
+//            All shards are latched throughout.
 //--------------------------------------------------------------------
 
 Status BufMgr::FlushAllPages()
 {
+	LockAllShards(pool);
 	Status status = OK;
+
+	DirtyPage *dirty = new DirtyPage[numOfBuf];
+	int numOfDirty = 0;
 	for (int i = 0; i < numOfBuf; i++) {
 		if (frames[i]->GetPinCount() != 0) status = FAIL;
 		if (frames[i]->IsDirty()) {
-			frames[i]->Write();
-			numDirtyPageWrites++;
+			dirty[numOfDirty].pid = frames[i]->GetPageID();
+			dirty[numOfDirty].frameNo = i;
+			numOfDirty++;
 		}
-		frames[i]->EmptyIt();
 	}
-	return status;
+	if (WriteBack(pool, frames, dirty, numOfDirty, true) != OK) status = FAIL;
+	delete[] dirty;
+
+	for (int s = 0; s < pool->numOfShards; s++) {
+		BufShard *shard = &pool->shards[s];
+		for (int i = 0; i < shard->numOfFrames; i++) {
+			Frame *frame = shard->frames[i];
+			if (frame->GetPageID() != INVALID_PAGE) shard->replacer->PageOut(i);
+			EmptyFrame(pool, frame);
+		}
+		shard->pageTable->EmptyIt();
+	}
+	Trace(pool, TRACE_FLUSH_ALL, INVALID_PAGE);
+	UnlockAllShards(pool);
+	return status;
 }
 
 
+//--------------------------------------------------------------------
+// BufMgr::BeginOptimisticRead
+//
+// Input    : pid  - page id of a particular page
+//            read - left over from an earlier read of the same page,
+//                   or new
+// Output   : page - the page in the buffer pool, to be read only
+//            read - what EndOptimisticRead checks against
+// Purpose  : Start reading a page without pinning it. If read still
+//            matches the frame the page was last found in, this is a
+//            single load; otherwise one page table probe under the
+//            shard latch. Neither writes anything shared, and the
+//            replacer does not hear about the access. A pinned page
+//            is not read this way: whoever holds the pin may be
+//            changing it, and the version only moves when they unpin.
+// Condition: The page may be evicted or changed while it is being
+//            read, so the caller must not follow anything it reads
+//            from it (offsets, lengths) outside the page, and must
+//            not trust any of it until EndOptimisticRead agrees.
+// Return   : OK if the page is resident and unpinned.  FAIL if it is
+//            not resident, leaving read.frameNo INVALID_FRAME, or
+//            pinned; either way the caller pins it instead, or tries
+//            again later.
+//--------------------------------------------------------------------
+
+Status BufMgr::BeginOptimisticRead(PageID pid, Page*& page, OptimisticRead& read)
+{
+	if (read.pid == pid && read.frameNo >= 0 && read.frameNo < __atomic_load_n(&numOfBuf, __ATOMIC_ACQUIRE)
+		&& frames[read.frameNo]->GetVersion() == read.version) {
+		if (frames[read.frameNo]->GetPinCount() != 0) return FAIL;
+		page = frames[read.frameNo]->GetPage();
+		return OK;
+	}
+
+	BufShard *shard = ShardOf(pool, pid);
+	ShardLatch latch(shard);
+	int frameIndex = FindFrame(pid);
+	read.pid = pid;
+	read.frameNo = frameIndex;
+	if (frameIndex == INVALID_FRAME) return FAIL;
+	// The page table and the page ids of frames only change under the
+	// latch; the contents of a page also change under a pin.
+	read.version = frames[frameIndex]->GetVersion();
+	if (frames[frameIndex]->GetPinCount() != 0) return FAIL;
+	page = frames[frameIndex]->GetPage();
+	return OK;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::EndOptimisticRead
+//
+// Input    : read - as filled in by BeginOptimisticRead
+// Output   : None
+// Purpose  : Check an optimistic read.
+// Return   : TRUE if the frame still holds the page, unchanged and
+//            not pinned since, so everything read since
+//            BeginOptimisticRead is consistent. FALSE if it has to be
+//            read again.
+//--------------------------------------------------------------------
+
+Bool BufMgr::EndOptimisticRead(const OptimisticRead& read)
+{
+	// The loads of the page must be done before the frame is checked.
+	// A writer that pinned the page meanwhile still holds the pin or
+	// has moved the version by unpinning it dirty.
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	Frame *frame = frames[read.frameNo];
+	return frame->GetPinCount() == 0 && frame->GetVersion() == read.version;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::CopyPage
+//
+// Input    : pid  - page id of a particular page
+// Output   : copy - a consistent copy of the page
+// Purpose  : Read a page with optimistic reads, for lookups that only
+//            need a snapshot of it. A page that is not resident is
+//            pinned to load it and read again. While the page is
+//            pinned by someone, who may be changing it, or a read
+//            races with a change, the thread yields and tries again.
+//            Only after COPY_TRIES tries, e.g. if the caller holds the
+//            page pinned itself, is it copied under a pin of its own.
+// Return   : OK if operation is successful.  FAIL otherwise.
+//--------------------------------------------------------------------
+
+Status BufMgr::CopyPage(PageID pid, Page *copy)
+{
+	OptimisticRead read;
+	Page *page;
+	for (int i = 0; i < COPY_TRIES; i++) {
+		if (BeginOptimisticRead(pid, page, read) == OK) {
+			memcpy((char *)copy, (const char *)page, sizeof(Page));
+			if (EndOptimisticRead(read)) return OK;
+		} else if (read.frameNo == INVALID_FRAME) {
+			if (PinPage(pid, page) != OK) return FAIL;
+			UnpinPage(pid);
+			continue;
+		}
+		sched_yield();
+	}
+
+	if (PinPage(pid, page) != OK) return FAIL;
+	memcpy((char *)copy, (const char *)page, sizeof(Page));
+	return UnpinPage(pid);
+}
+
 //--------------------------------------------------------------------
 // BufMgr::GetNumOfUnpinnedFrames
 //
@@ -242,22 +1427,1141 @@ Status BufMgr::FlushAllPages()
 // Condition: None
 // PostCond : None
 // Return   : The number of unpinned buffers in the buffer pool.
+//            With other threads pinning, it may be out of date as
+//            soon as it is returned.
 //--------------------------------------------------------------------
 
 unsigned int BufMgr::GetNumOfUnpinnedFrames()
 {
 	int count = 0;
-	for (int i = 0; i < numOfBuf; i++) {
+	int n = __atomic_load_n(&numOfBuf, __ATOMIC_ACQUIRE);
+	for (int i = 0; i < n; i++) {
 		if (frames[i]->GetPinCount() == 0) count++;
 	}
 	return count;
 }
 
+//--------------------------------------------------------------------
+// BufMgr::SetReplacementPolicy
+//
+// Input    : policy - name of a replacement policy known to
+//                     Replacer::Create, e.g. "Clock" or "GClock".
+// Output   : None
+// Purpose  : Switch the buffer pool to another replacement policy.
+//            SystemDefs ignores its replacement_policy argument and
+//            always gets the default Clock, so callers that want a
+//            different policy pass the same name here afterwards.
+// Condition: None. Resident pages stay in the pool, but the new
+//            policy starts without any history about them.
+// PostCond : Victims are chosen by the new policy, one instance of it
+//            per shard.
+// Return   : OK if the policy exists.  FAIL otherwise.
+//--------------------------------------------------------------------
+
+Status BufMgr::SetReplacementPolicy(const char *policy)
+{
+	LockAllShards(pool);
+	Status status = OK;
+	for (int s = 0; s < pool->numOfShards && status == OK; s++) {
+		BufShard *shard = &pool->shards[s];
+		Replacer *newReplacer = Replacer::Create(policy, shard->numOfFrames, shard->frames);
+		if (newReplacer == NULL) {
+			// Only the first shard can fail; the name is the same for all.
+			status = FAIL;
+		} else {
+			delete shard->replacer;
+			shard->replacer = newReplacer;
+		}
+	}
+	UnlockAllShards(pool);
+	return status;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::Resize
+//
+// Input    : bufSize - the new number of frames
+// Output   : None
+// Purpose  : Grow or shrink the buffer pool while it is in use.
+//            Growing adds empty frames to every shard. Shrinking
+//            moves the pages in the frames that go into the empty
+//            frames their shard keeps, most used first, writes back
+//            and evicts those that do not fit, and returns the memory
+//            of the frames to the system. The replacers keep their
+//            history throughout (see Replacer::MoveFrame and
+//            Replacer::Resize). All shards are latched throughout.
+// Condition: At least one frame per shard, and at most the maximum
+//            given at construction, since that much address space is
+//            reserved up front. When shrinking, the frames that go
+//            must not be pinned. The number of shards stays as it was
+//            at construction.
+// PostCond : Pinned pages keep their frames, so pins and PageGuards
+//            held across the resize stay valid.
+// Return   : OK if the pool now has bufSize frames.  FAIL otherwise,
+//            leaving its size as it was.
+//--------------------------------------------------------------------
+
+Status BufMgr::Resize(int bufSize)
+{
+	if (bufSize < pool->numOfShards || bufSize > pool->capacity) return FAIL;
+	LockAllShards(pool);
+	int oldSize = numOfBuf;
+
+	for (int i = bufSize; i < oldSize; i++) {
+		if (frames[i]->GetPinCount() != 0) {
+			UnlockAllShards(pool);
+			return FAIL;
+		}
+	}
+
+	if (bufSize < oldSize) {
+		// Move the most used pages of each shard's frames that go into
+		// the empty frames it keeps, and write back the dirty ones left.
+		WarmPage *tail = new WarmPage[oldSize - bufSize];
+		DirtyPage *dirty = new DirtyPage[oldSize - bufSize];
+		int numOfDirty = 0;
+		for (int s = 0; s < pool->numOfShards; s++) {
+			BufShard *shard = &pool->shards[s];
+			int n = FramesOfShard(pool, s, bufSize);
+			int numOfTail = 0;
+			for (int i = n; i < shard->numOfFrames; i++) {
+				PageID pid = shard->frames[i]->GetPageID();
+				if (pid == INVALID_PAGE) continue;
+				tail[numOfTail].pid = pid;
+				tail[numOfTail].uses = shard->frames[i]->GetUsageCount();
+				tail[numOfTail].frameNo = i;
+				numOfTail++;
+			}
+			qsort(tail, numOfTail, sizeof(WarmPage), CompareWarmPagesByUses);
+			int j = 0;
+			for (int t = numOfTail - 1; t >= 0; t--) {
+				int i = tail[t].frameNo;
+				while (j < n && shard->frames[j]->GetPageID() != INVALID_PAGE) j++;
+				if (j < n) {
+					shard->frames[j]->TakeOver(shard->frames[i]);
+					shard->pageTable->Insert(tail[t].pid, FrameInPool(pool, shard, j));
+					shard->replacer->MoveFrame(i, j);
+				} else if (shard->frames[i]->IsDirty()) {
+					dirty[numOfDirty].pid = tail[t].pid;
+					dirty[numOfDirty].frameNo = FrameInPool(pool, shard, i);
+					numOfDirty++;
+				}
+			}
+		}
+		delete[] tail;
+		Status status = WriteBack(pool, frames, dirty, numOfDirty, true);
+		delete[] dirty;
+		if (status != OK) {
+			UnlockAllShards(pool);
+			return FAIL;
+		}
+
+		for (int s = 0; s < pool->numOfShards; s++) {
+			BufShard *shard = &pool->shards[s];
+			for (int i = FramesOfShard(pool, s, bufSize); i < shard->numOfFrames; i++) {
+				Frame *frame = shard->frames[i];
+				if (frame->GetPageID() == INVALID_PAGE) continue;
+				// The page is on disk as it is, so it may go to the second tier.
+				if (shard->cache != NULL) shard->cache->Put(frame->GetPageID(), frame->GetPage());
+				shard->pageTable->Delete(frame->GetPageID());
+				shard->replacer->PageOut(i);
+				EmptyFrame(pool, frame);
+			}
+		}
+
+		// Whole system pages only; optimistic readers may still look at
+		// the frames that went, and find them empty and zeroed.
+		char *from = pool->arena + ((size_t)bufSize * MINIBASE_PAGESIZE + ARENA_PAGE_SIZE - 1) / ARENA_PAGE_SIZE * ARENA_PAGE_SIZE;
+		char *to = pool->arena + (size_t)oldSize * MINIBASE_PAGESIZE;
+		if (to > from) madvise(from, to - from, MADV_DONTNEED);
+	} else {
+		ConstructFrames(pool, frames, bufSize);
+	}
+	__atomic_store_n(&numOfBuf, bufSize, __ATOMIC_RELEASE);
+
+	for (int s = 0; s < pool->numOfShards; s++) {
+		BufShard *shard = &pool->shards[s];
+		int n = FramesOfShard(pool, s, bufSize);
+		for (int i = shard->numOfFrames; i < n; i++) shard->frames[i] = frames[FrameInPool(pool, shard, i)];
+		if (n == shard->numOfFrames) continue;
+		shard->numOfFrames = n;
+		shard->replacer->Resize(n);
+		ResizePageTable(pool, shard);
+	}
+	UnlockAllShards(pool);
+	return OK;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::SetCompressedCacheSize
+//
+// Input    : bytes - memory for the compressed second tier, 0 for
+//                    none (the default)
+// Output   : None
+// Purpose  : Keep pages evicted from the pool in memory, compressed,
+//            so that missing them again does not read the disk, see
+//            PageCache. The memory is split evenly over the shards.
+//            Evicted dirty pages are still written back first, so
+//            the tier only ever holds clean copies and never has to
+//            be flushed. Any pages in the old tier are dropped.
+// Return   : OK.
+//--------------------------------------------------------------------
+
+Status BufMgr::SetCompressedCacheSize(size_t bytes)
+{
+	LockAllShards(pool);
+	for (int s = 0; s < pool->numOfShards; s++) {
+		BufShard *shard = &pool->shards[s];
+		delete shard->cache;
+		shard->cache = (bytes > 0) ? new PageCache(bytes / pool->numOfShards) : NULL;
+	}
+	UnlockAllShards(pool);
+	return OK;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::GetNumOfBuffers
+//
+// Input    : None
+// Output   : None
+// Purpose  : Find out how many frames the buffer pool has.
+// Condition: None
+// PostCond : None
+// Return   : The number of frames in the buffer pool.
+//--------------------------------------------------------------------
+
+unsigned int BufMgr::GetNumOfBuffers()
+{
+	return __atomic_load_n(&numOfBuf, __ATOMIC_ACQUIRE);
+}
+
+// Older name of GetNumOfUnpinnedFrames, still used by heaptest.
+unsigned int BufMgr::GetNumOfUnpinnedBuffers()
+{
+	return GetNumOfUnpinnedFrames();
+}
+
+//--------------------------------------------------------------------
+// PageGuard
+//
+// Moving a guard hands its pin over and leaves the source empty.
+// Release unpins the page now; it does nothing on an empty guard.
+//--------------------------------------------------------------------
+
+PageGuard::PageGuard( PageGuard&& other )
+{
+	bufMgr = other.bufMgr;
+	pid = other.pid;
+	frameNo = other.frameNo;
+	page = other.page;
+	dirty = other.dirty;
+	other.page = NULL;
+	other.pid = INVALID_PAGE;
+	other.frameNo = INVALID_FRAME;
+}
+
+PageGuard& PageGuard::operator=( PageGuard&& other )
+{
+	if (this != &other) {
+		Release();
+		bufMgr = other.bufMgr;
+		pid = other.pid;
+		frameNo = other.frameNo;
+		page = other.page;
+		dirty = other.dirty;
+		other.page = NULL;
+		other.pid = INVALID_PAGE;
+		other.frameNo = INVALID_FRAME;
+	}
+	return *this;
+}
+
+Status PageGuard::Release()
+{
+	if (page == NULL) return OK;
+	Status status = bufMgr->UnpinFrame(pid, frameNo, dirty);
+	page = NULL;
+	pid = INVALID_PAGE;
+	frameNo = INVALID_FRAME;
+	dirty = FALSE;
+	return status;
+}
+
+//--------------------------------------------------------------------
+// Constructor for BufferRing
+//
+// Input   : size - number of frames the ring may hold on to
+// Output  : None
+// PostCond: The ring is empty; it takes frames from the replacer
+//           until it has size of them.
+//--------------------------------------------------------------------
+
+BufferRing::BufferRing( int size )
+{
+	static int lastRingId = 0;
+	id = __atomic_add_fetch(&lastRingId, 1, __ATOMIC_RELAXED);
+	this->size = (size > 0) ? size : 1;
+	current = 0;
+	frameNos = new int[this->size];
+	pids = new PageID[this->size];
+	stamps = new unsigned long[this->size];
+	for (int i = 0; i < this->size; i++) {
+		frameNos[i] = INVALID_FRAME;
+		pids[i] = INVALID_PAGE;
+		stamps[i] = 0;
+	}
+}
+
+BufferRing::~BufferRing()
+{
+	delete[] frameNos;
+	delete[] pids;
+	delete[] stamps;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::Prefetch
+//
+// Input    : pids - page ids that are about to be pinned, in order
+//            n    - number of page ids
+//            ring - access strategy they will be pinned through, NULL
+//                   if none
+// Output   : None
+// Purpose  : Read ahead. Pages that are not resident are given frames
+//            as a miss would give them, through ring if there is one,
+//            and read into them in the background, each run of
+//            consecutive page ids with one MINIBASE_DB->SubmitReadPages,
+//            while the call returns at once. A run stays in flight with
+//            its frames pinned until the first pin of one of its pages,
+//            or a later Prefetch that finds it read, ends it. At most
+//            MAX_PREFETCH_RUNS runs, and a quarter of the pool, are in
+//            flight at once; the pages beyond are not read ahead.
+// Return   : The number of pages prefetched; 0 if all were resident
+//            or already on their way.
+//--------------------------------------------------------------------
+
+int BufMgr::Prefetch(const PageID *pids, int n, BufferRing *ring)
+{
+	// Runs read by now need nobody to wait for them.
+	PrefetchRun *run;
+	while ((run = ClaimPrefetchRun(pool, INVALID_PAGE, true)) != NULL) FinishPrefetchRun(pool, run);
+
+	int issued = 0;
+	int i = 0;
+	while (i < n) {
+		// Take a free run, and room for as many pages as it may have.
+		run = NULL;
+		pthread_mutex_lock(&pool->prefetchLock);
+		for (int r = 0; r < MAX_PREFETCH_RUNS && run == NULL; r++) {
+			if (pool->prefetchRuns[r].state == PREFETCH_FREE) run = &pool->prefetchRuns[r];
+		}
+		int maxPages = numOfBuf / 4 - pool->numOfPrefetching;
+		if (maxPages > AIO_MAX_RUN) maxPages = AIO_MAX_RUN;
+		if (run != NULL && maxPages > 0) {
+			run->state = PREFETCH_STARTING;
+			pool->numOfPrefetching += maxPages;
+		}
+		pthread_mutex_unlock(&pool->prefetchLock);
+		if (run == NULL || maxPages <= 0) break;
+
+		// A page that is resident, or comes from the second tier, or
+		// finds no frame, ends the run.
+		Page *pages[AIO_MAX_RUN];
+		int length = 0;
+		PageID firstPid = INVALID_PAGE;
+		for (; i < n && length < maxPages; i++) {
+			if (length > 0 && pids[i] != firstPid + length) break;
+			Bool loaded = FALSE;
+			int frameIndex = PrefetchFrame(pids[i], ring, loaded);
+			if (loaded) issued++;
+			if (frameIndex == INVALID_FRAME) {
+				if (length == 0) continue;
+				i++;
+				break;
+			}
+			if (length == 0) firstPid = pids[i];
+			run->frameNos[length] = frameIndex;
+			pages[length++] = frames[frameIndex]->GetPage();
+		}
+		run->firstPid = firstPid;
+		run->numOfPages = length;
+		if (length > 0) MINIBASE_DB->SubmitReadPages(firstPid, pages, length, run->request);
+
+		// From here on, whoever needs one of its pages may end the run.
+		pthread_mutex_lock(&pool->prefetchLock);
+		pool->numOfPrefetching -= maxPages - length;
+		pool->numPrefetches += length;
+		run->state = (length > 0) ? PREFETCH_IN_FLIGHT : PREFETCH_FREE;
+		pthread_mutex_unlock(&pool->prefetchLock);
+		for (int j = 0; j < length; j++) {
+			BufShard *shard = ShardOf(pool, firstPid + j);
+			ShardLatch latch(shard);
+			pthread_cond_broadcast(&shard->readDone);
+		}
+		issued += length;
+	}
+	return issued;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::PrefetchFrame
+//
+// Input    : pid, ring - as for Prefetch, one page
+// Output   : loaded    - TRUE if the second tier had the page
+// Purpose  : Give a page Prefetch reads ahead its frame, as PinFrame
+//            gives one to a missed page, pinned for the run and marked
+//            as being read into; or, if the second tier has the page,
+//            load it there and then and leave it unpinned.
+// Return   : The frame to read the page into, INVALID_FRAME if there
+//            is none (the page is resident or loaded, or every frame
+//            of its shard is pinned).
+//--------------------------------------------------------------------
+
+int BufMgr::PrefetchFrame(PageID pid, BufferRing *ring, Bool& loaded)
+{
+	BufShard *shard = ShardOf(pool, pid);
+	ShardLatch latch(shard);
+	if (FindFrame(pid) != INVALID_FRAME || IsBeingWrittenBack(shard, pid)) return INVALID_FRAME;
+	shard->replacer->PageMiss(pid);
+	int slot = 0;
+	int frameIndex = PickVictim(shard, ring, slot);
+	if (frameIndex == INVALID_FRAME) return INVALID_FRAME;
+	Frame *frame = frames[frameIndex];
+	if (EvictFrame(pool, shard, frame) != OK) return INVALID_FRAME;
+	frame->SetFileTag(threadFile);
+	frame->Pin();
+	shard->pageTable->Insert(pid, frameIndex);
+	shard->replacer->PageIn(FrameInShard(pool, frameIndex));
+	if (ring != NULL) {
+		ring->frameNos[slot] = frameIndex;
+		ring->pids[slot] = pid;
+		ring->stamps[slot] = frame->GetTimeStamp();
+		ring->current = (slot + 1) % ring->size;
+	}
+	if (!BeginFrameRead(shard, frame, pid, shard->cache)) return frameIndex;
+	loaded = TRUE;
+	frame->SetPrefetched(TRUE);
+	if (frame->Unpin() == 0) shard->replacer->Unpinned(FrameInShard(pool, frameIndex));
+	return INVALID_FRAME;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::StartBackgroundWriter
+//
+// Input    : dirtyRatio - fraction of the frames that may hold dirty
+//                         pages before the writer starts on them
+//            interval   - milliseconds the writer sleeps between
+//                         rounds
+// Output   : None
+// Purpose  : Start a thread that trickles dirty, unpinned pages to
+//            disk, so that evictions mostly find clean victims and
+//            PinPage rarely has to write. A foreground eviction that
+//            does have to write wakes the writer early.
+// Return   : OK if the writer is running, FAIL if it was already
+//            running or the thread could not be created.
+//--------------------------------------------------------------------
+
+Status BufMgr::StartBackgroundWriter(double dirtyRatio, int interval)
+{
+	if (pool->writerRunning) return FAIL;
+	pool->dirtyTarget = (dirtyRatio > 0) ? dirtyRatio : 0;
+	pool->writerInterval = (interval > 0) ? interval : 1;
+	pool->stopWriter = false;
+	pool->writerRunning = true;
+	if (pthread_create(&pool->writer, NULL, BackgroundWriter, this) != 0) {
+		pool->writerRunning = false;
+		return FAIL;
+	}
+	return OK;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::StopBackgroundWriter
+//
+// Purpose  : Stop the background writer, waiting for the page it is
+//            writing, if any. Dirty pages it has not reached stay in
+//            the pool.
+// Return   : OK (also if it was not running).
+//--------------------------------------------------------------------
+
+Status BufMgr::StopBackgroundWriter()
+{
+	pthread_mutex_lock(&pool->writerLock);
+	if (!pool->writerRunning) {
+		pthread_mutex_unlock(&pool->writerLock);
+		return OK;
+	}
+	pool->stopWriter = true;
+	pthread_cond_signal(&pool->writerWakeUp);
+	pthread_mutex_unlock(&pool->writerLock);
+
+	pthread_join(pool->writer, NULL);
+	pool->writerRunning = false;
+	return OK;
+}
+
+void *BufMgr::BackgroundWriter(void *bufMgr)
+{
+	BufMgr *bm = (BufMgr *)bufMgr;
+	BufPool *pool = bm->pool;
+
+	pthread_mutex_lock(&pool->writerLock);
+	while (!pool->stopWriter) {
+		pthread_mutex_unlock(&pool->writerLock);
+		bm->WriteBehind();
+		pthread_mutex_lock(&pool->writerLock);
+
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		long nsec = now.tv_usec * 1000L + (pool->writerInterval % 1000) * 1000000L;
+		struct timespec deadline;
+		deadline.tv_sec = now.tv_sec + pool->writerInterval / 1000 + nsec / 1000000000L;
+		deadline.tv_nsec = nsec % 1000000000L;
+		if (!pool->stopWriter) pthread_cond_timedwait(&pool->writerWakeUp, &pool->writerLock, &deadline);
+	}
+	pthread_mutex_unlock(&pool->writerLock);
+	return NULL;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::WriteBehind
+//
+// Purpose  : One round of the background writer. If more frames are
+//            dirty than the target allows, write unpinned dirty pages
+//            back in page id order, so the disk sees mostly sequential
+//            writes, until the target is met. Only the latch of the
+//            shard being written is held, one page at a time, so the
+//            foreground is never held up for more than one write.
+//--------------------------------------------------------------------
+
+void BufMgr::WriteBehind()
+{
+	int size = GetNumOfBuffers();
+	int target = (int)(pool->dirtyTarget * size);
+	int numOfDirty = 0;
+	int n = 0;
+	DirtyPage *pages = new DirtyPage[size];
+	for (int s = 0; s < pool->numOfShards; s++) {
+		BufShard *shard = &pool->shards[s];
+		ShardLatch latch(shard);
+		for (int i = 0; i < shard->numOfFrames; i++) {
+			Frame *frame = shard->frames[i];
+			if (!frame->IsDirty()) continue;
+			numOfDirty++;
+			// The pool may have grown since it was sized up.
+			if (frame->GetPinCount() == 0 && n < size) {
+				pages[n].pid = frame->GetPageID();
+				pages[n].frameNo = FrameInPool(pool, shard, i);
+				n++;
+			}
+		}
+	}
+
+	if (numOfDirty > target) {
+		qsort(pages, n, sizeof(DirtyPage), CompareDirtyPages);
+		for (int i = 0; i < n && numOfDirty > target && !__atomic_load_n(&pool->stopWriter, __ATOMIC_RELAXED); i++) {
+			ShardLatch latch(ShardOf(pool, pages[i].pid));
+			// The foreground may have run since the list was made.
+			Frame *frame = frames[pages[i].frameNo];
+			if (frame->GetPageID() != pages[i].pid || !frame->IsDirty() || frame->GetPinCount() != 0) continue;
+			if (frame->Write() == OK) {
+				pool->numBackgroundWrites++;
+				numOfDirty--;
+			}
+		}
+	}
+	delete[] pages;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::StartTrace, StopTrace
+//
+// Input    : filename - file to write the trace to, replaced if it
+//                       exists
+// Output   : None
+// Purpose  : Capture every PinPage, UnpinPage, NewPage, FreePage,
+//            FlushPage and FlushAllPages from now until StopTrace (or
+//            destruction), in the order the pool saw them, so that
+//            bmsim can replay them against any replacement policy and
+//            pool size. The replay starts from an empty pool, so a
+//            trace is best started on one. A pin through a BufferRing
+//            records the ring, so that the replay recycles its frames
+//            too. Optimistic reads, which do not pin, are not traced.
+// Return   : OK, FAIL if a trace is already being captured or the file
+//            could not be written.
+//--------------------------------------------------------------------
+
+Status BufMgr::StartTrace(const char *filename)
+{
+	pthread_mutex_lock(&pool->traceLock);
+	if (pool->trace != NULL) {
+		pthread_mutex_unlock(&pool->traceLock);
+		return FAIL;
+	}
+	Status status;
+	TraceWriter *trace = new TraceWriter(filename, status);
+	if (status == OK) __atomic_store_n(&pool->trace, trace, __ATOMIC_RELEASE);
+	else delete trace;
+	pthread_mutex_unlock(&pool->traceLock);
+	return status;
+}
+
+Status BufMgr::StopTrace()
+{
+	pthread_mutex_lock(&pool->traceLock);
+	TraceWriter *trace = pool->trace;
+	__atomic_store_n(&pool->trace, (TraceWriter *)NULL, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&pool->traceLock);
+	if (trace == NULL) return FAIL;
+	Status status = trace->Close();
+	delete trace;
+	return status;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::DumpResidentPages
+//
+// Input    : filename - file to write, replaced if it exists
+// Output   : None
+// Purpose  : Record which pages are in the pool, and how often each
+//            has been pinned since it was loaded, so that WarmUp can
+//            load them again after a restart. The file holds
+//            RESIDENT_SET_MAGIC, the number of pages and then one
+//            ResidentPage per page.
+// Return   : OK if the file was written, FAIL otherwise.
+//--------------------------------------------------------------------
+
+Status BufMgr::DumpResidentPages(const char *filename)
+{
+	int size = GetNumOfBuffers();
+	ResidentPage *pages = new ResidentPage[size];
+	int n = 0;
+	for (int s = 0; s < pool->numOfShards; s++) {
+		BufShard *shard = &pool->shards[s];
+		ShardLatch latch(shard);
+		for (int i = 0; i < shard->numOfFrames && n < size; i++) {
+			Frame *frame = shard->frames[i];
+			if (frame->GetPageID() == INVALID_PAGE) continue;
+			pages[n].pid = frame->GetPageID();
+			pages[n].uses = frame->GetUsageCount();
+			n++;
+		}
+	}
+
+	int header[2] = { RESIDENT_SET_MAGIC, n };
+	FILE *file = fopen(filename, "wb");
+	Status status = FAIL;
+	if (file != NULL) {
+		if (fwrite(header, sizeof header, 1, file) == 1
+			&& (int)fwrite(pages, sizeof(ResidentPage), n, file) == n) status = OK;
+		if (fclose(file) != 0) status = FAIL;
+	}
+	delete[] pages;
+	return status;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::WarmUp
+//
+// Input    : filename - a file written by DumpResidentPages
+// Output   : None
+// Purpose  : Start the pool warm. The pages listed in the file are
+//            read into empty frames, in page id order with one
+//            MINIBASE_DB->SubmitReadPages per run of consecutive page
+//            ids, as many runs in flight at once as the queue takes.
+//            If they do not all fit, the most used are kept. They are
+//            then handed to the replacers least used first, so the
+//            most used look the most recently used. No page is
+//            evicted, and all shards are latched throughout, so this
+//            is best done before the pool is first used. When the
+//            buffer manager is destroyed, it dumps its resident pages
+//            to the same file for the next start.
+// Return   : The number of pages loaded; 0 if the file does not
+//            exist yet or is not a resident set file.
+//--------------------------------------------------------------------
+
+int BufMgr::WarmUp(const char *filename)
+{
+	free(pool->residentSetFile);
+	pool->residentSetFile = strdup(filename);
+
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL) return 0;
+	int header[2];
+	ResidentPage *entries = NULL;
+	int n = 0;
+	if (fread(header, sizeof header, 1, file) == 1 && header[0] == RESIDENT_SET_MAGIC && header[1] > 0) {
+		entries = new ResidentPage[header[1]];
+		n = (int)fread(entries, sizeof(ResidentPage), header[1], file);
+	}
+	fclose(file);
+
+	WarmPage *pages = new WarmPage[n > 0 ? n : 1];
+	for (int i = 0; i < n; i++) {
+		pages[i].pid = entries[i].pid;
+		pages[i].uses = entries[i].uses;
+		pages[i].frameNo = INVALID_FRAME;
+	}
+	delete[] entries;
+
+	LockAllShards(pool);
+
+	// Drop duplicates, pages the database does not have (any more) and
+	// pages that are already resident.
+	qsort(pages, n, sizeof(WarmPage), CompareWarmPagesByPageID);
+	int numOfPages = MINIBASE_DB->GetNumOfPages();
+	int kept = 0;
+	for (int i = 0; i < n; i++) {
+		PageID pid = pages[i].pid;
+		if (pid < 0 || pid >= numOfPages || (kept > 0 && pages[kept - 1].pid == pid)
+			|| ShardOf(pool, pid)->pageTable->LookUp(pid) != INVALID_FRAME) continue;
+		pages[kept++] = pages[i];
+	}
+	n = kept;
+
+	// Keep the most used pages that fit in the empty frames of their
+	// shard, and pick those frames.
+	int *next = new int[pool->numOfShards];
+	for (int s = 0; s < pool->numOfShards; s++) next[s] = 0;
+	qsort(pages, n, sizeof(WarmPage), CompareWarmPagesByUses);
+	for (int i = n - 1; i >= 0; i--) {
+		BufShard *shard = ShardOf(pool, pages[i].pid);
+		int s = shard->index;
+		while (next[s] < shard->numOfFrames && shard->frames[next[s]]->GetPageID() != INVALID_PAGE) next[s]++;
+		if (next[s] == shard->numOfFrames) continue;
+		pages[i].frameNo = FrameInPool(pool, shard, next[s]++);
+	}
+	delete[] next;
+
+	// Read them, up to AIO_QUEUE_DEPTH runs of consecutive page ids at
+	// a time.
+	qsort(pages, n, sizeof(WarmPage), CompareWarmPagesByPageID);
+	Page **run = new Page*[n > 0 ? n : 1];
+	AIORequest *requests = new AIORequest[AIO_QUEUE_DEPTH];
+	int *firsts = new int[AIO_QUEUE_DEPTH];
+	int *lasts = new int[AIO_QUEUE_DEPTH];
+	for (int first = 0; first < n; ) {
+		int numOfRuns = 0;
+		while (first < n && numOfRuns < AIO_QUEUE_DEPTH) {
+			int last = first + 1;
+			if (pages[first].frameNo == INVALID_FRAME) {
+				first = last;
+				continue;
+			}
+			run[first] = frames[pages[first].frameNo]->GetPage();
+			while (last < n && last - first < AIO_MAX_RUN && pages[last].pid == pages[first].pid + (last - first)
+				&& pages[last].frameNo != INVALID_FRAME) {
+				run[last] = frames[pages[last].frameNo]->GetPage();
+				last++;
+			}
+			MINIBASE_DB->SubmitReadPages(pages[first].pid, &run[first], last - first, requests[numOfRuns]);
+			firsts[numOfRuns] = first;
+			lasts[numOfRuns++] = last;
+			first = last;
+		}
+		for (int r = 0; r < numOfRuns; r++) {
+			if (MINIBASE_DB->WaitIO(requests[r]) != OK) {
+				for (int i = firsts[r]; i < lasts[r]; i++) pages[i].frameNo = INVALID_FRAME;
+				continue;
+			}
+			for (int i = firsts[r]; i < lasts[r]; i++) {
+				BufShard *shard = ShardOf(pool, pages[i].pid);
+				frames[pages[i].frameNo]->SetPageID(pages[i].pid);
+				shard->pageTable->Insert(pages[i].pid, pages[i].frameNo);
+				if (shard->cache != NULL) shard->cache->Remove(pages[i].pid);
+			}
+		}
+	}
+	delete[] lasts;
+	delete[] firsts;
+	delete[] requests;
+	delete[] run;
+
+	qsort(pages, n, sizeof(WarmPage), CompareWarmPagesByUses);
+	int loaded = 0;
+	for (int i = 0; i < n; i++) {
+		if (pages[i].frameNo == INVALID_FRAME) continue;
+		BufShard *shard = ShardOf(pool, pages[i].pid);
+		int frameNo = FrameInShard(pool, pages[i].frameNo);
+		shard->replacer->PageMiss(pages[i].pid);
+		shard->replacer->PageIn(frameNo);
+		shard->replacer->Unpinned(frameNo);
+		loaded++;
+	}
+
+	UnlockAllShards(pool);
+	delete[] pages;
+	return loaded;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::GetStat, GetWriteStat, GetPrefetchStat
+//
+// Output   : The counters since construction or the last ResetStat,
+//            summed over the shards.
+// Return   : OK.
+//--------------------------------------------------------------------
+
+Status BufMgr::GetStat(long& pinNo, long& missNo)
+{
+	pinNo = missNo = 0;
+	for (int s = 0; s < pool->numOfShards; s++) {
+		BufShard *shard = &pool->shards[s];
+		ShardLatch latch(shard);
+		pinNo += shard->numOfPins;
+		missNo += shard->numOfPins - shard->numOfHits;
+	}
+	return OK;
+}
+
+Status BufMgr::GetWriteStat(long& foregroundNo, long& backgroundNo)
+{
+	foregroundNo = 0;
+	for (int s = 0; s < pool->numOfShards; s++) {
+		BufShard *shard = &pool->shards[s];
+		ShardLatch latch(shard);
+		foregroundNo += shard->numDirtyPageWrites;
+	}
+	backgroundNo = pool->numBackgroundWrites;
+	return OK;
+}
+
+Status BufMgr::GetCompressedCacheStat(long& lookupNo, long& hitNo, long& pageNo, long& byteNo)
+{
+	lookupNo = hitNo = pageNo = byteNo = 0;
+	for (int s = 0; s < pool->numOfShards; s++) {
+		BufShard *shard = &pool->shards[s];
+		ShardLatch latch(shard);
+		if (shard->cache == NULL) continue;
+		long lookups, hits;
+		int pages;
+		size_t bytes;
+		shard->cache->GetStat(lookups, hits, pages, bytes);
+		lookupNo += lookups;
+		hitNo += hits;
+		pageNo += pages;
+		byteNo += (long)bytes;
+	}
+	return OK;
+}
+
+Status BufMgr::GetPrefetchStat(long& prefetchNo, long& hitNo, long& wastedNo)
+{
+	pthread_mutex_lock(&pool->prefetchLock);
+	prefetchNo = pool->numPrefetches;
+	hitNo = pool->numPrefetchHits;
+	wastedNo = pool->numWastedPrefetches;
+	pthread_mutex_unlock(&pool->prefetchLock);
+	return OK;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::SetFileTag, SetOperatorTag
+//
+// Input    : firstPid - first page of a file, as it is in the DB file
+//                       directory for files that have a name
+//            fileName - or the name, looked up in the directory
+//            opName   - name of an operator, e.g. a join method
+//            INVALID_PAGE or NULL for none.
+// Output   : None
+// Purpose  : Charge the pins, misses and read time of the calling
+//            thread from now on to the file and operator, so that it
+//            can be seen which of them the pool is busy with, without
+//            resetting the global counters. A page read for a file is
+//            remembered as the file's, and writing it back is charged
+//            to the file and to the operator of the thread that does.
+//            Up to MAX_STAT_TAGS files and operators are told apart;
+//            the counters are kept from construction on, ResetStat
+//            leaves them alone. See also StatScope.
+// Return   : OK, FAIL if the file has no entry in the directory or
+//            there are too many, in which case the thread has no tag.
+//--------------------------------------------------------------------
+
+Status BufMgr::SetFileTag(PageID firstPid)
+{
+	threadFile = -1;
+	if (firstPid == INVALID_PAGE) return OK;
+	int n = __atomic_load_n(&pool->numOfFileTags, __ATOMIC_ACQUIRE);
+	for (int i = 0; i < n; i++) {
+		if (pool->fileTags[i] == firstPid) {
+			threadFile = i;
+			return OK;
+		}
+	}
+	pthread_mutex_lock(&pool->tagLock);
+	n = pool->numOfFileTags;
+	for (int i = 0; i < n && threadFile < 0; i++) {
+		if (pool->fileTags[i] == firstPid) threadFile = i;
+	}
+	if (threadFile < 0 && n < MAX_STAT_TAGS) {
+		pool->fileTags[n] = firstPid;
+		__atomic_store_n(&pool->numOfFileTags, n + 1, __ATOMIC_RELEASE);
+		threadFile = n;
+	}
+	pthread_mutex_unlock(&pool->tagLock);
+	return (threadFile >= 0) ? OK : FAIL;
+}
+
+Status BufMgr::SetFileTag(const char *fileName)
+{
+	PageID firstPid = INVALID_PAGE;
+	if (fileName != NULL && MINIBASE_DB->GetFileEntry(fileName, firstPid) != OK) {
+		threadFile = -1;
+		return FAIL;
+	}
+	return SetFileTag(firstPid);
+}
+
+Status BufMgr::SetOperatorTag(const char *opName)
+{
+	threadOperator = -1;
+	if (opName == NULL) return OK;
+	int n = __atomic_load_n(&pool->numOfOperatorTags, __ATOMIC_ACQUIRE);
+	for (int i = 0; i < n; i++) {
+		if (strcmp(pool->operatorTags[i], opName) == 0) {
+			threadOperator = i;
+			return OK;
+		}
+	}
+	pthread_mutex_lock(&pool->tagLock);
+	n = pool->numOfOperatorTags;
+	for (int i = 0; i < n && threadOperator < 0; i++) {
+		if (strcmp(pool->operatorTags[i], opName) == 0) threadOperator = i;
+	}
+	if (threadOperator < 0 && n < MAX_STAT_TAGS) {
+		pool->operatorTags[n] = strdup(opName);
+		__atomic_store_n(&pool->numOfOperatorTags, n + 1, __ATOMIC_RELEASE);
+		threadOperator = n;
+	}
+	pthread_mutex_unlock(&pool->tagLock);
+	return (threadOperator >= 0) ? OK : FAIL;
+}
+
+PageID BufMgr::GetFileTag()
+{
+	return (threadFile >= 0) ? pool->fileTags[threadFile] : INVALID_PAGE;
+}
+
+const char *BufMgr::GetOperatorTag()
+{
+	return (threadOperator >= 0) ? pool->operatorTags[threadOperator] : NULL;
+}
+
+// Scopes are entered on every heap file and scan call, so one for the
+// file the thread is already tagged with does not look it up again.
+StatScope::StatScope(PageID firstPid, const char *opName)
+{
+	file = threadFile;
+	op = threadOperator;
+	BufMgr *bufMgr = MINIBASE_BM;
+	if (firstPid != INVALID_PAGE && (file < 0 || bufMgr->pool->fileTags[file] != firstPid)) {
+		bufMgr->SetFileTag(firstPid);
+	}
+	if (opName != NULL) bufMgr->SetOperatorTag(opName);
+}
+
+StatScope::~StatScope()
+{
+	threadFile = file;
+	threadOperator = op;
+}
+
+//--------------------------------------------------------------------
+// BufMgr::GetFileStat, GetOperatorStat
+//
+// Input    : firstPid, opName - as given to SetFileTag, SetOperatorTag
+// Output   : stat - what has been charged to the file or operator,
+//                   summed over the shards
+// Return   : OK, FAIL if it has never been a tag.
+//--------------------------------------------------------------------
+
+static void SumStat( BufPool *pool, int tag, bool isFile, AccessStat& stat )
+{
+	memset(&stat, 0, sizeof stat);
+	for (int s = 0; s < pool->numOfShards; s++) {
+		BufShard *shard = &pool->shards[s];
+		ShardLatch latch(shard);
+		AccessStat *from = isFile ? &shard->fileStats[tag] : &shard->operatorStats[tag];
+		AddStat(&stat, from->numOfPins, from->numOfMisses, from->numDirtyPageWrites, from->ioTime);
+	}
+}
+
+Status BufMgr::GetFileStat(PageID firstPid, AccessStat& stat)
+{
+	memset(&stat, 0, sizeof stat);
+	int n = __atomic_load_n(&pool->numOfFileTags, __ATOMIC_ACQUIRE);
+	for (int i = 0; i < n; i++) {
+		if (pool->fileTags[i] == firstPid) {
+			SumStat(pool, i, true, stat);
+			return OK;
+		}
+	}
+	return FAIL;
+}
+
+Status BufMgr::GetOperatorStat(const char *opName, AccessStat& stat)
+{
+	memset(&stat, 0, sizeof stat);
+	int n = __atomic_load_n(&pool->numOfOperatorTags, __ATOMIC_ACQUIRE);
+	for (int i = 0; i < n; i++) {
+		if (opName != NULL && strcmp(pool->operatorTags[i], opName) == 0) {
+			SumStat(pool, i, false, stat);
+			return OK;
+		}
+	}
+	return FAIL;
+}
+
+static void PrintJSONString( ostream& out, const char *s )
+{
+	out<<'"';
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\') out<<'\\'<<*s;
+		else if ((unsigned char)*s < 0x20) {
+			char escaped[8];
+			sprintf(escaped, "\\u%04x", (unsigned char)*s);
+			out<<escaped;
+		}
+		else out<<*s;
+	}
+	out<<'"';
+}
+
+static void PrintAccessStat( ostream& out, const char *name, const AccessStat& stat, StatFormat format )
+{
+	if (format == STAT_JSON) {
+		out<<"{\"name\": ";
+		PrintJSONString(out, name);
+		out<<", \"pins\": "<<stat.numOfPins<<", \"misses\": "<<stat.numOfMisses
+		   <<", \"dirtyWrites\": "<<stat.numDirtyPageWrites<<", \"ioSeconds\": "<<stat.ioTime<<"}";
+	} else {
+		out<<"  "<<name<<": "<<stat.numOfPins<<" pins, "<<stat.numOfMisses<<" misses, "
+		   <<stat.numDirtyPageWrites<<" dirty writes, "<<stat.ioTime<<"s in I/O"<<endl;
+	}
+}
+
+static void PrintLatency( ostream& out, LatencyOp op, StatFormat format )
+{
+	LatencyHistogram h;
+	GetLatencyHistogram(op, h);
+	if (format == STAT_JSON) {
+		out<<"\""<<LatencyOpName(op)<<"\": {\"calls\": "<<h.numOfCalls<<", \"meanNs\": "<<h.Mean()
+		   <<", \"p50Ns\": "<<h.Percentile(0.5)<<", \"p90Ns\": "<<h.Percentile(0.9)
+		   <<", \"p99Ns\": "<<h.Percentile(0.99)<<", \"p999Ns\": "<<h.Percentile(0.999)
+		   <<", \"maxNs\": "<<h.maxNs<<", \"buckets\": [";
+		for (int b = 0; b < LATENCY_BUCKETS; b++) out<<(b > 0 ? ", " : "")<<h.counts[b];
+		out<<"]}";
+	} else if (h.numOfCalls > 0) {
+		out<<"Latency of "<<LatencyOpName(op)<<": "<<h.numOfCalls<<" calls, mean "<<h.Mean()
+		   <<"ns, p50 "<<h.Percentile(0.5)<<"ns, p90 "<<h.Percentile(0.9)<<"ns, p99 "<<h.Percentile(0.99)
+		   <<"ns, p99.9 "<<h.Percentile(0.999)<<"ns, max "<<h.maxNs<<"ns"<<endl;
+	}
+}
+
+void BufMgr::ResetStat()
+{
+	for (int s = 0; s < pool->numOfShards; s++) {
+		BufShard *shard = &pool->shards[s];
+		ShardLatch latch(shard);
+		shard->numOfPins = shard->numOfHits = shard->numDirtyPageWrites = 0;
+		if (shard->cache != NULL) shard->cache->ResetStat();
+	}
+	pthread_mutex_lock(&pool->prefetchLock);
+	pool->numPrefetches = pool->numPrefetchHits = pool->numWastedPrefetches = 0;
+	pthread_mutex_unlock(&pool->prefetchLock);
+	pool->numBackgroundWrites = 0;
+	ResetLatencyHistograms();
+}
+
 void  BufMgr::PrintStat() {
-	cout<<"**Buffer Manager Statistics**"<<endl;
-	cout<<"Number of Dirty Pages Written to Disk: "<<numDirtyPageWrites<<endl;
-	cout<<"Number of Pin Page Requests: "<<totalCall<<endl;
-	cout<<"Number of Pin Page Request Misses "<<totalCall-totalHit<<endl;
+	ExportStat(cout, STAT_TEXT);
+}
+
+//--------------------------------------------------------------------
+// BufMgr::ExportStat
+//
+// Input    : out    - where to write
+//            format - STAT_TEXT, as PrintStat prints, or STAT_JSON,
+//                     one object for monitoring to scrape
+// Output   : None
+// Purpose  : Write out all the statistics: the counters, the compressed
+//            cache's, those by file and operator (see SetFileTag), and
+//            the latency of PinPage and of DB::ReadPage and WritePage
+//            with its percentiles (see latency.h). The counters and
+//            the latencies are since the last ResetStat.
+// Return   : OK.
+//--------------------------------------------------------------------
+
+Status BufMgr::ExportStat(ostream& out, StatFormat format)
+{
+	long pins, misses, writes, backgroundWrites, prefetches, prefetchHits, wastedPrefetches;
+	GetStat(pins, misses);
+	GetWriteStat(writes, backgroundWrites);
+	GetPrefetchStat(prefetches, prefetchHits, wastedPrefetches);
+	bool hasCache = pool->shards[0].cache != NULL;
+	long lookups, cacheHits, cachedPages, cachedBytes;
+	GetCompressedCacheStat(lookups, cacheHits, cachedPages, cachedBytes);
+	bool json = (format == STAT_JSON);
+
+	if (json) {
+		out<<"{\"pins\": "<<pins<<", \"misses\": "<<misses<<", \"dirtyWrites\": "<<writes
+		   <<", \"backgroundWrites\": "<<backgroundWrites<<", \"prefetches\": "<<prefetches
+		   <<", \"prefetchHits\": "<<prefetchHits<<", \"wastedPrefetches\": "<<wastedPrefetches;
+		if (hasCache) {
+			out<<", \"compressedCache\": {\"lookups\": "<<lookups<<", \"hits\": "<<cacheHits
+			   <<", \"pages\": "<<cachedPages<<", \"bytes\": "<<cachedBytes<<"}";
+		}
+	} else {
+		out<<"**Buffer Manager Statistics**"<<endl;
+		out<<"Number of Dirty Pages Written to Disk: "<<writes<<endl;
+		if (backgroundWrites > 0) {
+			out<<"Number of Dirty Pages Written in the Background: "<<backgroundWrites<<endl;
+		}
+		out<<"Number of Pin Page Requests: "<<pins<<endl;
+		out<<"Number of Pin Page Request Misses "<<misses<<endl;
+		if (prefetches > 0) {
+			out<<"Number of Pages Prefetched: "<<prefetches<<endl;
+			out<<"Number of Prefetch Hits: "<<prefetchHits<<endl;
+			out<<"Number of Wasted Prefetches: "<<wastedPrefetches<<endl;
+		}
+		if (hasCache) {
+			out<<"Number of Misses Served by the Compressed Cache: "<<cacheHits<<" of "<<lookups;
+			if (lookups > 0) out<<" ("<<100.0 * cacheHits / lookups<<"%)";
+			out<<endl;
+			out<<"Compressed Cache: "<<cachedPages<<" pages in "<<cachedBytes<<" bytes"<<endl;
+		}
+	}
+
+	AccessStat stat;
+	int numOfFiles = __atomic_load_n(&pool->numOfFileTags, __ATOMIC_ACQUIRE);
+	if (json) out<<", \"files\": [";
+	else if (numOfFiles > 0) out<<"By File:"<<endl;
+	for (int i = 0; i < numOfFiles; i++) {
+		// Temporary files have no name in the directory.
+		char name[MAX_NAME + 16];
+		if (MINIBASE_DB->GetFileName(pool->fileTags[i], name) != OK) {
+			sprintf(name, "(page %d)", pool->fileTags[i]);
+		}
+		SumStat(pool, i, true, stat);
+		if (json && i > 0) out<<", ";
+		PrintAccessStat(out, name, stat, format);
+	}
+	int numOfOperators = __atomic_load_n(&pool->numOfOperatorTags, __ATOMIC_ACQUIRE);
+	if (json) out<<"], \"operators\": [";
+	else if (numOfOperators > 0) out<<"By Operator:"<<endl;
+	for (int i = 0; i < numOfOperators; i++) {
+		SumStat(pool, i, false, stat);
+		if (json && i > 0) out<<", ";
+		PrintAccessStat(out, pool->operatorTags[i], stat, format);
+	}
+
+	if (json) out<<"], \"latency\": {";
+	for (int op = 0; op < NUM_LATENCY_OPS; op++) {
+		if (json && op > 0) out<<", ";
+		PrintLatency(out, (LatencyOp)op, format);
+	}
+	if (json) out<<"}}"<<endl;
+	return OK;
 }
 
 //--------------------------------------------------------------------
@@ -266,16 +2570,14 @@ void  BufMgr::PrintStat() {
 // Input    : pid - a page id 
 // Output   : None
 // Purpose  : Look for the page in the buffer pool, return the frame
-//            number if found.
-// PreCond  : None
+//            number if found. This is a single page table probe, so
+//            it costs the same regardless of the pool size.
+// PreCond  : The latch of the page's shard is held.
 // PostCond : None
 // Return   : the frame number if found. INVALID_FRAME otherwise.
 //--------------------------------------------------------------------
 
 int BufMgr::FindFrame( PageID pid )
 {
-	for (int i = 0; i < numOfBuf; i++) {
-		if (frames[i]->GetPageID() == pid) return i;
-	}
-	return INVALID_FRAME;
+	return ShardOf(pool, pid)->pageTable->LookUp(pid);
 }
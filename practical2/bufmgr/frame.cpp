@@ -1,43 +1,99 @@
+#include <string.h>
+
 #include "../include/frame.h"
 #include "../include/db.h"
+#include "../include/pagecache.h"
 
 Frame::Frame() {
+	data = NULL;
+	timestamp = 0;
+	version = 0;
 	EmptyIt();
 }
 Frame::~Frame(){
-	delete data;
 }
 void Frame::Pin() {
-	pinCount++;
-	clock_gettime(CLOCK_REALTIME, &timestamp);
+	__atomic_add_fetch(&pinCount, 1, __ATOMIC_ACQ_REL);
+	timestamp++;
+	uses++;
 }
-void Frame::Unpin() {
-	pinCount--;
+int Frame::Unpin() {
+	return __atomic_sub_fetch(&pinCount, 1, __ATOMIC_ACQ_REL);
 }
 void Frame::EmptyIt() {
-	data = new Page();
 	pid = INVALID_PAGE;
-	pinCount = 0;
+	__atomic_store_n(&pinCount, 0, __ATOMIC_RELEASE);
 	dirty = false;
-	clock_gettime(CLOCK_REALTIME, &timestamp);
+	uses = 0;
+	fileTag = -1;
+	prefetched = false;
+	__atomic_add_fetch(&version, 2, __ATOMIC_RELEASE);
+}
+void Frame::SetPage(Page *page) {
+	data = page;
 }
 void Frame::DirtyIt() {
 	dirty = true;
+	// Whoever dirties the page has changed it.
+	__atomic_add_fetch(&version, 2, __ATOMIC_RELEASE);
 }
 void Frame::SetPageID(PageID pid) {
 	this->pid = pid;
+	uses = 0;
+	prefetched = false;
+	__atomic_add_fetch(&version, 2, __ATOMIC_RELEASE);
 }
 Bool Frame::IsDirty() {
 	return dirty;
 }
 Status Frame::Write() {
-	return MINIBASE_DB->WritePage(pid, data);
+	Status status = MINIBASE_DB->WritePage(pid, data);
+	if (status == OK) dirty = false;
+	return status;
 }
-Status Frame::Read(PageID pid) {
+Status Frame::Read(PageID pid, PageCache *cache) {
+	if (BeginRead(pid, cache)) return OK;
 	Status status = MINIBASE_DB->ReadPage(pid, data);
-	if (status == OK) this->pid = pid;
+	EndRead(pid, status);
 	return status;
 }
+Bool Frame::BeginRead(PageID pid, PageCache *cache) {
+	// Optimistic readers that see an odd version, or a different one
+	// afterwards, know the contents were being replaced.
+	__atomic_add_fetch(&version, 1, __ATOMIC_ACQ_REL);
+	if (cache == NULL || !cache->Take(pid, data)) return FALSE;
+	EndRead(pid, OK);
+	return TRUE;
+}
+void Frame::EndRead(PageID pid, Status status) {
+	if (status == OK) {
+		this->pid = pid;
+		dirty = false;
+		uses = 0;
+		prefetched = false;
+	}
+	__atomic_add_fetch(&version, 1, __ATOMIC_ACQ_REL);
+}
+void Frame::TakeOver(Frame *from) {
+	__atomic_add_fetch(&version, 1, __ATOMIC_ACQ_REL);
+	memcpy((char *)data, (char *)from->data, MINIBASE_PAGESIZE);
+	pid = from->pid;
+	dirty = from->dirty;
+	uses = from->uses;
+	fileTag = from->fileTag;
+	prefetched = from->prefetched;
+	__atomic_add_fetch(&version, 1, __ATOMIC_ACQ_REL);
+	from->EmptyIt();
+}
+Bool Frame::IsBeingRead() {
+	return (GetVersion() & 1) != 0;
+}
+void Frame::SetPrefetched(Bool prefetched) {
+	this->prefetched = prefetched;
+}
+Bool Frame::IsPrefetched() {
+	return prefetched;
+}
 PageID Frame::GetPageID() {
 	return pid;
 }
@@ -45,8 +101,20 @@ Page* Frame::GetPage() {
 	return data;
 }
 int Frame::GetPinCount() {
-	return pinCount;
+	return __atomic_load_n(&pinCount, __ATOMIC_ACQUIRE);
+}
+unsigned long Frame::GetTimeStamp() {
+	return timestamp;
+}
+int Frame::GetUsageCount() {
+	return uses;
+}
+unsigned long Frame::GetVersion() {
+	return __atomic_load_n(&version, __ATOMIC_ACQUIRE);
+}
+void Frame::SetFileTag(int tag) {
+	fileTag = tag;
 }
-long Frame::GetTimeStamp() {
-	timestamp.tv_nsec;
+int Frame::GetFileTag() {
+	return fileTag;
 }
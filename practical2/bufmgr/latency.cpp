@@ -0,0 +1,179 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "../include/latency.h"
+
+// The histograms of one thread. Only the thread itself changes them,
+// but readers merge them at any time, so every field is loaded and
+// stored atomically (relaxed, never a read-modify-write). A thread
+// whose epoch is behind clears them before recording again; readers
+// skip them until then.
+struct ThreadLatencies
+{
+	LatencyHistogram histograms[NUM_LATENCY_OPS];
+	int epoch;
+	ThreadLatencies *prev;
+	ThreadLatencies *next;
+};
+
+static pthread_mutex_t latencyLock = PTHREAD_MUTEX_INITIALIZER;   // protects the three below
+static ThreadLatencies *threads = NULL;                // of the running threads that have recorded anything
+static LatencyHistogram retired[NUM_LATENCY_OPS];      // of the threads that have exited since the last reset
+static int epoch = 0;                                  // advanced by every reset
+
+static pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t threadKey;
+static __thread ThreadLatencies *own = NULL;
+
+static const char *opNames[NUM_LATENCY_OPS] = { "PinPage", "ReadPage", "WritePage" };
+
+static inline long Load( const long *p )
+{
+	return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline void Store( long *p, long value )
+{
+	__atomic_store_n(p, value, __ATOMIC_RELAXED);
+}
+
+// Add from into to, both maybe being recorded into.
+static void Merge( LatencyHistogram& to, const LatencyHistogram& from )
+{
+	for (int b = 0; b < LATENCY_BUCKETS; b++) to.counts[b] += Load(&from.counts[b]);
+	to.numOfCalls += Load(&from.numOfCalls);
+	to.totalNs += Load(&from.totalNs);
+	long max = Load(&from.maxNs);
+	if (max > to.maxNs) to.maxNs = max;
+}
+
+static void Clear( ThreadLatencies *t )
+{
+	for (int op = 0; op < NUM_LATENCY_OPS; op++) {
+		LatencyHistogram *h = &t->histograms[op];
+		for (int b = 0; b < LATENCY_BUCKETS; b++) Store(&h->counts[b], 0);
+		Store(&h->numOfCalls, 0);
+		Store(&h->totalNs, 0);
+		Store(&h->maxNs, 0);
+	}
+}
+
+// Keep what an exiting thread recorded.
+static void ThreadExit( void *arg )
+{
+	ThreadLatencies *t = (ThreadLatencies *)arg;
+	pthread_mutex_lock(&latencyLock);
+	if (t->epoch == epoch) {
+		for (int op = 0; op < NUM_LATENCY_OPS; op++) Merge(retired[op], t->histograms[op]);
+	}
+	if (t->prev != NULL) t->prev->next = t->next;
+	else threads = t->next;
+	if (t->next != NULL) t->next->prev = t->prev;
+	pthread_mutex_unlock(&latencyLock);
+	delete t;
+}
+
+static void CreateKey()
+{
+	pthread_key_create(&threadKey, ThreadExit);
+}
+
+static ThreadLatencies *Register()
+{
+	pthread_once(&keyOnce, CreateKey);
+	ThreadLatencies *t = new ThreadLatencies;
+	Clear(t);
+	t->prev = NULL;
+	pthread_mutex_lock(&latencyLock);
+	t->epoch = epoch;
+	t->next = threads;
+	if (threads != NULL) threads->prev = t;
+	threads = t;
+	pthread_mutex_unlock(&latencyLock);
+	pthread_setspecific(threadKey, t);
+	own = t;
+	return t;
+}
+
+void LatencyHistogram::Clear()
+{
+	memset(counts, 0, sizeof counts);
+	numOfCalls = totalNs = maxNs = 0;
+}
+
+long LatencyHistogram::Mean() const
+{
+	return (numOfCalls > 0) ? totalNs / numOfCalls : 0;
+}
+
+//--------------------------------------------------------------------
+// LatencyHistogram::Percentile
+//
+// Input    : p - fraction of the calls, e.g. 0.99
+// Purpose  : Estimate the latency at the given percentile, assuming
+//            the latencies in the bucket it falls in are spread
+//            evenly over it.
+// Return   : The estimate in ns, no more than the longest latency
+//            seen; 0 if nothing has been recorded.
+//--------------------------------------------------------------------
+
+long LatencyHistogram::Percentile(double p) const
+{
+	if (numOfCalls == 0) return 0;
+	double target = p * numOfCalls;
+	long below = 0;
+	for (int b = 0; b < LATENCY_BUCKETS; b++) {
+		if (counts[b] > 0 && below + counts[b] >= target) {
+			long lower = (b == 0) ? 0 : 1L << b;
+			long upper = 1L << (b + 1);
+			long ns = lower + (long)((upper - lower) * ((target - below) / counts[b]));
+			return (ns < maxNs) ? ns : maxNs;
+		}
+		below += counts[b];
+	}
+	return maxNs;
+}
+
+void RecordLatency(LatencyOp op, long startNs)
+{
+	long ns = LatencyClock() - startNs;
+	if (ns < 0) ns = 0;
+	ThreadLatencies *t = (own != NULL) ? own : Register();
+	int current = __atomic_load_n(&epoch, __ATOMIC_RELAXED);
+	if (t->epoch != current) {
+		Clear(t);
+		__atomic_store_n(&t->epoch, current, __ATOMIC_RELEASE);
+	}
+
+	int b = (ns <= 1) ? 0 : 63 - __builtin_clzl((unsigned long)ns);
+	if (b >= LATENCY_BUCKETS) b = LATENCY_BUCKETS - 1;
+	LatencyHistogram *h = &t->histograms[op];
+	Store(&h->counts[b], h->counts[b] + 1);
+	Store(&h->numOfCalls, h->numOfCalls + 1);
+	Store(&h->totalNs, h->totalNs + ns);
+	if (ns > h->maxNs) Store(&h->maxNs, ns);
+}
+
+void GetLatencyHistogram(LatencyOp op, LatencyHistogram& histogram)
+{
+	histogram.Clear();
+	pthread_mutex_lock(&latencyLock);
+	Merge(histogram, retired[op]);
+	for (ThreadLatencies *t = threads; t != NULL; t = t->next) {
+		if (__atomic_load_n(&t->epoch, __ATOMIC_ACQUIRE) == epoch) Merge(histogram, t->histograms[op]);
+	}
+	pthread_mutex_unlock(&latencyLock);
+}
+
+void ResetLatencyHistograms()
+{
+	pthread_mutex_lock(&latencyLock);
+	for (int op = 0; op < NUM_LATENCY_OPS; op++) retired[op].Clear();
+	__atomic_store_n(&epoch, epoch + 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&latencyLock);
+}
+
+const char *LatencyOpName(LatencyOp op)
+{
+	return opNames[op];
+}
@@ -0,0 +1,177 @@
+#include "../include/replacer.h"
+
+LRUK::LRUK( int bufSize, Frame **frames ) {
+	this->frames = frames;
+	this->numOfBuf = bufSize;
+	now = 0;
+	missPenult = 0;
+	last = new unsigned long[bufSize];
+	penult = new unsigned long[bufSize];
+	resident = new PageID[bufSize];
+	heap = new int[bufSize];
+	heapPos = new int[bufSize];
+	heapSize = 0;
+	history = new GhostLists(bufSize, 1);
+	for (int i = 0; i < bufSize; i++) {
+		last[i] = penult[i] = 0;
+		resident[i] = frames[i]->GetPageID();
+		heapPos[i] = -1;
+		if (frames[i]->GetPinCount() == 0) HeapInsert(i);
+	}
+}
+
+LRUK::~LRUK() {
+	delete[] last;
+	delete[] penult;
+	delete[] resident;
+	delete[] heap;
+	delete[] heapPos;
+	delete history;
+}
+
+//--------------------------------------------------------------------
+// LRUK::Older
+//
+// Whether frame a should be evicted before frame b: its second last
+// reference is older, or they tie (typically both have been
+// referenced only once) and its last reference is older.
+//--------------------------------------------------------------------
+
+Bool LRUK::Older(int a, int b) {
+	if (penult[a] != penult[b]) return penult[a] < penult[b];
+	return last[a] < last[b];
+}
+
+void LRUK::HeapSwap(int i, int j) {
+	int t = heap[i];
+	heap[i] = heap[j];
+	heap[j] = t;
+	heapPos[heap[i]] = i;
+	heapPos[heap[j]] = j;
+}
+
+void LRUK::HeapUp(int i) {
+	while (i > 0 && Older(heap[i], heap[(i-1)/2])) {
+		HeapSwap(i, (i-1)/2);
+		i = (i-1)/2;
+	}
+}
+
+void LRUK::HeapDown(int i) {
+	for (;;) {
+		int smallest = i;
+		int l = 2*i + 1, r = 2*i + 2;
+		if (l < heapSize && Older(heap[l], heap[smallest])) smallest = l;
+		if (r < heapSize && Older(heap[r], heap[smallest])) smallest = r;
+		if (smallest == i) return;
+		HeapSwap(i, smallest);
+		i = smallest;
+	}
+}
+
+void LRUK::HeapInsert(int frameNo) {
+	if (heapPos[frameNo] >= 0) return;
+	heap[heapSize] = frameNo;
+	heapPos[frameNo] = heapSize;
+	heapSize++;
+	HeapUp(heapSize - 1);
+}
+
+void LRUK::HeapRemove(int frameNo) {
+	int i = heapPos[frameNo];
+	if (i < 0) return;
+	heapSize--;
+	if (i != heapSize) {
+		HeapSwap(i, heapSize);
+		HeapUp(i);
+		HeapDown(heapPos[heap[i]]);
+	}
+	heapPos[frameNo] = -1;
+}
+
+int LRUK::PickVictim() {
+	return (heapSize > 0) ? heap[0] : INVALID_FRAME;
+}
+
+void LRUK::PageMiss(PageID pid) {
+	int slot = history->Find(pid);
+	missPenult = 0;
+	if (slot >= 0) {
+		missPenult = history->GetStamp(slot);
+		history->Remove(slot);
+	}
+}
+
+void LRUK::PageIn(int frameNo) {
+	HeapRemove(frameNo);
+	if (resident[frameNo] != INVALID_PAGE) history->Add(0, resident[frameNo], last[frameNo]);
+	resident[frameNo] = frames[frameNo]->GetPageID();
+	penult[frameNo] = missPenult;
+	last[frameNo] = ++now;
+	missPenult = 0;
+}
+
+void LRUK::PageHit(int frameNo) {
+	HeapRemove(frameNo);
+	// References made while the page is still pinned belong to the same
+	// use of it (a scan pinning its current page again, say), so they
+	// only refresh the last reference instead of counting as another.
+	if (frames[frameNo]->GetPinCount() == 0) penult[frameNo] = last[frameNo];
+	last[frameNo] = ++now;
+}
+
+void LRUK::Unpinned(int frameNo) {
+	HeapInsert(frameNo);
+}
+
+void LRUK::PageOut(int frameNo) {
+	HeapRemove(frameNo);
+	resident[frameNo] = INVALID_PAGE;
+	last[frameNo] = penult[frameNo] = 0;
+	HeapInsert(frameNo);
+}
+
+void LRUK::MoveFrame(int from, int to) {
+	Bool unpinned = (heapPos[from] >= 0);
+	HeapRemove(to);
+	last[to] = last[from];
+	penult[to] = penult[from];
+	resident[to] = resident[from];
+	PageOut(from);
+	if (unpinned) HeapInsert(to);
+}
+
+void LRUK::Resize(int bufSize) {
+	for (int i = bufSize; i < numOfBuf; i++) HeapRemove(i);
+	unsigned long *newLast = new unsigned long[bufSize];
+	unsigned long *newPenult = new unsigned long[bufSize];
+	PageID *newResident = new PageID[bufSize];
+	int *newHeap = new int[bufSize];
+	int *newHeapPos = new int[bufSize];
+	for (int i = 0; i < bufSize; i++) {
+		if (i < numOfBuf) {
+			newLast[i] = last[i];
+			newPenult[i] = penult[i];
+			newResident[i] = resident[i];
+			newHeapPos[i] = heapPos[i];
+		} else {
+			newLast[i] = newPenult[i] = 0;
+			newResident[i] = INVALID_PAGE;
+			newHeapPos[i] = -1;
+		}
+	}
+	for (int i = 0; i < heapSize; i++) newHeap[i] = heap[i];
+	delete[] last;
+	delete[] penult;
+	delete[] resident;
+	delete[] heap;
+	delete[] heapPos;
+	last = newLast;
+	penult = newPenult;
+	resident = newResident;
+	heap = newHeap;
+	heapPos = newHeapPos;
+	for (int i = numOfBuf; i < bufSize; i++) HeapInsert(i);
+	numOfBuf = bufSize;
+	history->Resize(bufSize);
+}
@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/pagecache.h"
+
+#define MIN_COMPRESSED 32   // about what an empty page compresses to, for sizing the slots
+#define MIN_RUN        3    // shorter runs of a byte are cheaper as literals
+#define MAX_RUN        (MIN_RUN + 0x7f)
+#define MAX_LITERALS   0x80
+
+PageCache::PageCache( size_t capacity ) {
+	this->capacity = capacity;
+	size = 0;
+	maxPages = (int)(capacity / MIN_COMPRESSED) + 1;
+	pids = new PageID[maxPages];
+	data = new char*[maxPages];
+	lengths = new int[maxPages];
+	lists = new LinkedLists(maxPages, 2);
+	for (int i = 0; i < maxPages; i++) {
+		pids[i] = INVALID_PAGE;
+		data[i] = NULL;
+		lists->PushBack(1, i);
+	}
+	index = new PageTable(maxPages);
+	ResetStat();
+}
+
+PageCache::~PageCache() {
+	for (int i = 0; i < maxPages; i++) free(data[i]);
+	delete[] pids;
+	delete[] data;
+	delete[] lengths;
+	delete lists;
+	delete index;
+}
+
+void PageCache::RemoveSlot(int slot) {
+	index->Delete(pids[slot]);
+	pids[slot] = INVALID_PAGE;
+	free(data[slot]);
+	data[slot] = NULL;
+	size -= lengths[slot];
+	lists->PushBack(1, slot);
+}
+
+void PageCache::Put(PageID pid, const Page *page) {
+	Remove(pid);
+
+	char compressed[MINIBASE_PAGESIZE];
+	int length = Compress((const char *)page, compressed);
+	const char *from = compressed;
+	if (length == 0) {
+		length = MINIBASE_PAGESIZE;
+		from = (const char *)page;
+	}
+	if ((size_t)length > capacity) return;
+
+	while (size + length > capacity || lists->Length(1) == 0) RemoveSlot(lists->Front(0));
+	int slot = lists->Front(1);
+	data[slot] = (char *)malloc(length);
+	if (data[slot] == NULL) return;
+	memcpy(data[slot], from, length);
+	lengths[slot] = length;
+	pids[slot] = pid;
+	size += length;
+	lists->PushBack(0, slot);
+	index->Insert(pid, slot);
+}
+
+Bool PageCache::Take(PageID pid, Page *page) {
+	numOfLookups++;
+	int slot = index->LookUp(pid);
+	if (slot < 0) return FALSE;
+	if (lengths[slot] == MINIBASE_PAGESIZE) memcpy((char *)page, data[slot], MINIBASE_PAGESIZE);
+	else Decompress(data[slot], lengths[slot], (char *)page);
+	RemoveSlot(slot);
+	numOfHits++;
+	return TRUE;
+}
+
+void PageCache::Remove(PageID pid) {
+	int slot = index->LookUp(pid);
+	if (slot >= 0) RemoveSlot(slot);
+}
+
+void PageCache::GetStat(long& lookupNo, long& hitNo, int& pageNo, size_t& byteNo) {
+	lookupNo = numOfLookups;
+	hitNo = numOfHits;
+	pageNo = lists->Length(0);
+	byteNo = size;
+}
+
+void PageCache::ResetStat() {
+	numOfLookups = numOfHits = 0;
+}
+
+//--------------------------------------------------------------------
+// PageCache::Compress
+//
+// The code is a sequence of tokens, each a control byte c followed by
+//   c < 0x80:  c + 1 literal bytes, or
+//   c >= 0x80: one byte, which is repeated (c & 0x7f) + MIN_RUN times.
+// Free space, zeroed slots and small integers make long runs, so pages
+// that are not full compress well, and both directions are one pass.
+//--------------------------------------------------------------------
+
+int PageCache::Compress(const char *page, char *out) {
+	const unsigned char *in = (const unsigned char *)page;
+	int o = 0;
+	int literals = 0;   // pending literal bytes, ending just before i
+	int i = 0;
+	while (i <= MINIBASE_PAGESIZE) {
+		int run = 0;
+		if (i < MINIBASE_PAGESIZE) {
+			run = 1;
+			while (i + run < MINIBASE_PAGESIZE && run < MAX_RUN && in[i + run] == in[i]) run++;
+		}
+		// Flush the literals before a run, at the end, or when full.
+		if (literals > 0 && (run >= MIN_RUN || i == MINIBASE_PAGESIZE || literals == MAX_LITERALS)) {
+			if (o + 1 + literals >= MINIBASE_PAGESIZE) return 0;
+			out[o++] = (char)(literals - 1);
+			memcpy(out + o, in + i - literals, literals);
+			o += literals;
+			literals = 0;
+		}
+		if (i == MINIBASE_PAGESIZE) break;
+		if (run >= MIN_RUN) {
+			if (o + 2 >= MINIBASE_PAGESIZE) return 0;
+			out[o++] = (char)(0x80 | (run - MIN_RUN));
+			out[o++] = (char)in[i];
+			i += run;
+		} else {
+			literals++;
+			i++;
+		}
+	}
+	return o;
+}
+
+void PageCache::Decompress(const char *in, int length, char *page) {
+	const unsigned char *code = (const unsigned char *)in;
+	int o = 0;
+	for (int i = 0; i < length; ) {
+		int c = code[i++];
+		if (c & 0x80) {
+			int run = (c & 0x7f) + MIN_RUN;
+			memset(page + o, code[i++], run);
+			o += run;
+		} else {
+			memcpy(page + o, code + i, c + 1);
+			i += c + 1;
+			o += c + 1;
+		}
+	}
+}
@@ -0,0 +1,93 @@
+#include <assert.h>
+
+#include "../include/pagetable.h"
+#include "../include/frame.h"
+
+PageTable::PageTable( int maxEntries ) {
+	unsigned int capacity = 16;
+	shift = 28;
+	this->maxEntries = maxEntries;
+	while (capacity < 2 * (unsigned int)maxEntries) {
+		capacity <<= 1;
+		shift--;
+	}
+	mask = capacity - 1;
+	entries = new Entry[capacity];
+	EmptyIt();
+}
+
+PageTable::~PageTable() {
+	delete[] entries;
+}
+
+//--------------------------------------------------------------------
+// PageTable::Slot
+//
+// Fibonacci hashing: page ids are mostly small and consecutive, so
+// multiply to spread them over the whole 32 bits and take the top
+// log2(capacity) of them, which depend on every bit of the page id.
+//--------------------------------------------------------------------
+
+unsigned int PageTable::Slot(PageID pid) {
+	return ((unsigned int)pid * 2654435769u) >> shift;
+}
+
+void PageTable::Insert(PageID pid, int frameNo) {
+	unsigned int i = Slot(pid);
+	for (unsigned int n = 0; entries[i].pid != INVALID_PAGE && entries[i].pid != pid; n++) {
+		// Only a table filled past maxEntries has no free slot.
+		assert(n < mask);
+		if (n == mask) return;
+		i = (i + 1) & mask;
+	}
+	if (entries[i].pid == INVALID_PAGE) {
+		assert(numOfEntries < maxEntries);
+		numOfEntries++;
+	}
+	entries[i].pid = pid;
+	entries[i].frameNo = frameNo;
+}
+
+Status PageTable::Delete(PageID pid) {
+	unsigned int i = Slot(pid);
+	for (unsigned int n = 0; entries[i].pid != pid; n++) {
+		if (entries[i].pid == INVALID_PAGE || n == mask) return FAIL;
+		i = (i + 1) & mask;
+	}
+	numOfEntries--;
+
+	// Backward-shift deletion: pull every later entry of the probe run
+	// whose home slot does not lie between the hole and itself into the
+	// hole, so lookups never need to skip deleted slots.
+	unsigned int hole = i;
+	unsigned int j = i;
+	for (;;) {
+		j = (j + 1) & mask;
+		if (entries[j].pid == INVALID_PAGE) break;
+		unsigned int home = Slot(entries[j].pid);
+		if (((j - home) & mask) >= ((j - hole) & mask)) {
+			entries[hole] = entries[j];
+			hole = j;
+		}
+	}
+	entries[hole].pid = INVALID_PAGE;
+	entries[hole].frameNo = INVALID_FRAME;
+	return OK;
+}
+
+int PageTable::LookUp(PageID pid) {
+	unsigned int i = Slot(pid);
+	for (unsigned int n = 0; n <= mask && entries[i].pid != INVALID_PAGE; n++) {
+		if (entries[i].pid == pid) return entries[i].frameNo;
+		i = (i + 1) & mask;
+	}
+	return INVALID_FRAME;
+}
+
+void PageTable::EmptyIt() {
+	numOfEntries = 0;
+	for (unsigned int i = 0; i <= mask; i++) {
+		entries[i].pid = INVALID_PAGE;
+		entries[i].frameNo = INVALID_FRAME;
+	}
+}
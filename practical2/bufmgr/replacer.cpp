@@ -1,45 +1,119 @@
+#include <string.h>
+
 #include "../include/replacer.h"
 
+#define GCLOCK_MAX_USAGE 5
+
 
 Replacer::Replacer() {}
 Replacer::~Replacer() {}
 
-Clock::Clock( int bufSize, Frame **frames) {
+Replacer *Replacer::Create(const char *policy, int bufSize, Frame **frames) {
+	if (policy == NULL || strcmp(policy, "Clock") == 0) return new Clock(bufSize, frames);
+	if (strcmp(policy, "GClock") == 0) return new Clock(bufSize, frames, GCLOCK_MAX_USAGE);
+	if (strcmp(policy, "LRU") == 0) return new LRU(bufSize, frames);
+	if (strcmp(policy, "LRUK") == 0) return new LRUK(bufSize, frames);
+	if (strcmp(policy, "2Q") == 0) return new TwoQ(bufSize, frames);
+	if (strcmp(policy, "ARC") == 0) return new ARC(bufSize, frames);
+	return NULL;
+}
+
+Clock::Clock( int bufSize, Frame **frames, int maxUsage) {
 	this->frames = frames;
 	this->numOfBuf = bufSize;
+	this->maxUsage = maxUsage;
 	this->current = 0;
+	usage = new int[bufSize];
+	for (int i = 0; i < bufSize; i++) {
+		usage[i] = (frames[i]->GetPageID() == INVALID_PAGE) ? 0 : 1;
+	}
 }
 
-Clock::~Clock() {}
+Clock::~Clock() {
+	delete[] usage;
+}
 
 int Clock::PickVictim() {
-	for (int i = 0; i < numOfBuf; i++) {
-		if (frames[(current+i)%numOfBuf]->GetPinCount() == 0) {
-			current = (current+i)%numOfBuf;
-			return current;
-		}
+	// Every full turn of the hand lowers each unpinned count by one, so
+	// maxUsage + 1 turns (plus the part of a turn before we started) are
+	// enough to reach zero somewhere if any frame is unpinned at all.
+	for (int i = 0; i < (maxUsage+2)*numOfBuf; i++) {
+		int victim = current;
+		current = (current+1)%numOfBuf;
+		if (frames[victim]->GetPinCount() != 0) continue;
+		if (usage[victim] == 0) return victim;
+		usage[victim]--;
 	}
 	return INVALID_FRAME;
 }
 
+void Clock::PageIn(int frameNo) {
+	usage[frameNo] = 1;
+}
+
+void Clock::PageHit(int frameNo) {
+	if (usage[frameNo] < maxUsage) usage[frameNo]++;
+}
+
+void Clock::PageOut(int frameNo) {
+	usage[frameNo] = 0;
+}
+
+void Clock::MoveFrame(int from, int to) {
+	usage[to] = usage[from];
+	usage[from] = 0;
+}
+
+void Clock::Resize(int bufSize) {
+	int *resized = new int[bufSize];
+	for (int i = 0; i < bufSize; i++) resized[i] = (i < numOfBuf) ? usage[i] : 0;
+	delete[] usage;
+	usage = resized;
+	numOfBuf = bufSize;
+	if (current >= bufSize) current = 0;
+}
+
 LRU::LRU( int bufSize, Frame **frames) {
 	this->frames = frames;
 	this->numOfBuf = bufSize;
+	lists = new LinkedLists(bufSize, 1);
+	for (int i = 0; i < bufSize; i++) {
+		if (frames[i]->GetPageID() == INVALID_PAGE) lists->PushFront(0, i);
+		else if (frames[i]->GetPinCount() == 0) lists->PushBack(0, i);
+	}
 }
 
-LRU::~LRU() {}
+LRU::~LRU() {
+	delete lists;
+}
 
 int LRU::PickVictim() {
-	timespec t;
-	clock_gettime(CLOCK_REALTIME, &t);
-	long lr = t.tv_nsec;
-	int victim = INVALID_FRAME;
-	for (int i = 0; i < numOfBuf; i++) {
-		if (frames[i]->GetPageID() == INVALID_PAGE) return i;
-		if (frames[i]->GetPinCount() == 0 && frames[i]->GetTimeStamp() < lr) {
-			lr = frames[i]->GetTimeStamp();
-			victim = i;
-		}
-	}
-	return victim;
+	return lists->Front(0);
+}
+
+void LRU::PageIn(int frameNo) {
+	lists->Remove(frameNo);
+}
+
+void LRU::PageHit(int frameNo) {
+	lists->Remove(frameNo);
+}
+
+void LRU::Unpinned(int frameNo) {
+	lists->PushBack(0, frameNo);
+}
+
+void LRU::PageOut(int frameNo) {
+	lists->PushFront(0, frameNo);
+}
+
+void LRU::MoveFrame(int from, int to) {
+	lists->Replace(from, to);
+	lists->PushFront(0, from);
+}
+
+void LRU::Resize(int bufSize) {
+	lists->Resize(bufSize);
+	for (int i = numOfBuf; i < bufSize; i++) lists->PushFront(0, i);
+	numOfBuf = bufSize;
 }
@@ -0,0 +1,210 @@
+#include "../include/replacer.h"
+
+LinkedLists::LinkedLists( int size, int numOfLists ) {
+	this->size = size;
+	this->numOfLists = numOfLists;
+	links = new Link[size + numOfLists];
+	listOf = new int[size];
+	lengths = new int[numOfLists];
+	for (int i = 0; i < size; i++) {
+		links[i].prev = links[i].next = -1;
+		listOf[i] = -1;
+	}
+	for (int l = 0; l < numOfLists; l++) {
+		links[size + l].prev = links[size + l].next = size + l;
+		lengths[l] = 0;
+	}
+}
+
+LinkedLists::~LinkedLists() {
+	delete[] links;
+	delete[] listOf;
+	delete[] lengths;
+}
+
+void LinkedLists::PushFront(int list, int i) {
+	Remove(i);
+	int head = size + list;
+	links[i].prev = head;
+	links[i].next = links[head].next;
+	links[links[head].next].prev = i;
+	links[head].next = i;
+	listOf[i] = list;
+	lengths[list]++;
+}
+
+void LinkedLists::PushBack(int list, int i) {
+	Remove(i);
+	int head = size + list;
+	links[i].next = head;
+	links[i].prev = links[head].prev;
+	links[links[head].prev].next = i;
+	links[head].prev = i;
+	listOf[i] = list;
+	lengths[list]++;
+}
+
+void LinkedLists::Remove(int i) {
+	if (listOf[i] < 0) return;
+	links[links[i].prev].next = links[i].next;
+	links[links[i].next].prev = links[i].prev;
+	links[i].prev = links[i].next = -1;
+	lengths[listOf[i]]--;
+	listOf[i] = -1;
+}
+
+void LinkedLists::Replace(int i, int j) {
+	Remove(j);
+	if (listOf[i] < 0) return;
+	links[j] = links[i];
+	links[links[j].prev].next = j;
+	links[links[j].next].prev = j;
+	listOf[j] = listOf[i];
+	links[i].prev = links[i].next = -1;
+	listOf[i] = -1;
+}
+
+void LinkedLists::Resize(int size) {
+	LinkedLists resized(size, numOfLists);
+	for (int l = 0; l < numOfLists; l++) {
+		for (int i = Front(l); i >= 0; i = Next(i)) {
+			if (i < size) resized.PushBack(l, i);
+		}
+	}
+	// The old arrays go with resized.
+	Link *oldLinks = links;
+	int *oldListOf = listOf, *oldLengths = lengths;
+	links = resized.links;
+	listOf = resized.listOf;
+	lengths = resized.lengths;
+	this->size = size;
+	resized.links = oldLinks;
+	resized.listOf = oldListOf;
+	resized.lengths = oldLengths;
+}
+
+int LinkedLists::Front(int list) {
+	int first = links[size + list].next;
+	return (first >= size) ? -1 : first;
+}
+
+int LinkedLists::Next(int i) {
+	int next = links[i].next;
+	return (next >= size) ? -1 : next;
+}
+
+int LinkedLists::ListOf(int i) {
+	return listOf[i];
+}
+
+int LinkedLists::Length(int list) {
+	return lengths[list];
+}
+
+
+GhostLists::GhostLists( int capacity, int numOfLists ) {
+	this->capacity = capacity;
+	this->numOfLists = numOfLists;
+	pids = new PageID[capacity];
+	stamps = new unsigned long[capacity];
+	lists = new LinkedLists(capacity, numOfLists + 1);
+	for (int i = 0; i < capacity; i++) {
+		pids[i] = INVALID_PAGE;
+		lists->PushBack(numOfLists, i);
+	}
+	// PageTable sizes itself for twice as many entries as it is told.
+	index = new PageTable(capacity);
+}
+
+GhostLists::~GhostLists() {
+	delete[] pids;
+	delete[] stamps;
+	delete lists;
+	delete index;
+}
+
+int GhostLists::Find(PageID pid) {
+	return index->LookUp(pid);
+}
+
+int GhostLists::ListOf(int slot) {
+	return lists->ListOf(slot);
+}
+
+unsigned long GhostLists::GetStamp(int slot) {
+	return stamps[slot];
+}
+
+void GhostLists::Add(int list, PageID pid, unsigned long stamp) {
+	int slot = Find(pid);
+	if (slot >= 0) Remove(slot);
+
+	if (lists->Length(numOfLists) == 0) {
+		// Out of slots: forget the oldest ghost, preferably of this list.
+		int from = list;
+		for (int l = 0; lists->Length(from) == 0; l++) from = l;
+		RemoveOldest(from);
+	}
+
+	slot = lists->Front(numOfLists);
+	pids[slot] = pid;
+	stamps[slot] = stamp;
+	lists->PushBack(list, slot);
+	index->Insert(pid, slot);
+}
+
+void GhostLists::Remove(int slot) {
+	index->Delete(pids[slot]);
+	pids[slot] = INVALID_PAGE;
+	lists->PushBack(numOfLists, slot);
+}
+
+void GhostLists::RemoveOldest(int list) {
+	int slot = lists->Front(list);
+	if (slot >= 0) Remove(slot);
+}
+
+int GhostLists::Length(int list) {
+	return lists->Length(list);
+}
+
+void GhostLists::Resize(int capacity) {
+	while (this->capacity - lists->Length(numOfLists) > capacity) {
+		int longest = 0;
+		for (int l = 1; l < numOfLists; l++) {
+			if (lists->Length(l) > lists->Length(longest)) longest = l;
+		}
+		RemoveOldest(longest);
+	}
+
+	// Pack the ghosts that are left into the new slots, keeping the order
+	// of every list.
+	PageID *newPids = new PageID[capacity];
+	unsigned long *newStamps = new unsigned long[capacity];
+	LinkedLists *newLists = new LinkedLists(capacity, numOfLists + 1);
+	PageTable *newIndex = new PageTable(capacity);
+	int used = 0;
+	for (int l = 0; l < numOfLists; l++) {
+		for (int slot = lists->Front(l); slot >= 0; slot = lists->Next(slot)) {
+			newPids[used] = pids[slot];
+			newStamps[used] = stamps[slot];
+			newLists->PushBack(l, used);
+			newIndex->Insert(pids[slot], used);
+			used++;
+		}
+	}
+	for (int slot = used; slot < capacity; slot++) {
+		newPids[slot] = INVALID_PAGE;
+		newLists->PushBack(numOfLists, slot);
+	}
+
+	delete[] pids;
+	delete[] stamps;
+	delete lists;
+	delete index;
+	this->capacity = capacity;
+	pids = newPids;
+	stamps = newStamps;
+	lists = newLists;
+	index = newIndex;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+
+#include "../include/trace.h"
+
+TraceWriter::TraceWriter( const char *filename, Status& status ) {
+	lastPid = 0;
+	file = fopen(filename, "wb");
+	int magic = TRACE_MAGIC;
+	status = (file != NULL && fwrite(&magic, sizeof magic, 1, file) == 1) ? OK : FAIL;
+}
+
+TraceWriter::~TraceWriter() {
+	Close();
+}
+
+void TraceWriter::PutVarint(unsigned long value) {
+	while (value >= 0x80) {
+		putc_unlocked((int)(value & 0x7f) | 0x80, file);
+		value >>= 7;
+	}
+	putc_unlocked((int)value, file);
+}
+
+void TraceWriter::Write(const TraceEvent& event) {
+	if (file == NULL) return;
+	putc_unlocked(event.op | (event.ring != 0 ? TRACE_RING : 0), file);
+	if (event.op == TRACE_FLUSH_ALL) return;
+	long delta = (long)event.pid - lastPid;
+	PutVarint((unsigned long)((delta << 1) ^ (delta >> 63)));
+	lastPid = event.pid;
+	if (event.op == TRACE_NEW) PutVarint((unsigned long)event.count);
+	if (event.ring != 0) {
+		PutVarint((unsigned long)event.ring);
+		PutVarint((unsigned long)event.ringSize);
+	}
+}
+
+Status TraceWriter::Close() {
+	if (file == NULL) return OK;
+	bool failed = ferror(file);
+	if (fclose(file) != 0) failed = true;
+	file = NULL;
+	return failed ? FAIL : OK;
+}
+
+TraceReader::TraceReader( const char *filename, Status& status ) {
+	lastPid = 0;
+	file = fopen(filename, "rb");
+	int magic = 0;
+	status = (file != NULL && fread(&magic, sizeof magic, 1, file) == 1 && magic == TRACE_MAGIC) ? OK : FAIL;
+}
+
+TraceReader::~TraceReader() {
+	if (file != NULL) fclose(file);
+}
+
+bool TraceReader::GetVarint(unsigned long& value) {
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = getc_unlocked(file);
+		if (c == EOF) return false;
+		value |= (unsigned long)(c & 0x7f) << shift;
+		if (!(c & 0x80)) return true;
+	}
+	return false;
+}
+
+Status TraceReader::Next(TraceEvent& event) {
+	if (file == NULL) return FAIL;
+	int op = getc_unlocked(file);
+	if (op == EOF) return DONE;
+	bool ring = (op & TRACE_RING) != 0;
+	op &= ~TRACE_RING;
+	if (op >= NUM_TRACE_OPS || (ring && op != TRACE_PIN && op != TRACE_PIN_EMPTY)) return FAIL;
+	event.op = (TraceOp)op;
+	event.pid = INVALID_PAGE;
+	event.count = event.ring = event.ringSize = 0;
+	if (op == TRACE_FLUSH_ALL) return OK;
+
+	unsigned long zigzag, count, id, size;
+	if (!GetVarint(zigzag)) return FAIL;
+	long delta = (long)(zigzag >> 1) ^ -(long)(zigzag & 1);
+	event.pid = lastPid = (PageID)(lastPid + delta);
+	if (op == TRACE_NEW) {
+		if (!GetVarint(count)) return FAIL;
+		event.count = (int)count;
+	}
+	if (ring) {
+		if (!GetVarint(id) || !GetVarint(size) || id == 0 || size == 0) return FAIL;
+		event.ring = (int)id;
+		event.ringSize = (int)size;
+	}
+	return OK;
+}
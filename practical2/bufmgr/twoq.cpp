@@ -0,0 +1,95 @@
+#include "../include/replacer.h"
+
+TwoQ::TwoQ( int bufSize, Frame **frames ) {
+	this->frames = frames;
+	this->numOfBuf = bufSize;
+	// The sizes suggested by Johnson and Shasha: A1in a quarter of the
+	// pool, A1out remembering half as many pages as the pool holds.
+	kin = (bufSize / 4 > 0) ? bufSize / 4 : 1;
+	a1out = new GhostLists((bufSize / 2 > 0) ? bufSize / 2 : 1, 1);
+	missInA1out = false;
+	resident = new PageID[bufSize];
+	lists = new LinkedLists(bufSize, 5);
+	for (int i = 0; i < bufSize; i++) {
+		resident[i] = frames[i]->GetPageID();
+		lists->PushBack((resident[i] == INVALID_PAGE) ? FREE : A1IN, i);
+	}
+}
+
+TwoQ::~TwoQ() {
+	delete[] resident;
+	delete lists;
+	delete a1out;
+}
+
+int TwoQ::Size(int queue) {
+	return lists->Length(queue) + lists->Length(queue + PARKED);
+}
+
+int TwoQ::OldestUnpinned(int queue) {
+	// Pinned frames met at the front are parked until they are unpinned,
+	// so each is passed over once per pin, not on every miss.
+	int i;
+	while ((i = lists->Front(queue)) >= 0 && frames[i]->GetPinCount() != 0) lists->PushBack(queue + PARKED, i);
+	return (i >= 0) ? i : INVALID_FRAME;
+}
+
+int TwoQ::PickVictim() {
+	if (lists->Length(FREE) > 0) return lists->Front(FREE);
+	int first = (Size(A1IN) > kin) ? A1IN : AM;
+	int victim = OldestUnpinned(first);
+	if (victim == INVALID_FRAME) victim = OldestUnpinned((first == A1IN) ? AM : A1IN);
+	return victim;
+}
+
+void TwoQ::PageMiss(PageID pid) {
+	int slot = a1out->Find(pid);
+	missInA1out = (slot >= 0);
+	if (missInA1out) a1out->Remove(slot);
+}
+
+void TwoQ::PageIn(int frameNo) {
+	// Only pages leaving A1in are remembered; a page dropped from Am has
+	// already had its chance.
+	if (lists->ListOf(frameNo) == A1IN && resident[frameNo] != INVALID_PAGE) {
+		a1out->Add(0, resident[frameNo]);
+	}
+	resident[frameNo] = frames[frameNo]->GetPageID();
+	lists->PushBack(missInA1out ? AM : A1IN, frameNo);
+	missInA1out = false;
+}
+
+void TwoQ::PageHit(int frameNo) {
+	if (lists->ListOf(frameNo) == AM) lists->PushBack(AM, frameNo);
+}
+
+void TwoQ::Unpinned(int frameNo) {
+	// A1in is a FIFO, so a parked frame goes back where it was, among the
+	// oldest; Am is LRU, and the page was in use until now.
+	int list = lists->ListOf(frameNo);
+	if (list == A1IN + PARKED) lists->PushFront(A1IN, frameNo);
+	else if (list == AM + PARKED) lists->PushBack(AM, frameNo);
+}
+
+void TwoQ::PageOut(int frameNo) {
+	resident[frameNo] = INVALID_PAGE;
+	lists->PushFront(FREE, frameNo);
+}
+
+void TwoQ::MoveFrame(int from, int to) {
+	lists->Replace(from, to);
+	resident[to] = resident[from];
+	PageOut(from);
+}
+
+void TwoQ::Resize(int bufSize) {
+	PageID *newResident = new PageID[bufSize];
+	for (int i = 0; i < bufSize; i++) newResident[i] = (i < numOfBuf) ? resident[i] : INVALID_PAGE;
+	delete[] resident;
+	resident = newResident;
+	lists->Resize(bufSize);
+	for (int i = numOfBuf; i < bufSize; i++) lists->PushBack(FREE, i);
+	numOfBuf = bufSize;
+	kin = (bufSize / 4 > 0) ? bufSize / 4 : 1;
+	a1out->Resize((bufSize / 2 > 0) ? bufSize / 2 : 1);
+}
@@ -2,53 +2,371 @@
 #ifndef _BUF_H
 #define _BUF_H
 
+#include <pthread.h>
+
 #include "db.h"
 #include "page.h"
 #include "frame.h"
 #include "replacer.h"
 #include "hash.h"
+#include "pagetable.h"
+#include "pagecache.h"
+#include "trace.h"
+
+/*
+ * How BufMgr::ExportStat writes the statistics.
+ */
+enum StatFormat { STAT_TEXT, STAT_JSON };
+
+#define MAX_STAT_TAGS 32   // files, and operators, that the statistics keep apart
+#define MAX_PREFETCH_RUNS 16   // runs of pages Prefetch has in flight at once at most
+
+/*
+ * Use of the buffer pool charged to one file or operator, see BufMgr::SetFileTag.
+ */
+struct AccessStat
+{
+	long numOfPins;
+	long numOfMisses;
+	long numDirtyPageWrites;   // by evictions and flushes, not by the background writer
+	double ioTime;             // seconds spent reading and writing pages for these
+};
+
+/*
+ * One partition of the buffer pool. Every page id hashes to one shard, and the shard only ever loads its pages
+ * into its own frames, every numOfShards-th frame of the pool from frame index on, so threads working on different
+ * shards share no state. latch protects everything below and the page id and dirty flag of the shard's frames; pin
+ * counts are atomic so they can be read without it. Latches are taken in shard order when more than one is held,
+ * and before any other lock of the pool except allocLock.
+ */
+struct BufShard
+{
+	pthread_mutex_t latch;
+	int index;
+	int numOfFrames;
+	Frame **frames;            // the shard's frames, numbered from 0 as its replacer sees them
+
+	/*
+	 * pageTable maps the page id of every page resident in the shard to its frame. It is kept up to date whenever
+	 * a frame is read into, evicted, freed or flushed, so FindFrame never has to scan the pool.
+	 */
+	PageTable *pageTable;
+
+	/*
+	 * The replacement policy of the shard, see replacer.h. It sees the shard's frames only, numbered from 0.
+	 */
+	Replacer *replacer;
+
+	/*
+	 * The compressed second tier for the shard's pages, NULL if there is none; see SetCompressedCacheSize.
+	 */
+	PageCache *cache;
+
+	/*
+	 * Frames being read into with the latch let go (see PinPages), which Frame::IsBeingRead tells. They are
+	 * pinned by the reader and already in the page table; anyone else who finds one waits on readDone for it.
+	 */
+	int numOfReads;
+	pthread_cond_t readDone;
+
+	/*
+	 * Dirty pages whose frames PinPages has taken, being written back with the latch let go. They are out of the
+	 * page table meanwhile, so it never holds more than one page per frame; anyone who wants one of them waits on
+	 * readDone until it is on disk.
+	 */
+	PageID *writingBack;
+	int numOfWritingBack;
+
+	long numOfPins;            // pin requests for pages of the shard
+	long numOfHits;            // ... that found the page resident
+	long numDirtyPageWrites;   // dirty pages written back by an eviction or flush
+
+	/*
+	 * The same, and I/O time, by statistics slot of the file and of the operator they were for; see
+	 * BufPool::fileTags. Dirty writes are charged to the file the page was loaded for.
+	 */
+	AccessStat fileStats[MAX_STAT_TAGS];
+	AccessStat operatorStats[MAX_STAT_TAGS];
+} __attribute__((aligned(64)));
+
+/*
+ * A run of consecutive pages BufMgr::Prefetch is reading into frames in the background.
+ */
+enum PrefetchState { PREFETCH_FREE, PREFETCH_STARTING, PREFETCH_IN_FLIGHT, PREFETCH_FINISHING };
+
+struct PrefetchRun
+{
+	PrefetchState state;       // STARTING while its frames are taken, FINISHING while a thread ends its read
+	PageID firstPid;
+	int numOfPages;
+	int frameNos[AIO_MAX_RUN];
+	AIORequest request;
+};
+
+/*
+ * Buffer manager state that does not fit in BufMgr itself (see below).
+ */
+struct BufPool
+{
+	BufShard *shards;
+	int numOfShards;           // a power of two, fixed at construction
+	int shardShift;            // 32 - log2(numOfShards), for the page id hash
+
+	/*
+	 * Serialises MINIBASE_DB->AllocatePage and DeallocatePage, which update the space map through the pool.
+	 * It is never taken with a shard latch held.
+	 */
+	pthread_mutex_t allocLock;
+
+	/*
+	 * The frames live in one array, and their pages in one aligned arena with a fixed slot per frame. Address
+	 * space for capacity frames, the most the pool may grow to, is reserved for both at construction and only
+	 * committed as the pool grows into it (see Resize), so frames never move. Frames that have been in the pool
+	 * are never destroyed.
+	 */
+	Frame *frameArray;
+	char  *arena;
+	size_t arenaSize;
+	int capacity;
+	int numOfConstructed;
+
+	/*
+	 * The runs Prefetch has in flight. Their frames are pinned by the run, in the page table and being read into
+	 * (see Frame::IsBeingRead) until the first thread to need one of them, or the next Prefetch once the read is
+	 * done, ends the run. A prefetched page is a hit when it is first pinned loaded, and wasted when it leaves the
+	 * pool unpinned. prefetchLock protects all of these, and is taken with shard latches held, never the other
+	 * way round.
+	 */
+	pthread_mutex_t prefetchLock;
+	PrefetchRun prefetchRuns[MAX_PREFETCH_RUNS];
+	int numOfPrefetching;      // pages in the runs, at most a quarter of the pool
+	long numPrefetches;
+	long numPrefetchHits;
+	long numWastedPrefetches;
+
+	/*
+	 * The background writer (see StartBackgroundWriter). writerLock goes with writerWakeUp and stopWriter;
+	 * the writer takes shard latches for the frames it writes like any other thread.
+	 */
+	pthread_mutex_t writerLock;
+	pthread_cond_t  writerWakeUp;
+	pthread_t writer;
+	bool   writerRunning;
+	bool   stopWriter;
+	double dirtyTarget;       // fraction of frames allowed to stay dirty
+	int    writerInterval;    // ms between rounds
+	long   numBackgroundWrites;  // updated by the writer only
+
+	/*
+	 * Where the resident pages are listed when the pool is destroyed, NULL for nowhere; see WarmUp.
+	 */
+	char *residentSetFile;
+
+	/*
+	 * The files, by the first page of each as the DB file directory has it, and the operators that have been
+	 * tagged, in order of their statistics slots. Slots are only ever added, under tagLock, and the counts are
+	 * published atomically, so they are looked up without it.
+	 */
+	pthread_mutex_t tagLock;
+	PageID fileTags[MAX_STAT_TAGS];
+	int numOfFileTags;
+	char *operatorTags[MAX_STAT_TAGS];
+	int numOfOperatorTags;
+
+	/*
+	 * The trace being captured, NULL if none; see StartTrace. traceLock serialises writing it, and is taken with
+	 * any other lock of the pool held, never the other way round.
+	 */
+	pthread_mutex_t traceLock;
+	TraceWriter *trace;
+};
+
+/*
+ * An access strategy for a sequential scan or a bulk load: a small private ring of frames. Pages pinned or created
+ * through a ring go into the ring's frames, which it recycles in turn once their pages are unpinned and nobody else
+ * has pinned them since, so such a pass displaces at most size pages from the shared pool. Dirty pages are written
+ * back when their frame is recycled. A ring is used by one thread at a time.
+ */
+class BufferRing
+{
+	friend class BufMgr;
+
+	private:
+
+		int id;                 // tells the rings apart in a trace
+		int size;
+		int current;            // next slot to recycle
+		int *frameNos;          // per slot: frame the ring loaded a page into, INVALID_FRAME if none
+		PageID *pids;           // per slot: the page it loaded there
+		unsigned long *stamps;  // per slot: the frame's pin stamp when the ring last pinned it
+
+	public:
+
+		BufferRing( int size );
+		~BufferRing();
+};
+
+/*
+ * A read of a resident page that leaves its pin count alone, see BufMgr::BeginOptimisticRead. A caller that keeps one
+ * across reads of the same page lets the next read skip the page table as long as the frame has not changed.
+ */
+class OptimisticRead
+{
+	friend class BufMgr;
+
+	private:
+
+		PageID pid;
+		int frameNo;
+		unsigned long version;  // of the frame when the page was found there
+
+	public:
+
+		OptimisticRead() : pid(INVALID_PAGE), frameNo(INVALID_FRAME), version(0) {}
+};
+
+class BufMgr;
+
+/*
+ * A pin on a page that lets itself go: the page is unpinned, dirty if MarkDirty was called, when the guard goes out
+ * of scope, is released, or is pinned or created onto another page. It remembers the frame, so unpinning does not
+ * look the page up again. Guards can be moved but not copied.
+ */
+class PageGuard
+{
+	friend class BufMgr;
+
+	protected:
+
+		BufMgr *bufMgr;
+		PageID pid;
+		int frameNo;
+		Page *page;
+		Bool dirty;
+
+	public:
+
+		PageGuard() : bufMgr(NULL), pid(INVALID_PAGE), frameNo(INVALID_FRAME), page(NULL), dirty(FALSE) {}
+		PageGuard( PageGuard&& other );
+		PageGuard& operator=( PageGuard&& other );
+		PageGuard( const PageGuard& ) = delete;
+		PageGuard& operator=( const PageGuard& ) = delete;
+		~PageGuard() { Release(); }
+
+		Status Release();
+		void   MarkDirty() { dirty = TRUE; }
+		Bool   IsPinned() const { return page != NULL; }
+		PageID GetPageID() const { return pid; }
+		Page  *GetPage() const { return page; }
+};
+
+/*
+ * Charges the calling thread's use of the buffer pool to a file and an operator for as long as it is in scope, then
+ * gives the thread its previous tags back; see BufMgr::SetFileTag. INVALID_PAGE or NULL leave a tag as it was.
+ */
+class StatScope
+{
+	private:
+
+		int file;          // the thread's statistics slots before
+		int op;
+
+	public:
+
+		StatScope( PageID firstPid, const char *opName = NULL );
+		~StatScope();
+		StatScope( const StatScope& ) = delete;
+		StatScope& operator=( const StatScope& ) = delete;
+};
+
+/*
+ * A PageGuard that reads its page as a T, e.g. a HeapPage or DirPage.
+ */
+template <class T>
+class PinnedPage : public PageGuard
+{
+	public:
+
+		T *operator->() const { return (T *)page; }
+		T *Get() const { return (T *)page; }
+};
 
 class BufMgr 
 {
+	friend class PageGuard;
+	friend class StatScope;
+
 	private:
 
 		/*
-		 * hashTable to give hash access to frames. No obligation to use it, however if you want to use it you need
-		 * define and implement the HashTable.cpp file
+		 * SystemDefs (lib/libglobaldefs.a) constructs the buffer manager in a block of 56 bytes, the
+		 * size this class had when that library was compiled, so any new state has to go into BufPool.
+		 * The replacers and the statistics live in the shards.
 		 */
-		//HashTable *hashTable;
+		BufPool *pool;
 		Frame **frames; //pool of frames
-
-		/*
-		 * This is the component responsible of implementing the buffer replacement policy. You need to create the Replacer.cpp
-		 * file and define there your chose replacement policy
-		 */
-		Replacer *replacer;
 		int   numOfBuf; // number of buffers
 
 		int FindFrame( PageID pid );
-		long totalCall; //total number of times that upper layers try to pin a page
-		long totalHit; //total number of times that upper layers try to pin a page and the page is already in the buffer
-		long numDirtyPageWrites; //total number of times that a page has been modified and written back to disk
+		int PinFrame( PageID pid, Bool isEmpty, BufferRing *ring );
+		Status UnpinFrame( PageID pid, int frameNo, Bool dirty );
+		int PickVictim( BufShard *shard, BufferRing *ring, int& slot );
+		int PrefetchFrame( PageID pid, BufferRing *ring, Bool& loaded );
+		void Init( int bufSize, int maxBufSize );
+		void WriteBehind();
+		static void *BackgroundWriter( void *bufMgr );
 
 	public:
 
 		BufMgr( int bufsize );
+		BufMgr( int bufSize, int maxBufSize );
 		~BufMgr();      
 		Status PinPage( PageID pid, Page*& page, Bool emptyPage=FALSE );
+		Status PinPage( PageID pid, Page*& page, Bool emptyPage, BufferRing *ring );
+		Status PinPage( PageID pid, PageGuard& guard, Bool emptyPage=FALSE, BufferRing *ring=NULL );
+		Status PinPages( const PageID *pids, int n, Page **pages );
 		Status UnpinPage( PageID pid, Bool dirty=FALSE );
 		Status NewPage( PageID& pid, Page*& firstpage,int howmany=1 ); 
+		Status NewPage( PageID& pid, Page*& firstpage, int howmany, BufferRing *ring );
+		Status NewPage( PageID& pid, PageGuard& guard, int howmany=1, BufferRing *ring=NULL );
+		Status NewExtent( PageID& firstPid, Page **pages, int howMany, BufferRing *ring=NULL, PageID near=INVALID_PAGE );
 		Status FreePage( PageID pid ); 
+		Status FreePage( PageGuard& guard );
 		Status FlushPage( PageID pid );
 		Status FlushAllPages();
-		Status  GetStat(long& pinNo, long& missNo) { pinNo = totalCall; missNo = totalCall-totalHit; return OK;}
+		Status BeginOptimisticRead( PageID pid, Page*& page, OptimisticRead& read );
+		Bool   EndOptimisticRead( const OptimisticRead& read );
+		Status CopyPage( PageID pid, Page *copy );
+		Status SetReplacementPolicy(const char *policy);
+		Status Resize( int bufSize );
+		Status SetCompressedCacheSize( size_t bytes );
+		int    Prefetch( const PageID *pids, int n, BufferRing *ring=NULL );
+		Status StartBackgroundWriter( double dirtyRatio=0.1, int interval=10 );
+		Status StopBackgroundWriter();
+		Status DumpResidentPages( const char *filename );
+		Status StartTrace( const char *filename );
+		Status StopTrace();
+		int    WarmUp( const char *filename );
+		Status  GetStat(long& pinNo, long& missNo);
+		Status  GetWriteStat(long& foregroundNo, long& backgroundNo);
+		Status  GetPrefetchStat(long& prefetchNo, long& hitNo, long& wastedNo);
+		Status  GetCompressedCacheStat(long& lookupNo, long& hitNo, long& pageNo, long& byteNo);
+		Status  SetFileTag(PageID firstPid);
+		Status  SetFileTag(const char *fileName);
+		Status  SetOperatorTag(const char *opName);
+		PageID  GetFileTag();
+		const char *GetOperatorTag();
+		Status  GetFileStat(PageID firstPid, AccessStat& stat);
+		Status  GetOperatorStat(const char *opName, AccessStat& stat);
 
 		unsigned int GetNumOfUnpinnedFrames();
 
 		unsigned int GetNumOfBuffers();
+		unsigned int GetNumOfUnpinnedBuffers();
 
 		void   PrintStat();
-		void   ResetStat() { totalHit = 0; totalCall = 0; numDirtyPageWrites = 0;}
+		Status ExportStat(ostream& out, StatFormat format=STAT_TEXT);
+		void   ResetStat();
 };
 
 
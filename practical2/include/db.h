@@ -10,6 +10,7 @@
 #include <stdlib.h>
 
 #include "page.h"
+#include "aio.h"
 
 // Each database is basically a UNIX file and consists of several relations
 // (viewed as heapfiles and their indexes) within it.
@@ -30,6 +31,7 @@ enum dbErrCodes {
     FILE_NOT_FOUND,
     FILE_NAME_TOO_LONG,
     NEG_RUN_SIZE,
+    AIO_ENGINE_IN_USE,
 };
 
 // oooooooooooooooooooooooooooooooooooooo
@@ -54,13 +56,60 @@ class DB {
     // Read the contents of the specified page into the given memory area.
     Status ReadPage(PageID pageno, Page* pageptr);
 
+    // Read a run of consecutive pages, starting at start_page_num, into
+    // pageptrs[0..run_size-1].
+    Status ReadPages(PageID start_page_num, Page** pageptrs, int run_size);
+
     // Write the contents of the specified page.
     Status WritePage(PageID pageno, Page* pageptr);
 
+    // Write a run of consecutive pages, starting at start_page_num, whose
+    // contents are at pageptrs[0..run_size-1].
+    Status WritePages(PageID start_page_num, Page** pageptrs, int run_size);
+
+    // Tell the OS that a run of pages will be read soon, so it can start
+    // reading them in the background. Returns without waiting.
+    Status PrefetchPages(PageID start_page_num, int run_size = 1);
+
+    // Start reading a run of at most AIO_MAX_RUN consecutive pages into
+    // pageptrs[0..run_size-1] in the background, and return at once.
+    // Many runs can be in flight at once; the pages are there once
+    // WaitIO has returned OK for the request.
+    Status SubmitReadPages(PageID start_page_num, Page** pageptrs,
+                           int run_size, AIORequest& request);
+
+    // Start writing a run of at most AIO_MAX_RUN consecutive pages in
+    // the background. The pages must not change until WaitIO returns.
+    Status SubmitWritePages(PageID start_page_num, Page** pageptrs,
+                            int run_size, AIORequest& request);
+
+    // Wait for a submitted read or write to be done; FAIL if it could
+    // not be submitted or failed.
+    Status WaitIO(AIORequest& request);
+
+    // Choose what does the background I/O: "io_uring", "threads" for a
+    // pool of worker threads, or "sync" to do each request as it is
+    // submitted. By default it is io_uring if the kernel has it and
+    // the worker threads otherwise. Only when nothing is in flight.
+    // There is one engine for the process, taken by the first database
+    // to submit or choose one, and kept until that database is closed.
+    // Meanwhile every other database does its requests as they are
+    // submitted, reports "sync" from GetAsyncIO, and gets FAIL, with
+    // AIO_ENGINE_IN_USE posted, from SetAsyncIO. Deleting SystemDefs
+    // does not close its database, so the databases of any SystemDefs
+    // made after the first in a process do synchronous I/O.
+    Status SetAsyncIO(const char* engine);
+    const char* GetAsyncIO();
+
     // Allocate a set of pages where the run size is taken to be 1 by default.
-    // Gives back the page number of the first page of the allocated run.
+    // Gives back the page number of the first page of the allocated run,
+    // looking from where the previous allocation ended (next-fit).
     Status AllocatePage(PageID& start_page_num, int run_size = 1);
 
+    // Allocate a run of pages as close after the page near as there is
+    // room, to keep the pages of a file together.
+    Status AllocatePage(PageID& start_page_num, int run_size, PageID near);
+
     // Deallocate a set of pages starting at the specified page number and
     // a run size can be specified.
     Status DeallocatePage(PageID start_page_num, int run_size = 1);
@@ -77,6 +126,9 @@ class DB {
     // Get the entry corresponding to the given file.
     Status GetFileEntry(const char* name, PageID& start_pg);
 
+    // Get the name of the file that starts at the given page.
+    Status GetFileName(PageID start_pg, char* name);
+
     // Functions to return some characteristics of the database.
     const char* GetName() const;
     int GetNumOfPages() const;
@@ -131,8 +183,20 @@ class DB {
       // Set runsize bits starting from start to value specified
     Status set_bits( PageID start, unsigned runsize, int bit );
 
+      // Read the space map into the in-memory free-extent tree, unless
+      // it is there already.
+    Status build_extent_tree();
+
       // Initializes the given directory page to contain no entries.
     void init_dir_page( directory_page* dp, unsigned used_bytes );
+
+      // Read the directory from the header pages into the in-memory
+      // hash of file names, and take the lock that guards that.
+    Status load_directory();
+    Status lock_directory( int write );
+
+      // AddFileEntry, with that lock held.
+    Status add_file_entry( const char* fname, PageID start_page_num );
 };
 
 // oooooooooooooooooooooooooooooooooooooo
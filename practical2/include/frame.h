@@ -1,38 +1,56 @@
 #ifndef FRAME_H
 #define FRAME_H
 
-#include <sys/time.h>
-
 #include "page.h"
 
 #define INVALID_FRAME -1
 
+class PageCache;
+
 class Frame 
 {
 	private :
 	
 		PageID pid;
 		Page   *data;
-		int    pinCount;
+		int    pinCount; // only changed atomically, so it can be read without the shard latch
 		int    dirty;
-		timespec timestamp;
+		unsigned long timestamp; // advanced on every pin of this frame
+		int    uses;             // pins since the page was loaded
+		unsigned long version;   // even unless Read is filling the frame; advances on any change of its page or contents
+		int    fileTag;          // statistics slot of the file the page was loaded for, -1 if none
+		int    prefetched;       // the page was read ahead by BufMgr::Prefetch and nobody has pinned it since
 
 	public :
 		
 		Frame();
 		~Frame();
 		void Pin();
-		void Unpin();
+		int Unpin();
 		void EmptyIt();
+		void SetPage(Page *page);
 		void DirtyIt();
 		void SetPageID(PageID pid);
 		Bool IsDirty();
 		Status Write();
-		Status Read(PageID pid);
+		Status Read(PageID pid, PageCache *cache = NULL);
+		// Read in two halves, for reading many frames at once: TRUE if the cache had the page, otherwise the
+		// caller reads it into GetPage() itself and then calls EndRead with how that went.
+		Bool BeginRead(PageID pid, PageCache *cache);
+		void EndRead(PageID pid, Status status);
+		// Move the page of another frame, unpinned, into this empty one, leaving the other empty.
+		void TakeOver(Frame *from);
+		Bool IsBeingRead();
+		void SetPrefetched(Bool prefetched);
+		Bool IsPrefetched();
 		PageID GetPageID();
 		Page *GetPage();
 		int GetPinCount();
-		long GetTimeStamp();
+		unsigned long GetTimeStamp();
+		int GetUsageCount();
+		unsigned long GetVersion();
+		void SetFileTag(int tag);
+		int GetFileTag();
 };
 
 #endif
@@ -81,6 +81,19 @@ public:
 #define NEWPAGE(a, b)  if (MINIBASE_BM->NewPage((a), (Page *&)(b)) != OK) {\
 						cerr << "Unable to allocate new page " << a << endl; return FAIL;}
 
+// The same with a PageGuard or PinnedPage b, which unpins its page by
+// itself on any way out of the function.
+#define PIN_GUARD(a, b)   if (MINIBASE_BM->PinPage((a), (b)) != OK) {\
+						cerr << "Unable to pin page " << a << endl; return FAIL;}
+#define UNPIN_GUARD(b, d) do { PageID pid_ = (b).GetPageID(); if (d) (b).MarkDirty();\
+						if ((b).Release() != OK) {\
+						cerr << "Unable to unpin page " << pid_ << endl; return FAIL;} } while (0)
+#define FREEPAGE_GUARD(b) do { PageID pid_ = (b).GetPageID();\
+						if (MINIBASE_BM->FreePage((b)) != OK) {\
+						cerr << "Unable to free page " << pid_ << endl; return FAIL;} } while (0)
+#define NEWPAGE_GUARD(a, b) if (MINIBASE_BM->NewPage((a), (b)) != OK) {\
+						cerr << "Unable to allocate new page " << a << endl; return FAIL;}
+
 #define DIRTY TRUE
 #define CLEAN FALSE
 
@@ -0,0 +1,46 @@
+#ifndef _PAGETABLE_H
+#define _PAGETABLE_H
+
+#include "page.h"
+
+/**
+ * Open-addressing map from page id to frame number, used by the buffer
+ * manager to find the frame holding a page in O(1).
+ *
+ * The table is sized to a power of two at least twice the most entries its
+ * owner says it will hold, one per frame for the buffer manager, so it is
+ * never more than half full and probe sequences stay short. Insert asserts
+ * that the owner keeps to that, and no probe goes more than once around the
+ * table. Collisions are resolved by linear probing, and deletions shift
+ * later entries back into the hole, so there are no tombstones to clean up.
+ */
+class PageTable
+{
+	private :
+
+		struct Entry
+		{
+			PageID pid;
+			int    frameNo;
+		};
+
+		Entry *entries;
+		unsigned int mask; // capacity - 1
+		int shift;         // 32 - log2(capacity)
+		int numOfEntries;
+		int maxEntries;
+
+		unsigned int Slot(PageID pid);
+
+	public :
+
+		PageTable( int maxEntries );
+		~PageTable();
+
+		void Insert(PageID pid, int frameNo);
+		Status Delete(PageID pid);
+		int LookUp(PageID pid);
+		void EmptyIt();
+};
+
+#endif
@@ -10,9 +10,24 @@
 #include "minirel.h"
 #include "dirpage.h"
 #include "heappage.h"
+#include "bufmgr.h"
 
 class HeapFile;
 class HeapPage;
+class BufferRing;
+
+// A scan reads its first quarter of the buffer pool's worth of data
+// pages through the shared pool, then switches to a private ring of
+// this many frames so a large file cannot flush everything else.
+#define SCAN_RING_SIZE 8
+
+// Read-ahead window, in data pages. It starts at READ_AHEAD_INIT,
+// doubles while most pins of the scan find the page read ahead for
+// them loaded, and halves when few do or a page read ahead is evicted
+// before it is pinned. Through a ring it stays within half the ring.
+#define READ_AHEAD_MIN  2
+#define READ_AHEAD_INIT 8
+#define READ_AHEAD_MAX  64
 
 class Scan
 {
@@ -26,17 +41,29 @@ public:
 
 private:
 
+	Status PinCurrPage();
+	void ReadAhead();
+
 	PageID currDirPid;
 	PageID firstDirPid;
-	DirPage *dirPage;
+	PinnedPage<DirPage> dirPage;   // pinned while the scan is on it
 	int currEntry;
 
 	PageID currPid;
-	HeapPage *page;
+	PinnedPage<HeapPage> page;     // likewise
 
 	RecordID currRid;
 
 	Bool noMore;
+
+	int numOfPagesRead;
+	BufferRing *ring;
+
+	int readAhead;      // current read-ahead window
+	int prefetchEntry;  // first entry of dirPage not prefetched yet
+	int readAtWindow;   // numOfPagesRead when the last window was issued
+	long prefetchHits;  // the buffer pool's prefetch hits and wasted
+	long prefetchWaste; // prefetches then
 };
 
 #endif
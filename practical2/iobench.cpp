@@ -0,0 +1,211 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <iostream>
+
+using namespace std;
+
+#include "include/bufmgr.h"
+#include "include/db.h"
+
+int MINIBASE_RESTART_FLAG = 0;
+
+#define BENCH_DB "iobench.minibase-db"
+#define BENCH_LOG "iobench.minibase-log"
+
+#define IO_NUM_PAGES 16384
+#define IO_NUM_READS 4096
+#define IO_MAX_DEPTH 64
+
+#define PIN_BUF_SIZE 1024
+#define PIN_BLOCK_SIZE 256
+#define PIN_NUM_BLOCKS 16
+
+static const char *engines[] = { "sync", "threads", "io_uring" };
+#define NUM_ENGINES 3
+
+static double Elapsed(const struct timeval& initTime)
+{
+	struct timeval endTime;
+	gettimeofday(&endTime, NULL);
+	return (endTime.tv_sec - initTime.tv_sec) * 1e3 + (endTime.tv_usec - initTime.tv_usec) / 1e3;
+}
+
+// Push the database file out of the OS cache, so that the reads that
+// follow go to the device.
+static void DropCache()
+{
+	int fd = open(BENCH_DB, O_RDONLY);
+	if (fd < 0) return;
+	fsync(fd);
+#ifdef POSIX_FADV_DONTNEED
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+	close(fd);
+}
+
+// Page ids of the database's data pages in a random order.
+static void Shuffle(PageID *pids, int n, PageID firstPid, unsigned int seed)
+{
+	for (int i = 0; i < n; i++) pids[i] = firstPid + i;
+	for (int i = n - 1; i > 0; i--) {
+		seed = seed * 1103515245 + 12345;
+		int j = (seed >> 8) % (i + 1);
+		PageID t = pids[i]; pids[i] = pids[j]; pids[j] = t;
+	}
+}
+
+//--------------------------------------------------------------------
+// BenchDepth
+//
+// Input    : pids  - IO_NUM_READS random data pages
+//            depth - number of reads kept in flight
+// Purpose  : Read single random pages with DB::SubmitReadPages, from
+//            a cold cache, keeping depth reads in flight: each time the
+//            oldest is done another is submitted in its place. Each
+//            page holds its own page id, which is checked.
+// Return   : OK if the benchmark ran, FAIL otherwise.
+//--------------------------------------------------------------------
+
+static Status BenchDepth(const PageID *pids, int depth)
+{
+	Page *buffers = new Page[depth];
+	AIORequest *requests = new AIORequest[depth];
+	Status status = OK;
+
+	DropCache();
+	struct timeval initTime;
+	gettimeofday(&initTime, NULL);
+	for (int i = 0; i < IO_NUM_READS + depth; i++) {
+		int slot = i % depth;
+		if (i >= depth) {
+			PageID data;
+			if (MINIBASE_DB->WaitIO(requests[slot]) != OK) status = FAIL;
+			memcpy(&data, &buffers[slot], sizeof(PageID));
+			if (data != pids[i - depth]) status = FAIL;
+		}
+		if (i < IO_NUM_READS) {
+			Page *page = &buffers[slot];
+			MINIBASE_DB->SubmitReadPages(pids[i], &page, 1, requests[slot]);
+		}
+	}
+	double msecs = Elapsed(initTime);
+
+	printf("%10.0f", IO_NUM_READS / (msecs / 1e3));
+	fflush(stdout);
+	delete[] requests;
+	delete[] buffers;
+	return status;
+}
+
+//--------------------------------------------------------------------
+// BenchPinPages
+//
+// Input    : firstPid - the first data page
+// Purpose  : Pin PIN_NUM_BLOCKS blocks of PIN_BLOCK_SIZE random pages
+//            with BufMgr::PinPages, from a cold cache, each block in a
+//            pool emptied by FlushAllPages, so every pin is a read and
+//            hardly any two are of consecutive pages.
+// Return   : OK if the benchmark ran, FAIL otherwise.
+//--------------------------------------------------------------------
+
+static Status BenchPinPages(PageID firstPid)
+{
+	PageID *order = new PageID[IO_NUM_PAGES];
+	Shuffle(order, IO_NUM_PAGES, firstPid, 54321);
+	Page *pages[PIN_BLOCK_SIZE];
+	Status status = MINIBASE_BM->FlushAllPages();
+
+	DropCache();
+	struct timeval initTime;
+	gettimeofday(&initTime, NULL);
+	for (int block = 0; status == OK && block < PIN_NUM_BLOCKS; block++) {
+		PageID *pids = &order[block * PIN_BLOCK_SIZE];
+		status = MINIBASE_BM->PinPages(pids, PIN_BLOCK_SIZE, pages);
+		for (int i = 0; status == OK && i < PIN_BLOCK_SIZE; i++) {
+			PageID data;
+			memcpy(&data, pages[i], sizeof(PageID));
+			if (data != pids[i]) status = FAIL;
+			if (MINIBASE_BM->UnpinPage(pids[i]) != OK) status = FAIL;
+		}
+		if (status == OK) status = MINIBASE_BM->FlushAllPages();
+	}
+	double msecs = Elapsed(initTime);
+
+	cout << "  - " << MINIBASE_DB->GetAsyncIO() << ": " << msecs << "ms\n";
+	delete[] order;
+	return status;
+}
+
+int main (int argc, char **argv)
+{
+	Status status;
+	minibase_globals = new SystemDefs(status, BENCH_DB, BENCH_LOG,
+		IO_NUM_PAGES + 64, 500, PIN_BUF_SIZE, "Clock");
+	if (status != OK) {
+		minibase_errors.show_errors();
+		return 1;
+	}
+
+	// Fill the pages with their own page ids and write them all out.
+	PageID firstPid;
+	Page *pg;
+	status = MINIBASE_BM->NewPage(firstPid, pg, IO_NUM_PAGES);
+	if (status == OK) status = MINIBASE_BM->UnpinPage(firstPid);
+	for (int i = 0; status == OK && i < IO_NUM_PAGES; i++) {
+		PageID pid = firstPid + i;
+		status = MINIBASE_BM->PinPage(pid, pg, true);
+		if (status == OK) {
+			memcpy((char *)pg, &pid, sizeof(PageID));
+			status = MINIBASE_BM->UnpinPage(pid, true);
+		}
+	}
+	if (status == OK) status = MINIBASE_BM->FlushAllPages();
+
+	PageID *pids = new PageID[IO_NUM_PAGES];
+	Shuffle(pids, IO_NUM_PAGES, firstPid, 12345);
+	bool available[NUM_ENGINES];
+
+	cout << "\n  Random single page reads per second against I/O depth, " << IO_NUM_READS << " reads each:\n";
+	printf("%10s", "depth");
+	for (int e = 0; e < NUM_ENGINES; e++) {
+		available[e] = (MINIBASE_DB->SetAsyncIO(engines[e]) == OK);
+		printf("%10s", engines[e]);
+	}
+	printf("\n");
+	for (int depth = 1; status == OK && depth <= IO_MAX_DEPTH; depth *= 2) {
+		printf("%10d", depth);
+		for (int e = 0; status == OK && e < NUM_ENGINES; e++) {
+			// Without an engine, every request is done as it is
+			// submitted, so there is only depth 1.
+			if (!available[e] || (e == 0 && depth > 1)) {
+				printf("%10s", "-");
+				continue;
+			}
+			MINIBASE_DB->SetAsyncIO(engines[e]);
+			status = BenchDepth(pids, depth);
+		}
+		printf("\n");
+	}
+
+	cout << "\n  PinPages of " << PIN_NUM_BLOCKS << " blocks of " << PIN_BLOCK_SIZE << " random pages:\n";
+	for (int e = 0; status == OK && e < NUM_ENGINES; e++) {
+		if (!available[e]) continue;
+		MINIBASE_DB->SetAsyncIO(engines[e]);
+		status = BenchPinPages(firstPid);
+	}
+
+	if (status != OK) {
+		cerr << "*** Benchmark failed\n";
+		minibase_errors.show_errors();
+	}
+	delete[] pids;
+	delete minibase_globals;
+	minibase_globals = 0;
+	remove(BENCH_DB);
+	remove(BENCH_LOG);
+	return status == OK ? 0 : 1;
+}
@@ -67,6 +67,21 @@ int TestDriver::Test6()
     return true;
 }
 
+int TestDriver::Test7()
+{
+    return true;
+}
+
+int TestDriver::Test8()
+{
+    return true;
+}
+
+int TestDriver::Test9()
+{
+    return true;
+}
+
 
 const char* TestDriver::TestName()
 {
@@ -187,14 +202,13 @@ Status TestDriver::RunAllTests()
 	const int inTxtLen = 32;
 	char *inputTxt = new char[inTxtLen];
 
-	//there are really 6 tests but the last one doesn't do anything so I'll only mention 1-5
 	cout << "Input a space separated test sequance (ie. a list of numbers " << endl <<
-		" in the range 1-5: 1 5 2 3) or hit ENTER to run all tests: ";
+		" in the range 1-9: 1 5 2 3) or hit ENTER to run all tests: ";
 
 	cin.getline ( inputTxt, inTxtLen );
 	if ( strlen(inputTxt) == 0 )
 	{
-		inputTxt = "12345";
+		inputTxt = "123456789";
 	}	
 	for ( i = 0; i < (int)strlen(inputTxt); i++)
 	{
@@ -272,6 +286,48 @@ Status TestDriver::RunAllTests()
 				minibase_errors.show_errors(cerr);
 			}
 
+			minibase_errors.clear_errors();
+			break;
+		case '7' :
+			minibase_errors.clear_errors();
+			result = Test7();
+			if ( !result || minibase_errors.error() )
+			{
+				status = FAIL;
+				if ( minibase_errors.error() )
+					cerr << (result? "*** Unexpected error(s) logged, test failed:\n"
+					: "Errors logged:\n");
+				minibase_errors.show_errors(cerr);
+			}
+
+			minibase_errors.clear_errors();
+			break;
+		case '8' :
+			minibase_errors.clear_errors();
+			result = Test8();
+			if ( !result || minibase_errors.error() )
+			{
+				status = FAIL;
+				if ( minibase_errors.error() )
+					cerr << (result? "*** Unexpected error(s) logged, test failed:\n"
+					: "Errors logged:\n");
+				minibase_errors.show_errors(cerr);
+			}
+
+			minibase_errors.clear_errors();
+			break;
+		case '9' :
+			minibase_errors.clear_errors();
+			result = Test9();
+			if ( !result || minibase_errors.error() )
+			{
+				status = FAIL;
+				if ( minibase_errors.error() )
+					cerr << (result? "*** Unexpected error(s) logged, test failed:\n"
+					: "Errors logged:\n");
+				minibase_errors.show_errors(cerr);
+			}
+
 			minibase_errors.clear_errors();
 			break;
 		}
@@ -24,6 +24,9 @@ class BMTester : public TestDriver
 		int Test4();
 		int Test5();
 		int Test6();
+		int Test7();
+		int Test8();
+		int Test9();
 		const char* TestName();
 		void RunTest( Status& status, testFunction test );
 		Status RunAllTests();
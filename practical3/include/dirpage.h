@@ -22,8 +22,10 @@ private :
 	PageID curr;
 	PageID next;
 	PageID prev;
+	PageID firstSpare;   // head page only: the data pages the file has
+	int numOfSpares;     // allocated but not put in the directory yet
 
-	#define DIR_PAGE_SIZE (MAX_SPACE - 2*sizeof(int) - 3*sizeof(PageID))
+	#define DIR_PAGE_SIZE (MAX_SPACE - 3*sizeof(int) - 4*sizeof(PageID))
 
 	char data[DIR_PAGE_SIZE];
 
@@ -38,6 +40,8 @@ public :
 	Status DeleteRecordFromPage (PageID pid, HeapPage *page);
 	void   SetNextPage (PageID pid) { next = pid; }
 	void   SetPrevPage (PageID pid) { prev = pid; }
+	void   SetSpares (PageID pid, int n) { firstSpare = pid; numOfSpares = n; }
+	PageID GetSpares (int& n) { n = numOfSpares; return firstSpare; }
 	PageID GetNextPage();
 	PageInfo *GetEntry(int entry);
 	Bool HasFreeSpace();
@@ -0,0 +1,52 @@
+#ifndef _LATENCY_H
+#define _LATENCY_H
+
+#include <time.h>
+
+#define LATENCY_BUCKETS 40   // bucket b counts latencies of [2^b, 2^(b+1)) ns, the last also anything longer
+
+/*
+ * The operations whose latency is recorded.
+ */
+enum LatencyOp
+{
+	PIN_PAGE_LATENCY,     // BufMgr::PinPage, hit or miss
+	READ_PAGE_LATENCY,    // DB::ReadPage
+	WRITE_PAGE_LATENCY,   // DB::WritePage
+	NUM_LATENCY_OPS
+};
+
+/**
+ * A log-bucketed latency histogram, accurate to within a factor of two. Each thread records into histograms of its
+ * own without atomic read-modify-writes or locks; GetLatencyHistogram merges those of all threads, including ones
+ * that have exited, so reading is the only thing that costs.
+ */
+class LatencyHistogram
+{
+	public :
+
+		long counts[LATENCY_BUCKETS];
+		long numOfCalls;
+		long totalNs;
+		long maxNs;
+
+		LatencyHistogram() { Clear(); }
+		void Clear();
+		long Percentile(double p) const;   // estimated latency in ns that a fraction p of the calls did not exceed
+		long Mean() const;
+};
+
+// Nanoseconds on a monotonic clock, for timing with RecordLatency.
+static inline long LatencyClock()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+void RecordLatency(LatencyOp op, long startNs);   // the call that began at startNs has just finished
+void GetLatencyHistogram(LatencyOp op, LatencyHistogram& histogram);   // since the last reset
+void ResetLatencyHistograms();
+const char *LatencyOpName(LatencyOp op);
+
+#endif
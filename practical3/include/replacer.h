@@ -1,5 +1,9 @@
+#ifndef _REPLACER_H
+#define _REPLACER_H
+
 #include "frame.h"
 #include "hash.h"
+#include "pagetable.h"
 
 /**
  * Class to implement the buffer replacement policy.
@@ -10,29 +14,271 @@
  * Here we have defined a Clock replacer which should implement the clock replacement policy. Feel free to modify this interface,
  * or add any other replacement policy as you like
  *
+ * The buffer manager reports what happens to each frame through the Page* and Unpinned hooks, so a policy can keep
+ * whatever per-frame state it needs. PickVictim is only called on a miss, right after PageMiss has named the page that
+ * is wanted, and the frame it returns is then reported through PageIn. When the pool is resized, pages move between
+ * frames through MoveFrame and the replacer learns the new number of frames through Resize, keeping its history.
  */
 class Replacer 
 {
 	public :
 
 		Replacer();
-		~Replacer();
+		virtual ~Replacer();
 
 		virtual int PickVictim() = 0;
+
+		virtual void PageMiss(PageID pid) {}  // pid is not in the pool and is about to be loaded
+		virtual void PageIn(int frameNo) {}   // a page has just been loaded into the frame
+		virtual void PageHit(int frameNo) {}  // a page already in the frame has been pinned again
+		virtual void Unpinned(int frameNo) {} // the pin count of the frame has dropped to zero
+		virtual void PageOut(int frameNo) {}  // the frame has been emptied by a flush or a free
+
+		// The page in frame from, unpinned, has moved to the empty frame to, which takes over what the replacer knew
+		// about it; from is left empty as after PageOut.
+		virtual void MoveFrame(int from, int to) = 0;
+		// The pool now has bufSize frames. Frames that went were empty; frames that came are empty.
+		virtual void Resize(int bufSize) = 0;
+
+		// Creates the replacer named by policy ("Clock", "GClock", "LRU", "LRUK", "2Q" or "ARC"), NULL if there is none.
+		static Replacer *Create(const char *policy, int bufSize, Frame **frames);
+};
+
+/**
+ * A set of doubly linked lists threaded through one array of links, one per element 0..size-1, so elements move
+ * between lists in O(1) without allocating. An element is on at most one list at a time.
+ */
+class LinkedLists
+{
+	private :
+
+		struct Link
+		{
+			int prev;
+			int next;
+		};
+
+		int size;
+		Link *links;  // links[size + l] is the head of list l
+		int *listOf;  // per element: the list it is on, -1 if none
+		int *lengths;
+		int numOfLists;
+
+	public :
+
+		LinkedLists( int size, int numOfLists );
+		~LinkedLists();
+		void PushFront(int list, int i);
+		void PushBack(int list, int i);
+		void Remove(int i);
+		void Replace(int i, int j); // j takes the place of i on its list, leaving i on none
+		void Resize(int size);      // elements from size on leave their lists, the others keep their order
+		int Front(int list);    // first element, -1 if the list is empty
+		int Next(int i);        // element after i on its list, -1 at the end
+		int ListOf(int i);
+		int Length(int list);
+};
+
+/**
+ * Page ids of pages evicted from the pool, for policies that keep history beyond it. Ghosts sit on numOfLists lists,
+ * oldest first, sharing a fixed number of slots, and are found by page id through a PageTable. Each ghost carries a
+ * stamp for the policy's own use.
+ */
+class GhostLists
+{
+	private :
+
+		int capacity;
+		PageID *pids;
+		unsigned long *stamps;
+		int numOfLists;
+		LinkedLists *lists; // list numOfLists holds the unused slots
+		PageTable *index;
+
+	public :
+
+		GhostLists( int capacity, int numOfLists );
+		~GhostLists();
+		int Find(PageID pid);        // slot holding pid, -1 if none
+		int ListOf(int slot);
+		unsigned long GetStamp(int slot);
+		void Add(int list, PageID pid, unsigned long stamp = 0); // evicts the oldest ghost of list when full
+		void Remove(int slot);
+		void RemoveOldest(int list);
+		int Length(int list);
+		void Resize(int capacity);   // forgets the oldest ghosts of the longest lists if there are too many
 };
 
+/**
+ * CLOCK with usage counters (GCLOCK). Loading or pinning a page raises its frame's usage count up to maxUsage, and the
+ * hand decrements the count of each unpinned frame it passes, evicting the first one it finds at zero. With maxUsage 1
+ * this is the classic second-chance algorithm.
+ */
 class Clock : public Replacer
 {
 	private :
 		
 		int current;
 		int numOfBuf;
+		int maxUsage;
+		int *usage;
 		Frame **frames;
-		HashTable *hashTable;
 
 	public :
 		
-		Clock( int bufSize, Frame **frames, HashTable *hashTable );
+		Clock( int bufSize, Frame **frames, int maxUsage = 1 );
 		~Clock();
 		int PickVictim();
+		void PageIn(int frameNo);
+		void PageHit(int frameNo);
+		void PageOut(int frameNo);
+		void MoveFrame(int from, int to);
+		void Resize(int bufSize);
+};
+
+/**
+ * Least recently used. Unpinned frames are kept on a doubly linked list threaded through per-frame links, in the order
+ * their pin counts last dropped to zero, with empty frames at the front. Unpinning appends to the back and pinning
+ * unlinks, so the victim is always the head of the list and every operation is O(1).
+ */
+class LRU : public Replacer
+{
+	private :
+
+		int numOfBuf;
+		Frame **frames;
+		LinkedLists *lists; // list 0 is the unpinned frames, least recently used first
+
+	public :
+		LRU( int bufSize, Frame **frames );
+		~LRU();
+		int PickVictim();
+		void PageIn(int frameNo);
+		void PageHit(int frameNo);
+		void Unpinned(int frameNo);
+		void PageOut(int frameNo);
+		void MoveFrame(int from, int to);
+		void Resize(int bufSize);
+};
+
+/**
+ * LRU-K with K = 2. The victim is the unpinned frame whose second most recent reference is the oldest, pages referenced
+ * only once counting as infinitely old, so pages touched once by a scan go before pages that are used repeatedly. The
+ * last reference time of evicted pages is remembered for as many pages as there are frames, so a page that comes back
+ * soon is not treated as new. Unpinned frames are kept in a binary heap on (second last, last) reference time, making
+ * PickVictim O(1) and each pin or unpin O(log n).
+ */
+class LRUK : public Replacer
+{
+	private :
+
+		int numOfBuf;
+		Frame **frames;
+		unsigned long now;        // logical time, advanced on every reference
+		unsigned long *last;      // per frame: time of the most recent reference
+		unsigned long *penult;    // per frame: time of the reference before that, 0 if none
+		PageID *resident;         // per frame: page this replacer last saw loaded there
+		int *heap;                // unpinned frames, heap ordered on (penult, last)
+		int *heapPos;             // per frame: position in heap, -1 if not there
+		int heapSize;
+		GhostLists *history;      // last reference time of recently evicted pages
+		unsigned long missPenult; // penult for the page named by the last PageMiss
+
+		Bool Older(int a, int b);
+		void HeapSwap(int i, int j);
+		void HeapUp(int i);
+		void HeapDown(int i);
+		void HeapInsert(int frameNo);
+		void HeapRemove(int frameNo);
+
+	public :
+
+		LRUK( int bufSize, Frame **frames );
+		~LRUK();
+		int PickVictim();
+		void PageMiss(PageID pid);
+		void PageIn(int frameNo);
+		void PageHit(int frameNo);
+		void Unpinned(int frameNo);
+		void PageOut(int frameNo);
+		void MoveFrame(int from, int to);
+		void Resize(int bufSize);
+};
+
+/**
+ * The full 2Q algorithm of Johnson and Shasha. A page seen for the first time enters A1in, a FIFO of about a quarter
+ * of the pool; pages evicted from A1in are remembered in the A1out ghost queue, and only a page found there when it is
+ * requested again is admitted to Am, which is managed as LRU. A scan therefore only ever cycles through A1in.
+ * PickVictim parks the pinned frames it finds at the front of a queue on a list of their own until they are unpinned,
+ * so it is O(1) amortized however many frames are pinned.
+ */
+class TwoQ : public Replacer
+{
+	private :
+
+		enum { A1IN, AM, FREE, PARKED };  // queue + PARKED holds the queue's parked frames
+
+		int numOfBuf;
+		int kin;                  // target size of A1in
+		Frame **frames;
+		PageID *resident;         // per frame: page this replacer last saw loaded there
+		LinkedLists *lists;       // A1IN (oldest first), AM (least recently used first), FREE, and the parked frames
+		GhostLists *a1out;
+		Bool missInA1out;         // whether the page named by the last PageMiss was in A1out
+
+		int Size(int queue);      // frames in the queue, parked or not
+		int OldestUnpinned(int queue);
+
+	public :
+
+		TwoQ( int bufSize, Frame **frames );
+		~TwoQ();
+		int PickVictim();
+		void PageMiss(PageID pid);
+		void PageIn(int frameNo);
+		void PageHit(int frameNo);
+		void Unpinned(int frameNo);
+		void PageOut(int frameNo);
+		void MoveFrame(int from, int to);
+		void Resize(int bufSize);
 };
+
+/**
+ * Adaptive Replacement Cache (Megiddo and Modha). T1 holds pages seen once recently and T2 pages seen at least twice,
+ * both LRU; B1 and B2 remember pages recently evicted from each. A request that hits B1 grows the target size p of T1,
+ * one that hits B2 shrinks it, and victims are taken from T1 while it is above p and from T2 otherwise. Pinned frames
+ * are parked as in TwoQ.
+ */
+class ARC : public Replacer
+{
+	private :
+
+		enum { T1, T2, FREE, PARKED };  // list + PARKED holds the list's parked frames
+		enum { B1, B2 };
+
+		int numOfBuf;
+		int p;                    // target size of T1
+		Frame **frames;
+		PageID *resident;         // per frame: page this replacer last saw loaded there
+		LinkedLists *lists;       // T1, T2 (least recently used first), FREE, and the parked frames
+		GhostLists *ghosts;       // B1, B2 (least recently evicted first)
+		int missGhost;            // ghost list holding the page named by the last PageMiss, -1 if none
+
+		int Size(int queue);      // frames in T1 or T2, parked or not
+		int OldestUnpinned(int queue);
+
+	public :
+
+		ARC( int bufSize, Frame **frames );
+		~ARC();
+		int PickVictim();
+		void PageMiss(PageID pid);
+		void PageIn(int frameNo);
+		void PageHit(int frameNo);
+		void Unpinned(int frameNo);
+		void PageOut(int frameNo);
+		void MoveFrame(int from, int to);
+		void Resize(int bufSize);
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdio.h>
+
+#include "page.h"
+
+#define TRACE_MAGIC 0x52544d42   // "BMTR", first word of a trace file
+#define TRACE_RING  0x80         // or'ed into the operation byte of a pin through a BufferRing
+
+/*
+ * What a trace records, see BufMgr::StartTrace.
+ */
+enum TraceOp
+{
+	TRACE_PIN,          // PinPage of a page to be read
+	TRACE_PIN_EMPTY,    // PinPage of a page to be overwritten, not read
+	TRACE_UNPIN,
+	TRACE_UNPIN_DIRTY,
+	TRACE_NEW,          // NewPage allocated count pages from pid on; the first is then pinned empty
+	TRACE_FREE,
+	TRACE_FLUSH,        // FlushPage emptied the page's frame
+	TRACE_FLUSH_ALL,    // FlushAllPages emptied the pool; no page
+	NUM_TRACE_OPS
+};
+
+struct TraceEvent
+{
+	TraceOp op;
+	PageID pid;
+	int count;      // for TRACE_NEW, 0 otherwise
+	int ring;       // for a pin, the BufferRing it went through, 0 if none
+	int ringSize;   // and the number of frames that ring recycles
+};
+
+/**
+ * Writes the events of a trace to a file. Each event takes one byte for the operation, then the difference from the
+ * previous event's page id as a zigzag varint, then for TRACE_NEW the count and for a pin through a ring the ring's id and
+ * size as varints, so the mostly local page accesses of a buffer pool take two or three bytes each. Not thread-safe.
+ */
+class TraceWriter
+{
+	private :
+
+		FILE *file;
+		PageID lastPid;
+
+		void PutVarint(unsigned long value);
+
+	public :
+
+		TraceWriter( const char *filename, Status& status );
+		~TraceWriter();
+
+		void Write(const TraceEvent& event);
+		Status Close();   // flushes the file; FAIL if anything could not be written
+};
+
+/**
+ * Reads back the events of a trace written by TraceWriter.
+ */
+class TraceReader
+{
+	private :
+
+		FILE *file;
+		PageID lastPid;
+
+		bool GetVarint(unsigned long& value);
+
+	public :
+
+		TraceReader( const char *filename, Status& status );   // FAIL if the file is not a trace
+		~TraceReader();
+
+		Status Next(TraceEvent& event);   // DONE at the end of the trace, FAIL if it is cut short
+};
+
+#endif
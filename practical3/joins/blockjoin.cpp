@@ -29,6 +29,7 @@
 
 void BlockNestedLoopJoin(JoinSpec specOfR, JoinSpec specOfS, int B, long& pinRequests, long& pinMisses, double& duration)
 {
+	StatScope tag(INVALID_PAGE, "BlockNestedLoopJoin");
 	MINIBASE_BM->ResetStat();
 	clock_t start = clock();
 	Status status = OK;
@@ -38,6 +39,7 @@ void BlockNestedLoopJoin(JoinSpec specOfR, JoinSpec specOfS, int B, long& pinReq
 
 	HeapFile* result = new HeapFile(NULL, status);
 	if (status != OK) exit(1);
+	result->BeginBulkLoad();
 
 	RecordID ridR, ridS, ridRes;
 	char* ptrR = new char[specOfR.recLen];
@@ -54,7 +56,8 @@ void BlockNestedLoopJoin(JoinSpec specOfR, JoinSpec specOfS, int B, long& pinReq
 	while (!done) {
 		int read;
 		for (read = 0; read < recsPerBlock; read++) {
-			if (scanR->GetNext(ridR, ptrBlock + read*lenR, lenR) != OK) {
+			if ((status = scanR->GetNext(ridR, ptrBlock + read*lenR, lenR)) != OK) {
+				if (status != DONE) exit(1);
 				done = true;
 				break;
 			}
@@ -63,14 +66,15 @@ void BlockNestedLoopJoin(JoinSpec specOfR, JoinSpec specOfS, int B, long& pinReq
 		Scan* scanS = specOfS.file->OpenScan(status);
 		if (status != OK) exit(1);
 
-		while (scanS->GetNext(ridS, ptrS, specOfS.recLen) == OK) {
+		while ((status = scanS->GetNext(ridS, ptrS, specOfS.recLen)) == OK) {
 			for (int i = 0; i < read; i++) {
 				if (*((int*)(ptrS + specOfS.offset)) == *((int*)(ptrBlock+i*lenR+specOfR.offset))) {
 					MakeNewRecord(ptrRes, ptrBlock+i*lenR, ptrS, specOfR.recLen, specOfS.recLen);
-					result->InsertRecord(ptrRes, recLenRes, ridRes);
+					if (result->InsertRecord(ptrRes, recLenRes, ridRes) != OK) exit(1);
 				}
 			}
 		}
+		if (status != DONE) exit(1);
 		delete scanS;
 	}
 
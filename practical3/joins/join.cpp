@@ -80,6 +80,7 @@ HeapFile *SortFile(HeapFile *S, int len, int offset)
 	{
 	    	cerr << "Cannot create new file for sortedS\n";
 	}
+	sorted->BeginBulkLoad();
 
 	//
 	// Now scan the B+-Tree and insert the records into a 
@@ -96,6 +97,7 @@ HeapFile *SortFile(HeapFile *S, int len, int offset)
 	    S->GetRecord (rid, recPtr, recLen);
 	    sorted->InsertRecord (recPtr, recLen, rid);
 	}
+	sorted->EndBulkLoad();
 	btree->DestroyFile();
 
 	delete btree;
@@ -54,6 +54,7 @@ void CreateR(int numR, int numS)
 		cerr << "Cannot create new HeapFile R\n";
 		exit(1);
 	}
+	F->BeginBulkLoad();
 
 	Employee e;
 	RecordID rid;
@@ -122,6 +123,7 @@ void CreateS(int num)
 		cerr << "Cannot create new HeapFile S\n";
 		exit(1);
 	}
+	F->BeginBulkLoad();
 
 	Project e;
 	RecordID rid;
@@ -32,6 +32,7 @@
 
 void TupleNestedLoopJoin(JoinSpec specOfR, JoinSpec specOfS, long& pinRequests, long& pinMisses, double& duration)
 {
+	StatScope tag(INVALID_PAGE, "TupleNestedLoopJoin");
 	MINIBASE_BM->ResetStat();
 	clock_t start = clock();
 	Status status = OK;
@@ -41,6 +42,7 @@ void TupleNestedLoopJoin(JoinSpec specOfR, JoinSpec specOfS, long& pinRequests,
 
 	HeapFile* result = new HeapFile(NULL, status);
 	if (status != OK) exit(1);
+	result->BeginBulkLoad();
 
 	RecordID ridR, ridS, ridRes;
 	char* ptrR = new char[specOfR.recLen];
@@ -49,18 +51,20 @@ void TupleNestedLoopJoin(JoinSpec specOfR, JoinSpec specOfS, long& pinRequests,
 	int recLenRes = specOfS.recLen + specOfR.recLen;
 	char* ptrRes = new char[recLenRes];
 
-	while (scanR->GetNext(ridR, ptrR, specOfR.recLen) == OK) {
+	while ((status = scanR->GetNext(ridR, ptrR, specOfR.recLen)) == OK) {
 		Scan* scanS = specOfS.file->OpenScan(status);
 		if (status != OK) exit(1);
 
-		while (scanS->GetNext(ridS, ptrS, specOfS.recLen) == OK) {
+		while ((status = scanS->GetNext(ridS, ptrS, specOfS.recLen)) == OK) {
 			if (*((int*)(ptrS + specOfS.offset)) == *((int*)(ptrR + specOfR.offset))) {
 				MakeNewRecord(ptrRes, ptrR, ptrS, specOfR.recLen, specOfS.recLen);
-				result->InsertRecord(ptrRes, recLenRes, ridRes);
+				if (result->InsertRecord(ptrRes, recLenRes, ridRes) != OK) exit(1);
 			}
 		}
+		if (status != DONE) exit(1);
 		delete scanS;
 	}
+	if (status != DONE) exit(1);
 
 	delete scanR;
 	delete[] ptrR, ptrS, ptrRes;
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <ctype.h>
+#include <string.h>
 
 #include "include/minirel.h"
 #include "include/bufmgr.h"
@@ -14,21 +15,102 @@ int MINIBASE_RESTART_FLAG = 0;// used in minibase part
 #define NUM_OF_BUF_PAGES 50 // define Buf manager size.You will need to change this for the analysis
 #define REPS 3
 
-void printStats(int sizeBuf, int sizeR, int sizeS) {
+// Replacement policy for the buffer pool, see Replacer::Create.
+const char *policy = "Clock";
+
+// Resident set file every new buffer pool is warmed up from, and dumps
+// its pages to when it is destroyed; NULL to start cold. Set with
+// "minibase-joins -w FILE ...", see BufMgr::WarmUp.
+const char *warmUpFile = NULL;
+
+// Policies run one after the other by "minibase-joins compare".
+const char *policies[] = { "Clock", "GClock", "LRU", "LRUK", "2Q", "ARC" };
+
+// Totals of one join over the repetitions.
+struct JoinStats {
+	long pinRequests;
+	long pinMisses;
+	long prefetches, prefetchHits, wastedPrefetches;
+	double duration;
+};
+
+void createDB(int sizeBuf, int maxSizeBuf = 0) {
 	Status s;
+	minibase_globals = new SystemDefs(
+		s,
+		"MINIBASE.DB",
+		"MINIBASE.LOG",
+		NUM_OF_DB_PAGES,   // Number of pages allocated for database
+		500,
+		sizeBuf,  // Number of frames in buffer pool
+		policy
+	);
+	if (s == OK && maxSizeBuf > sizeBuf) {
+		// SystemDefs builds a pool that can only grow a few times over;
+		// swap in one that can grow to maxSizeBuf.
+		delete MINIBASE_BM;
+		MINIBASE_BM = new BufMgr(sizeBuf, maxSizeBuf);
+	}
+	if (s != OK || MINIBASE_BM->SetReplacementPolicy(policy) != OK) {
+		cerr << "Error initializing Minibase with policy " << policy << endl;
+		exit(1);
+	}
+	if (warmUpFile != NULL) MINIBASE_BM->WarmUp(warmUpFile);
+}
 
-	long pinRequests = 0;
-	long pinMisses = 0;
-	double duration = 0;
+// Runs both joins once on the current database, adding to the totals.
+void runJoins(JoinSpec& specOfR, JoinSpec& specOfS, JoinStats& stats0, JoinStats& stats1, int& B) {
+	long pinRequests, pinMisses;
+	long prefetches, prefetchHits, wastedPrefetches;
+	double duration;
+
+	B = (MINIBASE_BM->GetNumOfBuffers()-3*3)*MINIBASE_PAGESIZE;
+	// B = (MINIBASE_BM->GetNumOfUnpinnedFrames()-3*3)*MINIBASE_PAGESIZE;
+
+	pinRequests = 0;
+	pinMisses = 0;
+	duration = 0;
+	TupleNestedLoopJoin(specOfR, specOfS, pinRequests, pinMisses, duration);
+	stats0.pinRequests += pinRequests;
+	stats0.pinMisses += pinMisses;
+	stats0.duration += duration;
+	MINIBASE_BM->GetPrefetchStat(prefetches, prefetchHits, wastedPrefetches);
+	stats0.prefetches += prefetches;
+	stats0.prefetchHits += prefetchHits;
+	stats0.wastedPrefetches += wastedPrefetches;
+
+	pinRequests = 0;
+	pinMisses = 0;
+	duration = 0;
+	BlockNestedLoopJoin(specOfR, specOfS, B, pinRequests, pinMisses, duration);
+	stats1.pinRequests += pinRequests;
+	stats1.pinMisses += pinMisses;
+	stats1.duration += duration;
+	MINIBASE_BM->GetPrefetchStat(prefetches, prefetchHits, wastedPrefetches);
+	stats1.prefetches += prefetches;
+	stats1.prefetchHits += prefetchHits;
+	stats1.wastedPrefetches += wastedPrefetches;
+}
 
-	long pinRequests0 = 0;
-	long pinMisses0 = 0;
-	double duration0 = 0;
+void printJoinStats(JoinStats& stats0, JoinStats& stats1, int B) {
+	cout << "  TupleNestedLoopJoin:" << endl;
+	cout << "    pinRequests: " << stats0.pinRequests / REPS << endl;
+	cout << "    pinMisses: " << stats0.pinMisses / REPS << endl;
+	cout << "    prefetched: " << stats0.prefetches / REPS << " (hits: " << stats0.prefetchHits / REPS
+		 << ", wasted: " << stats0.wastedPrefetches / REPS << ")" << endl;
+	cout << "    duration: " << stats0.duration / REPS << "s" << endl;
 
-	long pinRequests1 = 0;
-	long pinMisses1 = 0;
-	double duration1 = 0;
+	cout << endl;
+	cout << "  BlockNestedLoopJoin (B=" << B << "):" << endl;
+	cout << "    pinRequests: " << stats1.pinRequests / REPS << endl;
+	cout << "    pinMisses: " << stats1.pinMisses / REPS << endl;
+	cout << "    prefetched: " << stats1.prefetches / REPS << " (hits: " << stats1.prefetchHits / REPS
+		 << ", wasted: " << stats1.wastedPrefetches / REPS << ")" << endl;
+	cout << "    duration: " << stats1.duration / REPS << "s" << endl;
+}
 
+void printStats(int sizeBuf, int sizeR, int sizeS) {
+	JoinStats stats0 = JoinStats(), stats1 = JoinStats();
 	int B;
 
 	JoinSpec specOfS, specOfR;
@@ -36,15 +118,7 @@ void printStats(int sizeBuf, int sizeR, int sizeS) {
 	srand(1);
 
 	for (int i = 0; i < REPS; i++) {
-		minibase_globals = new SystemDefs(
-			s,
-			"MINIBASE.DB",
-			"MINIBASE.LOG",
-			NUM_OF_DB_PAGES,   // Number of pages allocated for database
-			500,
-			sizeBuf,  // Number of frames in buffer pool
-			NULL
-		);
+		createDB(sizeBuf);
 
 		CreateR(sizeR, sizeS);
 		CreateS(sizeS);
@@ -52,48 +126,110 @@ void printStats(int sizeBuf, int sizeR, int sizeS) {
 		CreateSpecForR(specOfR);
 		CreateSpecForS(specOfS);
 
-		B = (MINIBASE_BM->GetNumOfBuffers()-3*3)*MINIBASE_PAGESIZE;
-		// B = (MINIBASE_BM->GetNumOfUnpinnedFrames()-3*3)*MINIBASE_PAGESIZE;
-
-		pinRequests = 0;
-		pinMisses = 0;
-		duration = 0;
-		TupleNestedLoopJoin(specOfR, specOfS, pinRequests, pinMisses, duration);
-		pinRequests0 += pinRequests;
-		pinMisses0 += pinMisses;
-		duration0 += duration;
-
-		pinRequests = 0;
-		pinMisses = 0;
-		duration = 0;
-		BlockNestedLoopJoin(specOfR, specOfS, B, pinRequests, pinMisses, duration);
-		pinRequests1 += pinRequests;
-		pinMisses1 += pinMisses;
-		duration1 += duration;
+		runJoins(specOfR, specOfS, stats0, stats1, B);
 
 		remove("MINIBASE.DB");
 	}
 
-	cout << "  TupleNestedLoopJoin:" << endl;
-	cout << "    pinRequests: " << pinRequests0 / REPS << endl;
-	cout << "    pinMisses: " << pinMisses0 / REPS << endl;
-	cout << "    duration: " << duration0 / REPS << "s" << endl;
+	printJoinStats(stats0, stats1, B);
+}
 
-	cout << endl;
-	cout << "  BlockNestedLoopJoin (B=" << B << "):" << endl;
-	cout << "    pinRequests: " << pinRequests1 / REPS << endl;
-	cout << "    pinMisses: " << pinMisses1 / REPS << endl;
-	cout << "    duration: " << duration1 / REPS << "s" << endl;
+// Like printStats for each pool size in turn, but R and S are only
+// created once and the pool is resized in between. Every run starts
+// with an empty pool.
+void printStatsResizing(const int *sizes, int numOfSizes, int sizeR, int sizeS) {
+	JoinSpec specOfS, specOfR;
+	int largest = sizes[0];
+
+	for (int i = 1; i < numOfSizes; i++) {
+		if (sizes[i] > largest) largest = sizes[i];
+	}
+	srand(1);
+	createDB(sizes[0], largest);
+	CreateR(sizeR, sizeS);
+	CreateS(sizeS);
+	CreateSpecForR(specOfR);
+	CreateSpecForS(specOfS);
+
+	for (int i = 0; i < numOfSizes; i++) {
+		JoinStats stats0 = JoinStats(), stats1 = JoinStats();
+		int B;
+
+		cout << "# SIZE: " << sizes[i] << endl;
+		if (MINIBASE_BM->Resize(sizes[i]) != OK) {
+			cerr << "Error resizing the buffer pool to " << sizes[i] << endl;
+			exit(1);
+		}
+		for (int j = 0; j < REPS; j++) {
+			MINIBASE_BM->FlushAllPages();
+			runJoins(specOfR, specOfS, stats0, stats1, B);
+		}
+		printJoinStats(stats0, stats1, B);
+	}
+
+	delete minibase_globals;
+	remove("MINIBASE.DB");
 }
 
-int main() {
+// Captures the buffer pool trace of one run of both joins for bmsim,
+// on a pool that starts out empty.
+void captureTrace(const char *filename) {
+	JoinStats stats0 = JoinStats(), stats1 = JoinStats();
+	JoinSpec specOfS, specOfR;
+	int B;
+
+	srand(1);
+	createDB(NUM_OF_BUF_PAGES);
+	CreateR(NUM_OF_REC_IN_R, NUM_OF_REC_IN_S);
+	CreateS(NUM_OF_REC_IN_S);
+	CreateSpecForR(specOfR);
+	CreateSpecForS(specOfS);
+
+	MINIBASE_BM->FlushAllPages();
+	if (MINIBASE_BM->StartTrace(filename) != OK) {
+		cerr << "Error writing a trace to " << filename << endl;
+		exit(1);
+	}
+	runJoins(specOfR, specOfS, stats0, stats1, B);
+	if (MINIBASE_BM->StopTrace() != OK) {
+		cerr << "Error writing a trace to " << filename << endl;
+		exit(1);
+	}
+
+	delete minibase_globals;
+	remove("MINIBASE.DB");
+}
+
+int main(int argc, char **argv) {
+	if (argc > 2 && strcmp(argv[1], "-w") == 0) {
+		warmUpFile = argv[2];
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc > 2 && strcmp(argv[1], "trace") == 0) {
+		captureTrace(argv[2]);
+		return 0;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "compare") == 0) {
+		cout << "----- REPLACEMENT POLICY -----" << endl;
+		for (int i = 0; i < (int)(sizeof(policies) / sizeof(policies[0])); i++) {
+			policy = policies[i];
+			cout << "# POLICY: " << policy << endl;
+			printStats(NUM_OF_BUF_PAGES, NUM_OF_REC_IN_R, NUM_OF_REC_IN_S);
+		}
+		return 0;
+	}
+
+	if (argc > 1) policy = argv[1];
+	cout << "Replacement policy: " << policy << endl << endl;
+
 	printStats(NUM_OF_BUF_PAGES, NUM_OF_REC_IN_R, NUM_OF_REC_IN_S);
 
 	cout << endl << "----- BUFFER SIZE -----" << endl;
-	for (int s = 16; s <= 1024; s *= 4) {
-		cout << "# SIZE: " << s << endl;
-		printStats(s, NUM_OF_REC_IN_R, NUM_OF_REC_IN_S);
-	}
+	const int sizes[] = { 16, 64, 256, 1024 };
+	printStatsResizing(sizes, (int)(sizeof(sizes) / sizeof(sizes[0])), NUM_OF_REC_IN_R, NUM_OF_REC_IN_S);
 
 	cout << endl << "----- SIZE OF R -----" << endl;
 	for (int s = 100; s <= 10000; s *= 10) {